@@ -0,0 +1,737 @@
+// SPDX-FileCopyrightText: 2021-2023 Daniel Aimé Valcour <fosssweeper@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+/*
+    Copyright (c) 2021-2023  Daniel Aimé Valcour
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+    the Software, and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+    FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+    COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// rlh_bench draws repeatable scenes into an offscreen framebuffer and prints one line of JSON per
+// scenario with the push throughput, the bytes uploaded, and the CPU and GPU time of a frame.
+//
+//     rlh_bench [frame count] [scenario name filter]
+
+#define _POSIX_C_SOURCE 199309L
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glcorearb.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <rlh/roguelike.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// every scenario draws to a framebuffer of this size
+#define BENCH_FRAMEBUFFER_WIDTH 1920
+#define BENCH_FRAMEBUFFER_HEIGHT 1080
+// frames drawn before the measured frames, so that buffers have grown to their final size
+#define BENCH_WARMUP_FRAMES 10
+#define BENCH_DEFAULT_FRAMES 200
+#define BENCH_TILE_SIZE 4
+// the percentage of tiles that change every frame in the retained and immediate scenarios
+#define BENCH_CHANGED_TILE_PERCENT 2
+// the cells of the world that the scrolling scenarios move across
+#define BENCH_WORLD_CELLS 1024
+// the bytes of a tile instance, and the bytes that the retained scenario may upload for each tile that changed,
+// which leaves room for the few clean tiles that are uploaded between dirty tiles that are close together
+#define BENCH_TILE_INSTANCE_SIZE 20
+#define BENCH_MAX_UPLOAD_BYTES_PER_CHANGED_TILE (BENCH_TILE_INSTANCE_SIZE * 2.0)
+
+static const char *const BENCH_STREAM_MODE_NAMES[] = {"orphan", "ring", "persistent"};
+
+typedef struct bench_scenario_t bench_scenario_t;
+// Push the tiles of a frame to a terminal. Returns how many tiles were written.
+typedef size_t (*bench_frame_f)(rlhTerm_h term, const bench_scenario_t *scenario, int frame);
+
+struct bench_scenario_t
+{
+  const char *name;
+  int tiles_wide;
+  int tiles_tall;
+  rlhlayermode_t layer_mode;
+  // called once before the first frame, may be NULL
+  bench_frame_f setup;
+  bench_frame_f frame;
+  // the most bytes that may be uploaded for each tile written in a frame, or 0 to not check it
+  double max_upload_bytes_per_tile;
+};
+
+static double bench_now_ms(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+// A small xorshift generator, so that every run of a scenario pushes the same tiles.
+static uint32_t bench_random(uint32_t *state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static rlhColor_s bench_color(const uint32_t bits)
+{
+  return RLH_COLOR((bits & 0xFF) / 255.0f, ((bits >> 8) & 0xFF) / 255.0f, ((bits >> 16) & 0xFF) / 255.0f, 1.0f);
+}
+
+static size_t bench_fill_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  int tiles_wide, tiles_tall;
+  rlhTermGetTerminalSize(term, &tiles_wide, &tiles_tall);
+  for (int y = 0; y < tiles_tall; y++)
+  {
+    for (int x = 0; x < tiles_wide; x++)
+    {
+      rlhTermPushGrid(term, x, y, (rlhglyph_t)((x + y + frame) & 0xFF), RLH_WHITE, RLH_NAVY);
+    }
+  }
+  return (size_t)tiles_wide * tiles_tall;
+}
+
+static size_t bench_fill_span_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  rlhglyph_t row[480];
+  for (int x = 0; x < scenario->tiles_wide; x++)
+  {
+    row[x] = (rlhglyph_t)((x + frame) & 0xFF);
+  }
+  for (int y = 0; y < scenario->tiles_tall; y++)
+  {
+    rlhTermPushGridSpan(term, 0, y, row, scenario->tiles_wide, RLH_WHITE, RLH_NAVY);
+  }
+  return (size_t)scenario->tiles_wide * scenario->tiles_tall;
+}
+
+// The fill scenario with colors that are already packed.
+static size_t bench_fill_packed_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  const uint32_t fg = RLH_COLOR32(255, 255, 255, 255);
+  const uint32_t bg = RLH_COLOR32(0, 0, 128, 255);
+  for (int y = 0; y < scenario->tiles_tall; y++)
+  {
+    for (int x = 0; x < scenario->tiles_wide; x++)
+    {
+      rlhTermPushGridPacked(term, x, y, (rlhglyph_t)((x + y + frame) & 0xFF), fg, bg);
+    }
+  }
+  return (size_t)scenario->tiles_wide * scenario->tiles_tall;
+}
+
+static size_t bench_palette_setup(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  (void)frame;
+  const uint32_t palette[2] = {RLH_COLOR32(255, 255, 255, 255), RLH_COLOR32(0, 0, 128, 255)};
+  rlhTermSetPalette(term, 0, palette, 2);
+  return 0;
+}
+
+// The fill scenario with colors from the palette of the terminal, which is swapped every frame.
+static size_t bench_fill_indexed_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  const uint32_t flash = RLH_COLOR32(255, (frame & 1) ? 255 : 0, (frame & 1) ? 255 : 0, 255);
+  rlhTermSetPalette(term, 0, &flash, 1);
+  for (int y = 0; y < scenario->tiles_tall; y++)
+  {
+    for (int x = 0; x < scenario->tiles_wide; x++)
+    {
+      rlhTermPushGridIndexed(term, x, y, (rlhglyph_t)((x + y + frame) & 0xFF), 0, 1);
+    }
+  }
+  return (size_t)scenario->tiles_wide * scenario->tiles_tall;
+}
+
+// Half of the tiles are on the grid, a quarter at free pixel positions, and a quarter at free pixel
+// positions with their own size.
+static size_t bench_mixed_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)frame;
+  const size_t tile_count = (size_t)scenario->tiles_wide * scenario->tiles_tall;
+  const int pixel_width = scenario->tiles_wide * BENCH_TILE_SIZE;
+  const int pixel_height = scenario->tiles_tall * BENCH_TILE_SIZE;
+  uint32_t state = 0x9E3779B9u;
+  for (size_t tile_i = 0; tile_i < tile_count; tile_i++)
+  {
+    const uint32_t bits = bench_random(&state);
+    const rlhglyph_t glyph = (rlhglyph_t)(bits >> 24);
+    const rlhColor_s fg = bench_color(bits);
+    switch (tile_i % 4)
+    {
+    case 0:
+    case 1:
+      rlhTermPushGrid(term, bits % scenario->tiles_wide, (bits >> 12) % scenario->tiles_tall, glyph, fg, RLH_TRANSPARENT);
+      break;
+    case 2:
+      rlhTermPushFree(term, bits % pixel_width, (bits >> 12) % pixel_height, glyph, fg, RLH_TRANSPARENT);
+      break;
+    default:
+      rlhTermPushFreeSized(term, bits % pixel_width, (bits >> 12) % pixel_height, BENCH_TILE_SIZE * (1 + bits % 3),
+                           BENCH_TILE_SIZE * (1 + (bits >> 4) % 3), glyph, fg, RLH_TRANSPARENT);
+    }
+  }
+  return tile_count;
+}
+
+// Change the glyph of a few tiles of a retained layer that was filled once by the setup.
+static size_t bench_retained_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  const int tile_count = rlhTermGetTileDataCount(term);
+  const int changed_count = tile_count * BENCH_CHANGED_TILE_PERCENT / 100;
+  uint32_t state = 0x9E3779B9u + (uint32_t)frame;
+  for (int changed_i = 0; changed_i < changed_count; changed_i++)
+  {
+    const uint32_t bits = bench_random(&state);
+    rlhTermSetTile(term, bits % tile_count, (rlhglyph_t)(bits >> 24), RLH_WHITE, RLH_NAVY);
+  }
+  return (size_t)changed_count;
+}
+
+// The same scene as the retained scenario, but every tile is pushed again every frame.
+static size_t bench_immediate_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)frame;
+  return bench_fill_frame(term, scenario, 0);
+}
+
+// Resize the terminal every frame before filling it.
+static size_t bench_resize_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  static const int sizes[][2] = {{80, 25}, {480, 270}, {160, 50}, {320, 180}, {240, 135}, {120, 40}};
+  const int size_i = frame % (int)(sizeof(sizes) / sizeof(sizes[0]));
+  rlhTermSizeInfo_t size_info;
+  memset(&size_info, 0, sizeof(rlhTermSizeInfo_t));
+  size_info.width = sizes[size_i][0];
+  size_info.height = sizes[size_i][1];
+  size_info.size_mode = RLH_SIZE_TILES;
+  size_info.pixel_scale = 1;
+  size_info.tile_width = BENCH_TILE_SIZE;
+  size_info.tile_height = BENCH_TILE_SIZE;
+  rlhTermSetSize(term, &size_info);
+  return bench_fill_frame(term, scenario, frame);
+}
+
+// A background fill, a floor tile in every cell, and an item on every third cell, which hide most of
+// the tiles pushed before them.
+static size_t bench_layered_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  size_t tile_count = 1;
+  rlhTermPushFill(term, 0, RLH_BLACK, RLH_BLACK);
+  for (int y = 0; y < scenario->tiles_tall; y++)
+  {
+    for (int x = 0; x < scenario->tiles_wide; x++)
+    {
+      rlhTermPushGrid(term, x, y, '.', RLH_GRAY, RLH_BLACK);
+      tile_count++;
+      if ((x + y + frame) % 3 == 0)
+      {
+        rlhTermPushGrid(term, x, y, '!', RLH_YELLOW, RLH_NAVY);
+        tile_count++;
+      }
+    }
+  }
+  return tile_count;
+}
+
+static size_t bench_overdraw_culling_setup(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  (void)frame;
+  rlhTermSetOverdrawCulling(term, RLH_TRUE);
+  return 0;
+}
+
+// Push nothing, so that the retained layer filled by the setup looks the same in every frame.
+static size_t bench_static_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)term;
+  (void)scenario;
+  (void)frame;
+  return 0;
+}
+
+// Give the retained layer a blink, a color cycle, and a fade spread over its tiles.
+static size_t bench_effects_setup(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)frame;
+  const rlhTileEffect_t effects[] = {
+      {RLH_EFFECT_BLINK, RLH_EFFECT_TARGET_FG, RLH_BLACK, 0.5f, 0.0f, 0.0f},
+      {RLH_EFFECT_CYCLE, RLH_EFFECT_TARGET_BOTH, RLH_WHITE, 2.0f, 0.0f, 0.02f},
+      {RLH_EFFECT_FADE, RLH_EFFECT_TARGET_BG, RLH_NAVY, 4.0f, 0.0f, 0.0f}};
+  const int effect_count = (int)(sizeof(effects) / sizeof(effects[0]));
+  for (int effect_i = 0; effect_i < effect_count; effect_i++)
+  {
+    rlhTermSetEffect(term, effect_i + 1, &effects[effect_i]);
+  }
+  size_t tile_count = 0;
+  for (int y = 0; y < scenario->tiles_tall; y++)
+  {
+    rlhTermSetPushEffect(term, 1 + y % effect_count);
+    for (int x = 0; x < scenario->tiles_wide; x++)
+    {
+      rlhTermPushGrid(term, x, y, (rlhglyph_t)((x + y) % 256), RLH_YELLOW, RLH_MAROON);
+      tile_count++;
+    }
+  }
+  rlhTermSetPushEffect(term, 0);
+  return tile_count;
+}
+
+// Only advance the effect time, so that the tiles animate without being pushed again.
+static size_t bench_effects_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  rlhTermSetEffectTime(term, (float)frame / 60.0f);
+  return 0;
+}
+
+#define BENCH_LIGHT_MAX_CELLS (480 * 270)
+
+// Move a light around the retained layer and only upload a new light map, visibility, and explored mask.
+static size_t bench_light_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  static uint8_t light[BENCH_LIGHT_MAX_CELLS * 3];
+  static uint8_t visible[BENCH_LIGHT_MAX_CELLS];
+  static uint8_t explored[BENCH_LIGHT_MAX_CELLS];
+  const int light_x = (frame * 5) % scenario->tiles_wide;
+  const int light_y = scenario->tiles_tall / 2;
+  const int radius = 40;
+  for (int y = 0; y < scenario->tiles_tall; y++)
+  {
+    for (int x = 0; x < scenario->tiles_wide; x++)
+    {
+      const int cell_i = y * scenario->tiles_wide + x;
+      const int distance = (x - light_x) * (x - light_x) + (y - light_y) * (y - light_y);
+      const uint8_t brightness = (distance < radius * radius) ? (uint8_t)(255 - distance * 255 / (radius * radius)) : 0;
+      light[cell_i * 3] = brightness;
+      light[cell_i * 3 + 1] = brightness;
+      light[cell_i * 3 + 2] = (uint8_t)(brightness * 3 / 4);
+      visible[cell_i] = brightness != 0;
+      explored[cell_i] = explored[cell_i] || visible[cell_i];
+    }
+  }
+  rlhTermSetLightMap(term, light, visible, explored);
+  return 0;
+}
+
+// The glyph and packed foreground of a cell of the world of the scrolling scenarios.
+static rlhglyph_t bench_world_cell(const int x, const int y, uint32_t *const fg)
+{
+  uint32_t state = 0x9E3779B9u ^ ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+  const uint32_t bits = bench_random(&state);
+  *fg = bits | 0xFF000000u;
+  return (rlhglyph_t)(bits >> 24);
+}
+
+// The camera position of a frame, moving diagonally by a few pixels each frame.
+static void bench_camera(const int frame, int *const camera_x, int *const camera_y)
+{
+  *camera_x = frame * 3;
+  *camera_y = frame * 2;
+}
+
+// Push the cells of the world that are inside of the terminal at the camera position of the frame.
+static size_t bench_scroll_push_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  int camera_x, camera_y;
+  bench_camera(frame, &camera_x, &camera_y);
+  const int first_x = camera_x / BENCH_TILE_SIZE;
+  const int first_y = camera_y / BENCH_TILE_SIZE;
+  size_t tile_count = 0;
+  for (int y = first_y; y <= first_y + scenario->tiles_tall && y < BENCH_WORLD_CELLS; y++)
+  {
+    for (int x = first_x; x <= first_x + scenario->tiles_wide && x < BENCH_WORLD_CELLS; x++)
+    {
+      uint32_t fg;
+      const rlhglyph_t glyph = bench_world_cell(x, y, &fg);
+      rlhTermPushFreePacked(term, x * BENCH_TILE_SIZE - camera_x, y * BENCH_TILE_SIZE - camera_y, glyph, fg, RLH_COLOR32(0, 0, 0, 255));
+      tile_count++;
+    }
+  }
+  return tile_count;
+}
+
+// Write the whole world to a tilemap that the terminal draws.
+static size_t bench_tilemap_setup(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  (void)frame;
+  rlhTilemap_h tilemap;
+  if (rlhTilemapCreate(BENCH_WORLD_CELLS, BENCH_WORLD_CELLS, &tilemap) != RLH_RESULT_OK)
+    return 0;
+  for (int y = 0; y < BENCH_WORLD_CELLS; y++)
+  {
+    for (int x = 0; x < BENCH_WORLD_CELLS; x++)
+    {
+      uint32_t fg;
+      const rlhglyph_t glyph = bench_world_cell(x, y, &fg);
+      rlhTilemapSetCellPacked(tilemap, x, y, glyph, fg, RLH_COLOR32(0, 0, 0, 255));
+    }
+  }
+  rlhTermSetTilemap(term, tilemap);
+  // the terminal keeps the tilemap until it is destroyed.
+  rlhTilemapDestroy(tilemap);
+  return 0;
+}
+
+// Only move the camera over the tilemap.
+static size_t bench_tilemap_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  int camera_x, camera_y;
+  bench_camera(frame, &camera_x, &camera_y);
+  rlhTermSetCamera(term, camera_x, camera_y);
+  return 0;
+}
+
+static size_t bench_render_cache_setup(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  rlhTermSetRenderCache(term, RLH_TRUE);
+  if (scenario->layer_mode == RLH_LAYER_RETAINED)
+  {
+    return bench_fill_frame(term, scenario, frame);
+  }
+  return 0;
+}
+
+// Stream the tiles through a fenced ring buffer, or through a persistently mapped one where the driver has
+// buffer storage. The stream mode that was used is printed with the results.
+static size_t bench_stream_ring_setup(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  (void)frame;
+  rlhTermSetStreamMode(term, RLH_STREAM_RING);
+  return 0;
+}
+
+static size_t bench_stream_persistent_setup(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  (void)frame;
+  rlhTermSetStreamMode(term, RLH_STREAM_PERSISTENT);
+  return 0;
+}
+
+// Bind the atlas of the terminal again as a second atlas, as a stand in for a sprite atlas.
+static size_t bench_atlases_setup(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  (void)scenario;
+  (void)frame;
+  rlhTermBindAtlas(term, 1, rlhTermGetAtlas(term));
+  return 0;
+}
+
+// Sprites of the second atlas interleaved with text of the first one, which costs a draw call per switch
+// unless the tiles are grouped by atlas.
+static size_t bench_atlases_frame(rlhTerm_h term, const bench_scenario_t *scenario, int frame)
+{
+  for (int y = 0; y < scenario->tiles_tall; y++)
+  {
+    for (int x = 0; x < scenario->tiles_wide; x++)
+    {
+      rlhTermSelectAtlas(term, ((x + y + frame) % 3 == 0) ? 1 : 0);
+      rlhTermPushGrid(term, x, y, (rlhglyph_t)((x * 7 + y + frame) & 0xFF), RLH_WHITE, RLH_NAVY);
+    }
+  }
+  rlhTermSelectAtlas(term, 0);
+  return (size_t)scenario->tiles_wide * scenario->tiles_tall;
+}
+
+static const bench_scenario_t BENCH_SCENARIOS[] = {
+    {"fill_80x25", 80, 25, RLH_LAYER_IMMEDIATE, NULL, bench_fill_frame, 0},
+    {"fill_160x50", 160, 50, RLH_LAYER_IMMEDIATE, NULL, bench_fill_frame, 0},
+    {"fill_240x135", 240, 135, RLH_LAYER_IMMEDIATE, NULL, bench_fill_frame, 0},
+    {"fill_320x180", 320, 180, RLH_LAYER_IMMEDIATE, NULL, bench_fill_frame, 0},
+    {"fill_480x270", 480, 270, RLH_LAYER_IMMEDIATE, NULL, bench_fill_frame, 0},
+    {"fill_packed_480x270", 480, 270, RLH_LAYER_IMMEDIATE, NULL, bench_fill_packed_frame, 0},
+    {"fill_indexed_480x270", 480, 270, RLH_LAYER_IMMEDIATE, bench_palette_setup, bench_fill_indexed_frame, 0},
+    {"fill_span_80x25", 80, 25, RLH_LAYER_IMMEDIATE, NULL, bench_fill_span_frame, 0},
+    {"fill_span_480x270", 480, 270, RLH_LAYER_IMMEDIATE, NULL, bench_fill_span_frame, 0},
+    {"mixed_free_sized_240x135", 240, 135, RLH_LAYER_IMMEDIATE, NULL, bench_mixed_frame, 0},
+    {"stream_ring_240x135", 240, 135, RLH_LAYER_IMMEDIATE, bench_stream_ring_setup, bench_fill_frame, 0},
+    {"stream_persistent_240x135", 240, 135, RLH_LAYER_IMMEDIATE, bench_stream_persistent_setup, bench_fill_frame, 0},
+    {"immediate_240x135", 240, 135, RLH_LAYER_IMMEDIATE, NULL, bench_immediate_frame, 0},
+    {"retained_240x135", 240, 135, RLH_LAYER_RETAINED, bench_immediate_frame, bench_retained_frame, BENCH_MAX_UPLOAD_BYTES_PER_CHANGED_TILE},
+    {"resize_storm", 80, 25, RLH_LAYER_IMMEDIATE, NULL, bench_resize_frame, 0},
+    {"layered_480x270", 480, 270, RLH_LAYER_IMMEDIATE, NULL, bench_layered_frame, 0},
+    {"layered_culled_480x270", 480, 270, RLH_LAYER_IMMEDIATE, bench_overdraw_culling_setup, bench_layered_frame, 0},
+    {"static_480x270", 480, 270, RLH_LAYER_RETAINED, bench_immediate_frame, bench_static_frame, 0},
+    {"effects_480x270", 480, 270, RLH_LAYER_RETAINED, bench_effects_setup, bench_effects_frame, 0},
+    {"light_480x270", 480, 270, RLH_LAYER_RETAINED, bench_immediate_frame, bench_light_frame, 0},
+    {"scroll_push_480x270", 480, 270, RLH_LAYER_IMMEDIATE, NULL, bench_scroll_push_frame, 0},
+    {"scroll_tilemap_480x270", 480, 270, RLH_LAYER_IMMEDIATE, bench_tilemap_setup, bench_tilemap_frame, 0},
+    {"static_cached_480x270", 480, 270, RLH_LAYER_RETAINED, bench_render_cache_setup, bench_static_frame, 0},
+    {"immediate_cached_240x135", 240, 135, RLH_LAYER_IMMEDIATE, bench_render_cache_setup, bench_immediate_frame, 0},
+    {"atlases_240x135", 240, 135, RLH_LAYER_IMMEDIATE, bench_atlases_setup, bench_atlases_frame, 0},
+};
+
+// A 16x16 grid of 8x8 glyphs made of a pattern from the bits of the glyph index.
+static rlhAtlas_h bench_create_atlas(void)
+{
+  const int atlas_size = 128;
+  uint8_t *pixels = (uint8_t *)malloc(atlas_size * atlas_size * 4);
+  float *stpqp = (float *)malloc(256 * 5 * sizeof(float));
+  if (pixels == NULL || stpqp == NULL)
+  {
+    free(pixels);
+    free(stpqp);
+    return NULL;
+  }
+  for (int y = 0; y < atlas_size; y++)
+  {
+    for (int x = 0; x < atlas_size; x++)
+    {
+      const int glyph = (y / 8) * 16 + x / 8;
+      uint8_t *const pixel = pixels + (y * atlas_size + x) * 4;
+      pixel[0] = pixel[1] = pixel[2] = 255;
+      pixel[3] = ((glyph >> ((x + y) % 8)) & 1) ? 255 : 0;
+    }
+  }
+  const float glyph_size = 1.0f / 16.0f;
+  for (int glyph = 0; glyph < 256; glyph++)
+  {
+    float *const coords = stpqp + glyph * 5;
+    coords[0] = (glyph % 16) * glyph_size;
+    coords[1] = coords[0] + glyph_size;
+    coords[2] = (glyph / 16) * glyph_size;
+    coords[3] = coords[2] + glyph_size;
+    coords[4] = 0.0f;
+  }
+  rlhAtlasCreateInfo_t atlas_info;
+  memset(&atlas_info, 0, sizeof(rlhAtlasCreateInfo_t));
+  atlas_info.width = atlas_size;
+  atlas_info.height = atlas_size;
+  atlas_info.pages = 1;
+  atlas_info.channel_size = 1;
+  atlas_info.color = RLH_COLOR_RGBA;
+  atlas_info.pixel_data = pixels;
+  atlas_info.glyph_count = 256;
+  atlas_info.glyph_stpqp = stpqp;
+  rlhAtlas_h atlas = NULL;
+  rlhAtlasCreate(&atlas_info, &atlas);
+  free(pixels);
+  free(stpqp);
+  return atlas;
+}
+
+// Make an OpenGL 3.3 core context current without a window, and bind a framebuffer to draw to.
+static int bench_create_context(void)
+{
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  EGLDisplay display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+  if (get_platform_display != NULL)
+  {
+    display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  }
+#endif
+  if (display == EGL_NO_DISPLAY)
+  {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (!eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API))
+  {
+    return 0;
+  }
+  const EGLint config_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config;
+  EGLint config_count = 0;
+  eglChooseConfig(display, config_attributes, &config, 1, &config_count);
+  const EGLint context_attributes[] = {
+      EGL_CONTEXT_MAJOR_VERSION, 3,
+      EGL_CONTEXT_MINOR_VERSION, 3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE};
+  EGLContext context = eglCreateContext(display, (config_count > 0) ? config : (EGLConfig)0, EGL_NO_CONTEXT, context_attributes);
+  if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+  {
+    return 0;
+  }
+  GLuint framebuffer, renderbuffer;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glGenRenderbuffers(1, &renderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, BENCH_FRAMEBUFFER_WIDTH, BENCH_FRAMEBUFFER_HEIGHT);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffer);
+  return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void bench_print_json_string(const char *string)
+{
+  putchar('"');
+  for (; *string != '\0'; string++)
+  {
+    if (*string == '"' || *string == '\\')
+    {
+      putchar('\\');
+    }
+    putchar(*string);
+  }
+  putchar('"');
+}
+
+// Run a scenario and print its results. Returns 0 if the terminal could not be created, -1 if the scenario
+// uploaded more bytes per tile than it may, and 1 otherwise.
+static int bench_run(const bench_scenario_t *scenario, rlhAtlas_h atlas, const int frame_count)
+{
+  rlhTermSizeInfo_t size_info;
+  memset(&size_info, 0, sizeof(rlhTermSizeInfo_t));
+  size_info.width = scenario->tiles_wide;
+  size_info.height = scenario->tiles_tall;
+  size_info.size_mode = RLH_SIZE_TILES;
+  size_info.pixel_scale = 1;
+  size_info.tile_width = BENCH_TILE_SIZE;
+  size_info.tile_height = BENCH_TILE_SIZE;
+  rlhTermCreateInfo_t term_info;
+  memset(&term_info, 0, sizeof(rlhTermCreateInfo_t));
+  term_info.size_info = &size_info;
+  term_info.atlas = atlas;
+  rlhTerm_h term = NULL;
+  if (rlhTermCreate(&term_info, &term) != RLH_RESULT_OK)
+  {
+    return 0;
+  }
+  if (scenario->layer_mode == RLH_LAYER_RETAINED)
+  {
+    int layer;
+    rlhTermAddLayer(term, "retained", 1, RLH_LAYER_RETAINED, &layer);
+    rlhTermSelectLayer(term, layer);
+  }
+  if (scenario->setup != NULL)
+  {
+    scenario->setup(term, scenario, 0);
+  }
+  rlhViewport(0, 0, BENCH_FRAMEBUFFER_WIDTH, BENCH_FRAMEBUFFER_HEIGHT);
+  size_t tiles_written = 0;
+  double push_ms = 0.0;
+  double frame_ms = 0.0;
+  for (int frame = -BENCH_WARMUP_FRAMES; frame < frame_count; frame++)
+  {
+    if (frame == 0)
+    {
+      glFinish();
+      rlhTermResetStats(term);
+      rlhTermSetGpuTiming(term, RLH_TRUE);
+    }
+    const double frame_start = bench_now_ms();
+    const size_t frame_tiles = scenario->frame(term, scenario, frame);
+    const double push_end = bench_now_ms();
+    rlhClearColor(RLH_BLACK);
+    rlhTermDraw(term);
+    const double frame_end = bench_now_ms();
+    // wait for the GPU outside of the measured time, so that frames do not queue up
+    glFinish();
+    if (frame >= 0)
+    {
+      tiles_written += frame_tiles;
+      push_ms += push_end - frame_start;
+      frame_ms += frame_end - frame_start;
+    }
+  }
+  rlhTermStats_t stats;
+  rlhTermGetStats(term, &stats);
+  printf("{\"scenario\":");
+  bench_print_json_string(scenario->name);
+  printf(",\"stream_mode\":");
+  bench_print_json_string(BENCH_STREAM_MODE_NAMES[rlhTermGetStreamMode(term)]);
+  printf(",\"frames\":%d", frame_count);
+  printf(",\"tiles_per_frame\":%.1f", tiles_written / (double)frame_count);
+  printf(",\"push_tiles_per_sec\":%.0f", (push_ms > 0.0) ? tiles_written / (push_ms / 1000.0) : 0.0);
+  printf(",\"upload_bytes_per_frame\":%.1f", stats.bytes_uploaded / (double)frame_count);
+  const double upload_bytes_per_tile = (tiles_written > 0) ? stats.bytes_uploaded / (double)tiles_written : 0.0;
+  printf(",\"upload_bytes_per_tile\":%.1f", upload_bytes_per_tile);
+  printf(",\"draw_calls_per_frame\":%.2f", stats.draw_calls / (double)frame_count);
+  printf(",\"cpu_push_ms\":%.4f", push_ms / frame_count);
+  printf(",\"cpu_frame_ms\":%.4f", frame_ms / frame_count);
+  if (stats.timed_draws > 0)
+  {
+    printf(",\"gpu_frame_ms\":%.4f", stats.total_gpu_time_ns / (double)stats.timed_draws / 1000000.0);
+  }
+  else
+  {
+    printf(",\"gpu_frame_ms\":null");
+  }
+  printf(",\"tiles_overdrawn_per_frame\":%.1f", stats.tiles_overdrawn / (double)frame_count);
+  printf(",\"cached_draws_per_frame\":%.2f", stats.cached_draws / (double)frame_count);
+  printf(",\"peak_tile_capacity\":%llu,\"tile_buffer_reallocs\":%llu}\n",
+         (unsigned long long)stats.peak_tile_capacity, (unsigned long long)stats.tile_buffer_reallocs);
+  fflush(stdout);
+  rlhTermDestroy(term);
+  if (scenario->max_upload_bytes_per_tile > 0.0 && upload_bytes_per_tile > scenario->max_upload_bytes_per_tile)
+  {
+    fprintf(stderr, "scenario %s uploaded %.1f bytes per tile, more than %.1f!\n", scenario->name,
+            upload_bytes_per_tile, scenario->max_upload_bytes_per_tile);
+    return -1;
+  }
+  return 1;
+}
+
+int main(int argc, char **argv)
+{
+  const int frame_count = (argc > 1) ? atoi(argv[1]) : BENCH_DEFAULT_FRAMES;
+  const char *filter = (argc > 2) ? argv[2] : NULL;
+  if (frame_count <= 0)
+  {
+    fprintf(stderr, "usage: rlh_bench [frame count] [scenario name filter]\n");
+    return 1;
+  }
+  if (!bench_create_context())
+  {
+    fprintf(stderr, "failed to create an offscreen OpenGL 3.3 context!\n");
+    return 2;
+  }
+  rlhAtlas_h atlas = bench_create_atlas();
+  if (atlas == NULL)
+  {
+    fprintf(stderr, "failed to create the atlas!\n");
+    return 3;
+  }
+  printf("{\"renderer\":");
+  bench_print_json_string((const char *)glGetString(GL_RENDERER));
+  printf(",\"version\":");
+  bench_print_json_string((const char *)glGetString(GL_VERSION));
+  printf("}\n");
+  int upload_check_failed = 0;
+  for (size_t scenario_i = 0; scenario_i < sizeof(BENCH_SCENARIOS) / sizeof(BENCH_SCENARIOS[0]); scenario_i++)
+  {
+    const bench_scenario_t *const scenario = &BENCH_SCENARIOS[scenario_i];
+    if (filter != NULL && strstr(scenario->name, filter) == NULL)
+      continue;
+    const int run_result = bench_run(scenario, atlas, frame_count);
+    if (run_result == 0)
+    {
+      fprintf(stderr, "failed to create the terminal of scenario %s!\n", scenario->name);
+      rlhAtlasDestroy(atlas);
+      return 4;
+    }
+    if (run_result < 0)
+    {
+      upload_check_failed = 1;
+    }
+  }
+  rlhAtlasDestroy(atlas);
+  return upload_check_failed ? 5 : 0;
+}
@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2021-2023 Daniel Aimé Valcour <fosssweeper@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+/*
+    Copyright (c) 2021-2023  Daniel Aimé Valcour
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+    the Software, and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+    FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+    COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Instantiates the templates of roguelike.hpp. This file is only compiled, never linked or run.
+
+#include <rlh/roguelike.hpp>
+#include <array>
+
+template class rlh::FixedTerm<80, 25, 8, 8>;
+template class rlh::FixedTerm<1, 1, 1, 1, RLH_COLOR_G, 1>;
+
+rlhresult_t rlh_cpp_check_push(rlh::FixedTerm<80, 25, 8, 8> &term, rlh::Term &other)
+{
+  // the color macros of roguelike.h are C compound literals.
+  const rlhColor_s white = {1.0f, 1.0f, 1.0f, 1.0f};
+  const rlhColor_s black = {0.0f, 0.0f, 0.0f, 1.0f};
+  term.set<79, 24>('@', white, black);
+  for (int y = 0; y < term.tiles_tall; y++)
+  {
+    for (int x = 0; x < term.tiles_wide; x++)
+    {
+      term.push(x, y, static_cast<rlhglyph_t>(x + y), white, black);
+    }
+  }
+  const std::array<rlhglyph_t, 3> glyphs = {'a', 'b', 'c'};
+  other.pushGridSpan(0, 0, glyphs, white, black);
+  static_assert(rlh::FixedTerm<80, 25, 8, 8>::pixelX(79) == 632);
+  return term.draw();
+}
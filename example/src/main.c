@@ -26,7 +26,6 @@
 #include <rlh/roguelike.h>
 #include <cp/cp437.h>
 #include <pngw/png_wrapper.h>
-#include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -43,7 +42,11 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height)
   size_info.size_mode = RLH_SIZE_SCALED_PIXELS;
   size_info.floor_pixels_to_tiles = RLH_TRUE;
   rlhTermGetTileSize(term, &size_info.tile_width, &size_info.tile_height);
-  rlhTermSetSize(term, &size_info);
+  rlhresult_t result = rlhTermSetSize(term, &size_info);
+  if (result != RLH_RESULT_OK)
+  {
+    printf("failed to resize the terminal: %s\n", RLH_RESULT_DESCRIPTIONS[result]);
+  }
 }
 
 int main()
@@ -201,6 +204,7 @@ int main()
   size_info.tile_height = i_height / sheet_sprite_dimensions;
   // create the term info
   rlhTermCreateInfo_t term_info;
+  memset(&term_info, 0, sizeof(rlhTermCreateInfo_t));
   term_info.atlas_info = &atlas_info;
   term_info.size_info = &size_info;
   // create the terminal
@@ -259,22 +263,10 @@ int main()
 
     // print some text to the screen
     // this is easy to do because CP437 glyphs for characters collide with ascii character codes
-    const size_t label_x = 18;
-    const char *label_1 = "roguelike.h";
-    const size_t label_1_y = 20;
-    const size_t label_1_length = strlen(label_1);
-    for (size_t x = 0; x < label_1_length; x++)
-    {
-      rlhTermPushGrid(t, x + label_x, label_1_y, label_1[x], RLH_NAVY, RLH_YELLOW);
-    }
-
-    const char *label_2 = "by journeyman";
-    const size_t label_2_y = label_1_y + 1;
-    const size_t label_2_length = strlen(label_2);
-    for (size_t x = 0; x < label_2_length; x++)
-    {
-      rlhTermPushGrid(t, x + label_x, label_2_y, label_2[x], RLH_RED, RLH_GREEN);
-    }
+    const int label_x = 18;
+    const int label_1_y = 20;
+    rlhTermPushString(t, label_x, label_1_y, "roguelike.h", RLH_NAVY, RLH_YELLOW);
+    rlhTermPushString(t, label_x, label_1_y + 1, "by journeyman", RLH_RED, RLH_GREEN);
 
     // get the current window size
     glfwGetFramebufferSize(window, &w_width, &w_height);
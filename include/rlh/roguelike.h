@@ -21,7 +21,7 @@
 */
 
 /*
-    roguelike.h version v2.0.0
+    roguelike.h version v2.1.0
     Header only roguelike rendering library.
     The source for this library can be found on GitHub:
     https://github.com/Journeyman-dev/roguelike.h
@@ -58,6 +58,7 @@
             #include <glad/glad.h> // you can use a different opengl loader here (see bellow)
             #include <gl_debug.h> // this line is optional (see bellow)
             #define RLH_RETAINED_MODE // optional (see bellow)
+            #define RLH_NO_SIMD // optional (see bellow)
             #define RLH_IMPLEMENTATION
             #include <rlh/roguelike.h>
 
@@ -72,12 +73,239 @@
     avaliable here: https://github.com/Journeyman-dev/glDebug.h. Look at the comment on top of
     that header for more information about its usage.
 
+    C++20 projects can include rlh/roguelike.hpp in their C++ source files instead. It wraps atlases
+    and terminals in owning handles, takes std::span in the batch push functions, and has a terminal
+    type with its grid size, tile size, and color type fixed at compile time that writes its tiles
+    straight into the tile buffer with rlhTermBeginTileWrite() and rlhTermEndTileWrite(). The
+    implementation is still compiled in a C source file. See the comment on top of roguelike.hpp for
+    more.
+
     By default, roguelike.h will clear the tile buffer after each draw. This requires you to set
     all tiles over again the next frame from scratch. If you want to instead retain tiles from
     previous draws unless you explicitly clear the tile buffer with the function
     rlhTermClearTileData(), define RLH_RETAINED_MODE before implementing the header. If you do this,
     be very careful! If you forget to clear the tile buffer and keep adding tiles to it over time,
-    this can result in a nasty memory leak.
+    this can result in a nasty memory leak. In retained mode only the tiles that changed since the
+    last draw are uploaded to the GPU, even when they are scattered, and you can change the glyph and colors of a tile that is
+    already in the tile buffer with rlhTermSetTile(). The index of a tile is the value that
+    rlhTermGetTileDataCount() returns right before it is pushed. Tiles that are entirely outside of
+    the terminal are not added to the tile buffer, so check that the count increased after the push.
+    The position and size of a tile are stored as 16 bit pixels, so are limited to INT16_MIN to
+    INT16_MAX unscaled pixels. Tiles past that limit are culled like tiles outside of the terminal,
+    even if part of them would be visible, and are counted in the tiles_culled stat.
+
+    Tile colors are converted with SSE2 or NEON instructions when the compiler targets them. Define
+    RLH_NO_SIMD before implementing the header to always use the portable scalar conversion instead.
+
+    Tiles can be built on several threads at once with command lists. Create a command list for
+    each thread with rlhCmdListCreate(), which copies the size and glyph count of a terminal, and
+    record tiles into it with the rlhCmdListPush functions. They take the same arguments as the
+    rlhTermPush functions and never touch the terminal, so no locks are needed as long as each
+    command list is only used by one thread at a time. Then call rlhTermSubmit() on the thread
+    that owns the terminal to append the tiles of the command lists to the tile buffer in the order
+    of the array. Submitting does not clear the command lists. Call rlhCmdListReset() after the
+    terminal is resized or its atlas is changed.
+
+    A simulation thread can hand whole frames to the thread that draws without waiting for it. Call
+    rlhTermSetFramePublishing() on the drawing thread to give the terminal three command lists, and
+    record each frame into the one that rlhTermGetBackFrame() returns. rlhTermPublish() swaps the back
+    frame with the latest published frame through a single atomic exchange, and clears the frame that
+    it gets back, which keeps its memory. Every draw of the terminal appends the latest published frame
+    to the layer that was selected when publishing was enabled, and draws the same frame again when no
+    newer one was published. Frames that were published but never drawn are recycled. Resize the
+    terminal or change its atlas only while publishing is disabled. When the published frame cannot
+    be appended, the terminal is still drawn, and the draw returns the result of rlhTermSubmit().
+    Publishing needs the atomic
+    builtins of GCC, Clang, or MSVC, and returns RLH_RESULT_ERROR_UNSUPPORTED with other compilers.
+
+    Command lists can also be drawn without OpenGL, such as for screenshots on a server without a GPU.
+    rlhCmdListCreateHeadless() creates a command list from a size info and a glyph count instead of a
+    terminal, and rlhCmdListRasterize() blends its tiles into RGBA8 pixels in the order they were
+    recorded. It reads the pixels and glyph coordinates of an atlas create info, and blends them the
+    same way as the tile programs for each color type of the atlas. The pixels of the target start at
+    the top row, and tiles are blended over what is already there. Each call only writes the rows from
+    first_row of the target, so separate threads can each rasterize a band of rows of the same pixels.
+    The blend uses SSE2 when the compiler targets it. The NEON blend has not been verified on ARM yet,
+    so it is only used when RLH_RASTER_NEON is defined before implementing the header, and ARM builds
+    use the scalar blend otherwise.
+
+    The tiles of a terminal or a command list can be sent to spectators or recorded for replays with
+    a tile stream. rlhTermEncodeTiles() and rlhCmdListEncodeTiles() encode the tiles of the selected
+    layer or the command list as a snapshot, or as a delta of the runs of tiles that changed since the
+    last encode with the same stream, so the size of a delta depends on how much of the screen changed
+    instead of its size. Colors are sent as indices into a palette that both sides build as new colors
+    appear, and positions are sent relative to the tile before them. The first encode of a stream is
+    always a snapshot, and so is the next one after an error. The returned bytes belong to the stream
+    and are valid until its next encode. On the other side, rlhTileStreamApply() decodes the bytes into
+    another stream, and rlhTermPushTileStream() or rlhCmdListPushTileStream() pushes the decoded tiles
+    the same way as pushing them one at a time. A delta can only be applied to a stream that applied
+    every packet since the last snapshot, so a spectator that joins late or misses a packet waits for
+    the next snapshot. The tiles of the persistent stream mode can not be encoded.
+
+    Tiles are pushed to the selected tile layer of a terminal. Each terminal starts with a single
+    layer named "default" with a z order of 0, which is retained if RLH_RETAINED_MODE is defined
+    and immediate otherwise. Add more layers with rlhTermAddLayer() and pick the layer that pushes go
+    to with rlhTermSelectLayer(). Every layer has its own vertex buffer and stream mode. Immediate
+    layers are cleared after each draw. Retained layers keep their tiles and only upload the ones
+    that changed, until they are cleared with rlhTermClearLayer(). A retained layer for a static map
+    beneath an immediate layer for moving glyphs means the map is uploaded only when it changes.
+    Layers are drawn over the cell grid from the lowest z order to the highest.
+
+    Tiles can be animated by the vertex shader without pushing them again, which lets retained layers
+    blink, cycle, and fade with no uploads. Describe up to 255 effects of a terminal with
+    rlhTermSetEffect(), and select the effect that the following pushes get with
+    rlhTermSetPushEffect(), or change the effect of a tile that was already pushed with
+    rlhTermSetTileEffect(). Each effect moves the foreground, the background, or both colors of its
+    tiles towards the color of the effect. RLH_EFFECT_BLINK switches to that color for the second half
+    of each period, RLH_EFFECT_CYCLE moves there and back smoothly in each period, and RLH_EFFECT_FADE
+    moves there once over one period and stays there. Effects are timed from their start time by the
+    time that is set with rlhTermSetEffectTime() before a draw, and phase_per_tile shifts the phase of
+    each grid cell by its x plus y position, so neighbouring tiles can animate like waves. Tiles with
+    an effect never hide the tiles beneath them from overdraw culling, and the render cache of a
+    terminal with effects is drawn again whenever its time changes.
+
+    Worlds that are much larger than a terminal can be kept in a tilemap instead of being pushed
+    again every frame. rlhTilemapCreate() creates a tilemap of cells that are set with
+    rlhTilemapSetCell() and its packed and indexed variants, and rlhTermSetTilemap() makes a terminal
+    draw it beneath its layers. The tilemap is split into chunks of RLH_TILEMAP_CHUNK_CELLS by
+    RLH_TILEMAP_CHUNK_CELLS cells, and only the chunks that are inside of the terminal at its camera
+    position are drawn. The tiles of a chunk are built and uploaded to a vertex buffer of its own the
+    first time it is drawn, and again only after one of its cells changes, so moving the camera with
+    rlhTermSetCamera() only moves the chunks. The camera is the pixel of the tilemap at the top left
+    corner of the terminal. A tilemap can be drawn by many terminals, and it is reference counted like
+    an atlas. Chunks keep only their cells in memory, and cells in chunks that were never written take
+    no memory at all. At most RLH_TILEMAP_CHUNK_BUDGET chunks keep a vertex buffer. Once a draw goes
+    over it, the vertex buffers of the chunks that were drawn the longest time ago are deleted, and
+    those chunks are built again the next time they come into view.
+
+    Terminals that use the same font can share one atlas, so that its texture and glyph table are
+    only uploaded once. Create the atlas with rlhAtlasCreate(), and either set the atlas member of
+    rlhTermCreateInfo_t to it or call rlhTermSetSharedAtlas(). Atlases are reference counted, so
+    rlhAtlasDestroy() can be called as soon as the terminals that use it have been given it, and
+    the atlas is destroyed along with the last of them. Shader programs are also shared, and are
+    compiled once for each kind of atlas color no matter how many terminals there are. Because of
+    this, every terminal must be used with the same OpenGL context, or with contexts that share
+    objects.
+
+    A terminal can draw tiles from more than one atlas, such as a font atlas for text and a sprite
+    atlas for the map. rlhTermBindAtlas() binds a shared atlas to one of the indices from 1 to
+    RLH_MAX_TERM_ATLASES - 1, where index 0 is always the atlas of the terminal itself. Tiles are
+    pushed to the atlas selected with rlhTermSelectAtlas(), and their glyphs are checked against the
+    glyph count of that atlas. A draw call is needed for each run of tiles that share an atlas, so
+    before the tiles of an immediate layer are drawn they are grouped by atlas. A tile only moves
+    ahead of tiles of other atlases that touch none of its grid cells, so tiles that overlap are still
+    drawn in the order that they were pushed, and text and sprites that are pushed interleaved take a
+    single draw call each. Retained layers are drawn in runs in the order of their tiles, and layers in
+    the persistent stream mode, which can not be read back, take a draw call for every bound atlas with
+    the order of tiles of different atlases that overlap not kept. Tiles of an atlas that is unbound
+    or still uploading are not drawn. The cell grid and tilemaps always use atlas 0, and
+    rlhCmdListRasterize() skips tiles of the other atlases. rlhDrawBatch() draws a terminal with bound
+    atlases on its own.
+
+    Atlases can be changed after they are created, for glyph caches that rasterize glyphs as they
+    are needed. Leave pixel_data of rlhAtlasCreateInfo_t as NULL to create the texture without
+    uploading pixels, and set glyph_capacity to the amount of glyphs to make room for, with
+    glyph_count set to the glyphs that already exist (which can be 0). Then call
+    rlhAtlasUploadPixels() to upload the pixels of new glyphs to a rectangle of a page, and
+    rlhAtlasSetGlyphs() to change or append their stpqp coordinates. Only the rectangle and the
+    range of glyphs are uploaded. Appending past the glyph capacity doubles it, which uploads the
+    whole glyph table once. Every terminal that uses the atlas can push the new glyphs right away.
+    A glyph_capacity of 0 makes room for glyph_count glyphs, so zero initialize rlhAtlasCreateInfo_t
+    when you do not set it.
+
+    Atlases can also be stored in atlas files, which hold the pixels of every page in the layout that
+    is uploaded to the GPU, the stpqp coordinates of every glyph, and the color type. Write one with
+    rlhAtlasFileWrite() from the same atlas info you would create the atlas with, for example in a
+    build step after decoding a PNG. At startup, rlhAtlasCreateFromFile() creates an atlas straight
+    from a file. You can also map a file with rlhAtlasFileOpen() and pass the info returned by
+    rlhAtlasFileGetInfo() to rlhAtlasCreate() or rlhTermCreate(). Its pixel data and glyph
+    coordinates point into the mapped file, so nothing is decoded or copied. Close the file with
+    rlhAtlasFileClose() once the atlas or terminal is created. If the file is already in memory,
+    rlhAtlasFileParse() fills an atlas info with pointers into it. Files are mapped with mmap() or
+    MapViewOfFile(). Define RLH_NO_FILE_MAPPING before implementing the header to read them with
+    fread() instead. Atlas files use the byte order of the machine that wrote them. The pages of
+    every atlas are uploaded through two pixel buffer objects in turn, so copying one page overlaps
+    the transfer of the page before it.
+
+    To swap tilesets without a hitch, create the new atlas with rlhAtlasCreateAsync(). Its pixels are
+    copied to a pixel buffer object and the texture is filled from it by the driver in the background.
+    If pixel_data is NULL, write the pixels to the memory returned by rlhAtlasGetStagingPixels()
+    instead, which can be done from any thread. Then call rlhAtlasStartUpload() on the thread of the
+    OpenGL context. rlhAtlasIsReady() returns whether the upload is done without waiting for it. When
+    an atlas that is not ready is given to a terminal that already has one with
+    rlhTermSetSharedAtlas(), the terminal keeps drawing with its old atlas and switches to the new one
+    in the first draw after it is ready. Until then rlhTermGetAtlas() returns the old atlas, and
+    pushed glyphs are checked against its glyph count.
+
+    Many small terminals, such as the windows of a UI, can be drawn with rlhDrawBatch(). It takes an
+    array of terminals and an array of 16 floats per terminal with the matrix to draw each one with.
+    Terminals that are next to each other in the array and share an atlas are drawn together with a
+    single upload and draw call, and each tile is clipped to the area of its own terminal in the
+    fragment shader instead of with a scissor rect. The tiles of batched terminals are copied to a
+    shared vertex buffer every call, so batching suits terminals that change every frame better than
+    large retained ones. A terminal with the cell grid enabled starts a new draw call so that its cell
+    grid is drawn beneath its tiles.
+
+    When pushing many tiles at once, prefer the batch functions rlhTermPushGridSpan(),
+    rlhTermPushGridSpanColored(), rlhTermPushGridArray(), and rlhTermPushString() over calling
+    rlhTermPushGrid() in a loop. They reserve space in the tile buffer and mark the pushed tiles as
+    changed once for the whole batch, and the span functions clip the row to the terminal first.
+
+    Draw calls set the program, textures, vertex array, blend mode, and scissor they need every time.
+    When drawing several terminals each frame, call rlhBeginFrame() before the first draw and
+    rlhEndFrame() after the last one. In between, roguelike.h remembers the state it set and skips the
+    calls that would set it again, and the scissor of a translated draw stays enabled for the next
+    draw. rlhBeginFrame() saves the state of the caller and rlhEndFrame() restores it, so do not change
+    OpenGL state yourself between the two calls.
+
+    rlhTermGetStats() returns performance counters of a terminal: how many tiles were pushed, culled
+    because they were outside of the terminal, or rejected because their glyph is not in the atlas,
+    how many bytes were uploaded, how often the tile buffer grew and how large it got, and how many
+    draw calls were issued. The counters add up until rlhTermResetStats() is called, so reset them
+    every frame to get counts per frame. rlhTermSetGpuTiming() times the draws of a terminal with
+    GL_TIME_ELAPSED queries. Their results are read once they are available without stalling, so
+    gpu_time_ns is updated a few frames after the draw it timed. Draws of rlhDrawBatch() are not
+    timed, and a timed terminal can not be drawn while another GL_TIME_ELAPSED query is active. To feed
+    an external profiler, set a function with rlhSetStatsHook() that is called when each terminal
+    starts and finishes drawing and when a GPU time is available.
+
+    All memory of roguelike.h is allocated with malloc, realloc, and free unless an allocator is set
+    with rlhSetAllocator(), or given to a single terminal with the allocator member of
+    rlhTermCreateInfo_t, which is why that struct must be zero initialized when the member is not set.
+    Each object keeps the allocator it was created with, so changing the allocator does not affect
+    objects that already exist. Tile buffers double in size when they are full and
+    never shrink on their own. To skip growing while pushing, call rlhTermReserveTiles() with the
+    amount of tiles a layer will hold. rlhTermShrinkToFit() gives back the memory of tile buffers that are
+    larger than their tiles, and rlhTermSetShrinkPolicy() does it automatically for tile buffers that
+    stayed less than half full for a number of draws.
+
+    Resizing a terminal does not reallocate on every event while the edge of a window is dragged. When
+    a resize adds tiles, the tile buffers of its layers grow in one step in proportion to the new tile
+    count, with a quarter of headroom on top, and the cell grid gets the same headroom. Resizes that fit
+    in that room and resizes to fewer tiles keep the memory, which is left for the shrink policy.
+    rlhTermResize() works like rlhTermSetSize(), and can also scale the tiles already in the layers and
+    the camera to a new tile size, so retained layers don't have to be pushed again after the tile size
+    changes. Tiles of layers with the persistent stream mode are not scaled.
+
+    Game code often pushes a background fill, then a floor tile, an item, and a monster to the same
+    cell. With rlhTermSetOverdrawCulling() enabled, tiles of immediate layers that are hidden under later
+    grid tiles are removed right before the terminal is drawn, so they cost neither vertices nor fill
+    rate. A grid tile hides what is beneath it when it has the default tile size and both its
+    foreground and background colors are fully opaque, so the last of these pushes to a cell wins. It
+    also hides tiles in the immediate layers beneath its own. Tiles of retained layers are never
+    removed, and tiles are only removed when every cell they touch is covered. rlhTermGetStats() counts
+    the removed tiles in tiles_overdrawn.
+
+    A terminal whose tiles rarely change, such as a status panel, can keep a render cache with
+    rlhTermSetRenderCache(). The terminal is then drawn into an offscreen texture the size of its scaled
+    pixels, and every draw only draws that texture until the tiles, the cell grid, the size, or the atlas
+    of the terminal change. Retained layers and the cell grid are checked for changes without looking at
+    their tiles. Immediate layers are compared with the tiles of the last draw, so pushing the same tiles
+    every frame still draws from the cache, except in the persistent stream mode where the tiles are
+    always drawn again. rlhTermGetStats() counts the draws that drew the cache in cached_draws. The cache
+    is drawn to pixels of the same size, so it is sharp with rlhTermDraw() and rlhTermDrawTranslated(),
+    and filtered with the nearest pixel when it is scaled by a transform. rlhDrawBatch() draws the tiles
+    of every terminal without the render cache.
 
     HOW TO DEBUG
     Many functions in roguelike.h return an enum value of type rlhresult_t. Result codes with
@@ -107,6 +335,37 @@
 
         rlmhColor_s my_color = RLH_COLOR(0.5f, 0.2f, 1.0f);
 
+    When a tile is pushed to a terminal, its colors are converted to 8 bits per color channel.
+
+    Colors that are already 8 bits per channel can be pushed without converting them with the Packed
+    push functions, such as rlhTermPushGridPacked(). Packed colors are uint32_t values with red in
+    the lowest byte and alpha in the highest, which RLH_COLOR32() creates from 0 to 255 channels and
+    rlhPackColor() creates from a color struct.
+
+    Each terminal also has a palette of 256 colors that is set with rlhTermSetPalette(). The Indexed
+    push functions, such as rlhTermPushGridIndexed(), store palette indices in the tiles instead of
+    colors, and the vertex shader looks the colors up in a palette texture. Changing the palette
+    uploads it once at the next draw and changes the colors of every tile that uses it, including the
+    tiles of retained layers, which is useful for effects like day and night or a damage flash. The
+    colors of a new terminal's palette are all transparent. Command lists record palette indices and
+    are drawn with the palette of the terminal they are submitted to, but they are rasterized with
+    the palette of the terminal they took a snapshot of, or the palette set with
+    rlhCmdListSetPalette(). rlhDrawBatch() draws each terminal that has set a palette in a run of its
+    own. Tile streams send the palette indices of tiles, so the terminal on the other side needs the
+    same palette. The cell grid only takes colors.
+
+    Field of view and lighting can be applied on the GPU instead of multiplying them into the colors of
+    every pushed tile. rlhTermSetLightMap() takes an RGB light for each cell of the terminal, a mask of
+    the cells that are visible, and a mask of the cells that were explored, and uploads them at the next
+    draw as a single texture with one texel per cell. The fragment shaders of tiles, the cell grid, and
+    tilemaps multiply the colors of visible cells with their light, the colors of cells that are only
+    explored with the light set with rlhTermSetExploredLight(), and the colors of all other cells with
+    black, leaving their alpha as it is. rlhTermSetLightMapSmooth() interpolates the light between the
+    centers of cells instead of giving each cell a single light. The light map covers the cells of the
+    terminal when it is set, so set it again after a resize, and call rlhTermClearLightMap() to remove
+    it. rlhDrawBatch() draws each terminal with a light map in a run of its own, and command lists are
+    rasterized without it.
+
     HOW TO USE
     To use roguelike.h, you must bind it to an OpenGL context. There are many open source platform
     libraries for creating a window for rendering, including GLFW (https://www.glfw.org/) and SDL
@@ -126,7 +385,8 @@
     render with roguelike.h, you require a terminal object (rlhTerm_h), which represents the rectangle
     on the window you want to draw to. This terminal is created with the function rlhTermCreate(),
     which accepts a pointer to a rlhTermCreateInfo_s struct as its first argument. This struct has two
-    pointer arguments that point to two other info structs.
+    pointer arguments that point to two other info structs. Zero initialize the struct (with = {0} or
+    memset()) before setting its members, because rlhTermCreate() reads the members that you do not set.
 
     The property of rlhTermCreateInfo_s is a pointer to a rlhAtlasCreateInfo_s, which is for defining
     the atlas to render in the terminal. The atlas requires information about the image to use,
@@ -163,6 +423,23 @@
     is entirely transparent, you can use this to draw a solid color across the entire background of the
     terminal.
 
+    If most of your tiles are drawn to grid cells and do not change every frame, you can enable the
+    cell grid of a terminal with rlhTermSetGridMode(). The cell grid stores a glyph, foreground color,
+    and background color for each cell of the terminal on the GPU, which you set with rlhTermSetCell().
+    Cells are kept between draws even when RLH_RETAINED_MODE is not defined, and only the cells that
+    changed since the last draw are uploaded. The cell grid is drawn beneath the tiles of the tile
+    buffer, so you can still push free and sized tiles on top of it.
+
+    By default, the tile buffer is uploaded to the GPU by orphaning the vertex buffer and refilling
+    it. If this causes stalls with your OpenGL driver, you can change the stream mode of a terminal
+    with rlhTermSetStreamMode(). RLH_STREAM_RING copies each frame of tiles to the next segment of a
+    triple buffered ring that is synchronized with fences. RLH_STREAM_PERSISTENT maps the ring
+    persistently and writes tiles directly into GPU memory when they are pushed, which requires
+    OpenGL 4.4 or GL_ARB_buffer_storage (otherwise RLH_RESULT_ERROR_UNSUPPORTED is returned). Both
+    of these modes stream the whole tile buffer every draw, so they are not supported in retained
+    mode. The persistent mapping is write only, so rlhTermSetTile(), rlhTermSetTileEffect(), and
+    rlhTermEncodeTiles() return RLH_RESULT_ERROR_UNSUPPORTED in RLH_STREAM_PERSISTENT.
+
     Next you need to create a "render loop", or a loop which will repeat over and over again until
     the window is closed. Usually, this kind of loop can look like the following (platform libary
     specific stuff is in pseudocode):
@@ -195,6 +472,64 @@
     declarations further down in this header file.
 
     CHANGELOG
+    - Version 2.1
+        Features
+            - Tiles are stored as compact 20 byte instance records and drawn with a single instanced draw
+              call. The stpqp coordinates of each glyph are looked up in a glyph table on the GPU.
+              Terminals no longer keep an element buffer, since quad corners come from the vertex id.
+            - Added an optional GPU cell grid per terminal, set with rlhTermSetCell() and drawn with a single quad.
+            - Only upload the ranges of the tile buffer that changed since the last draw.
+            - Added rlhTermSetTile() to overwrite the glyph and colors of a tile already in the tile buffer.
+            - Added rlhTermSetStreamMode() to stream tiles with orphaning, a fenced ring buffer, or a persistently
+              mapped ring buffer.
+            - Added rlhTermPushGridSpan(), rlhTermPushGridSpanColored(), rlhTermPushGridArray(), and
+              rlhTermPushString() to push many tiles at once with a single capacity reservation.
+            - Tile colors are converted with SSE2 or NEON when available. Define RLH_NO_SIMD to disable it.
+            - Added command lists that record tiles on any thread, and rlhTermSubmit() to append them to a terminal.
+            - Added named tile layers with their own vertex buffers that are retained or cleared each draw and
+              drawn in z order.
+            - Added reference counted atlases with rlhAtlasCreate() that terminals can share, and share compiled
+              shader programs between terminals.
+            - Added rlhDrawBatch() to draw many terminals that share an atlas with one upload and one draw call.
+            - Added rlhAtlasUploadPixels() and rlhAtlasSetGlyphs() to update part of an atlas, and the
+              glyph_capacity member of rlhAtlasCreateInfo_t to make room for glyphs that are added later.
+            - Added an atlas file format that is mapped into memory with rlhAtlasFileOpen() and loaded without
+              decoding or copying, and upload atlas pages through pixel buffer objects.
+            - Added rlhAtlasCreateAsync() and rlhAtlasIsReady() to upload atlases without blocking, and terminals
+              keep drawing with their old atlas until a shared atlas that replaces it is ready.
+            - Added rlhBeginFrame() and rlhEndFrame() to skip OpenGL state changes that are already in effect.
+            - Added per terminal performance counters with rlhTermGetStats(), GPU timing of draws with
+              rlhTermSetGpuTiming(), and rlhSetStatsHook() to pass them to a profiler.
+            - Added the rlh_bench benchmark project, built with RLH_BUILD_BENCH, that runs repeatable scenarios offscreen.
+            - Added rlhSetAllocator() and the allocator member of rlhTermCreateInfo_t to allocate memory with custom
+              functions, and rlhTermReserveTiles(), rlhTermShrinkToFit(), and rlhTermSetShrinkPolicy() to control
+              the capacity of tile buffers.
+            - Added rlhTermSetOverdrawCulling() to remove tiles that are covered by opaque grid tiles before drawing.
+            - Added rlhTermSetRenderCache() to draw terminals that did not change from an offscreen texture.
+            - Added rlhTermSetFramePublishing() and rlhTermPublish() to hand frames from another thread to the
+              drawing thread without locks.
+            - The draw functions return the result of appending the published frame of a terminal.
+            - Added rlhCmdListCreateHeadless() and rlhCmdListRasterize() to draw command lists into pixels on the CPU.
+            - The NEON blend of rlhCmdListRasterize() is only used when RLH_RASTER_NEON is defined.
+            - Added tile streams to encode the tiles of terminals as snapshots and deltas for spectators and replays.
+            - Added push functions that take packed RGBA8 colors or indices into a palette of the terminal.
+            - Added tile effects that blink, cycle, and fade the colors of tiles in the vertex shader.
+            - Added chunked tilemaps that terminals draw at a camera position without pushing their tiles.
+            - Evict the vertex buffers of the least recently drawn tilemap chunks past RLH_TILEMAP_CHUNK_BUDGET.
+            - Added multiple atlases per terminal, with the tiles of immediate layers grouped into a draw call per atlas.
+            - Added the optional C++20 header roguelike.hpp with owning handles and compile time sized terminals, and
+              rlhTermBeginTileWrite() and rlhTermEndTileWrite() to write tiles straight into a tile buffer.
+            - Added rlhTermResize(), which can scale the tiles of a terminal to a new tile size, and made resizes reserve
+              tile buffers and the cell grid with headroom instead of reallocating on every window event.
+            - Added light maps with visible and explored cells that the fragment shaders apply to the colors of tiles.
+        Bugfixes
+            - Fixed tiles being positioned and culled incorrectly when the pixel scale is not 1.
+            - Fixed tiles with negative pixel positions always being culled.
+            - Fixed glyph indices equal to the glyph count of an atlas being accepted as in range.
+            - Fixed rlhTermSetSize() not returning a result.
+            - Fixed the scissor rect of rlhTermDrawTranslated() and rlhTermDrawTransformed() using the x translation
+              to compute its y position.
+            - Fixed the MAX macro not parenthesizing its arguments.
     - Version 2.0
         Features
             - Depreciated rlhAtlas_s, and all atlas manipulation is done directly with rlhTerminal_s.
@@ -261,6 +596,8 @@ extern "C"
 
 // custom color macros
 #define RLH_COLOR(red, green, blue, alpha) ((rlhColor_s){(red), (green), (blue), (alpha)})
+// create a packed color from channels between 0 and 255
+#define RLH_COLOR32(red, green, blue, alpha) ((uint32_t)(red) | ((uint32_t)(green) << 8) | ((uint32_t)(blue) << 16) | ((uint32_t)(alpha) << 24))
 
 // standard color macros
 #define RLH_RED ((rlhColor_s){(1.0f), (0.0f), (0.0f), (1.0f)})
@@ -290,6 +627,11 @@ extern "C"
   typedef uint16_t rlhglyph_t;
 
   typedef struct rlhTerm_s *rlhTerm_h;
+  typedef struct rlhCmdList_s *rlhCmdList_h;
+  typedef struct rlhTileStream_s *rlhTileStream_h;
+  typedef struct rlhTilemap_s *rlhTilemap_h;
+  typedef struct rlhAtlas_s *rlhAtlas_h;
+  typedef struct rlhAtlasFile_s *rlhAtlasFile_h;
 
   typedef enum rlhresult_t
   {
@@ -297,6 +639,8 @@ extern "C"
     RLH_RESULT_ERROR_NULL_ARGUMENT = 1,
     RLH_RESULT_ERROR_INVALID_VALUE = 2,
     RLH_RESULT_ERROR_OUT_OF_MEMORY = 3,
+    RLH_RESULT_ERROR_UNSUPPORTED = 4,
+    RLH_RESULT_ERROR_FILE = 5,
     RLH_RESULT_COUNT
   } rlhresult_t;
 
@@ -337,6 +681,96 @@ extern "C"
     RLH_VALIGN_COUNT
   } rlhtermvalign_t;
 
+  typedef enum rlhstreammode_t
+  {
+    RLH_STREAM_ORPHAN,
+    RLH_STREAM_RING,
+    RLH_STREAM_PERSISTENT,
+    RLH_STREAM_MODE_COUNT
+  } rlhstreammode_t;
+
+  typedef enum rlhlayermode_t
+  {
+    RLH_LAYER_IMMEDIATE,
+    RLH_LAYER_RETAINED,
+    RLH_LAYER_MODE_COUNT
+  } rlhlayermode_t;
+
+#define RLH_MAX_LAYER_NAME_LENGTH 31
+
+  typedef struct rlhGridTile_s
+  {
+    int grid_x;
+    int grid_y;
+    rlhglyph_t glyph;
+    rlhColor_s fg;
+    rlhColor_s bg;
+  } rlhGridTile_s;
+
+  // One tile in the tile buffer of a terminal. Each tile is drawn as one instance of a quad, and the
+  // vertex shader looks up the stpqp coordinates of the glyph in the glyph table of the terminal.
+  // Tiles are moved by the offset, and clipped to the terminal when tilemap chunks enable the clip
+  // planes. The two high bits of the glyph are set when the first byte of a color is an index into the
+  // palette, the third byte of the glyph is the effect of the tile, and the three bits above it are its
+  // atlas. The colors are 8 bits per channel with red first.
+  typedef struct rlhTileInstance_s
+  {
+    int16_t pixel_x;
+    int16_t pixel_y;
+    int16_t pixel_w;
+    int16_t pixel_h;
+    uint32_t glyph;
+    uint8_t fg[4];
+    uint8_t bg[4];
+  } rlhTileInstance_s;
+
+  // Room at the end of the selected tile buffer of a terminal that tiles are written to directly.
+  typedef struct rlhTileWrite_t
+  {
+    rlhTileInstance_s *tiles;
+    // tiles must have a glyph below glyph_count, and glyph_bits set in their glyph.
+    int glyph_count;
+    uint32_t glyph_bits;
+  } rlhTileWrite_t;
+
+  // Performance counters of a terminal, counted since it was created or since rlhTermResetStats().
+  typedef struct rlhTermStats_t
+  {
+    // tiles added to the tile buffers of the terminal
+    uint64_t tiles_pushed;
+    // tiles that were not added because they were outside of the terminal, or past the 16 bit pixel limit
+    uint64_t tiles_culled;
+    // tiles that were not added because their glyph is not in the atlas
+    uint64_t tiles_rejected;
+    // tiles that were removed before they were drawn because opaque grid tiles pushed after them covered them
+    uint64_t tiles_overdrawn;
+    // bytes of tiles and grid cells uploaded to the GPU
+    uint64_t bytes_uploaded;
+    // how many times a tile buffer of the terminal grew
+    uint64_t tile_buffer_reallocs;
+    // the most tiles that a tile buffer of the terminal had room for
+    uint64_t peak_tile_capacity;
+    uint64_t draw_calls;
+    // draws that drew the render cache of the terminal instead of its tiles
+    uint64_t cached_draws;
+    // the GPU time of the last timed draw, and of every timed draw, in nanoseconds
+    uint64_t gpu_time_ns;
+    uint64_t total_gpu_time_ns;
+    uint64_t timed_draws;
+  } rlhTermStats_t;
+
+  typedef enum rlhstatsevent_t
+  {
+    RLH_STATS_DRAW_BEGIN,
+    RLH_STATS_DRAW_END,
+    RLH_STATS_GPU_TIME,
+    RLH_STATS_EVENT_COUNT
+  } rlhstatsevent_t;
+
+  // Called with the terminal and its counters when it starts and finishes drawing, and when the GPU time of one of
+  // its draws is available. For the draws of rlhDrawBatch() the terminal and the counters are NULL.
+  typedef void (*rlhStatsHook_f)(rlhTerm_h const term, const rlhstatsevent_t event, const rlhTermStats_t *const stats, void *const user_data);
+
   typedef struct rlhAtlasCreateInfo_t
   {
     int width;
@@ -347,6 +781,9 @@ extern "C"
     uint8_t *pixel_data;
     int glyph_count;
     float *glyph_stpqp;
+    // the amount of glyphs to make room for in the glyph table, if more than glyph_count. 0 is the default,
+    // which makes room for glyph_count glyphs, so zero initialize the struct before setting its members.
+    int glyph_capacity;
   } rlhAtlasCreateInfo_t;
 
   typedef struct rlhTermSizeInfo_t
@@ -360,22 +797,136 @@ extern "C"
     int tile_height;
   } rlhTermSizeInfo_t;
 
+  // Functions that memory is allocated with, which work like malloc, realloc, and free. All three
+  // functions must be set, or all three NULL to use malloc, realloc, and free.
+  typedef struct rlhAllocator_t
+  {
+    void *(*allocate)(size_t size, void *user_data);
+    void *(*reallocate)(void *memory, size_t size, void *user_data);
+    void (*deallocate)(void *memory, void *user_data);
+    void *user_data;
+  } rlhAllocator_t;
+
+  // Zero initialize this struct before setting its members. The members that are not set must be NULL.
   typedef struct rlhTermCreateInfo_t
   {
     rlhTermSizeInfo_t *size_info;
     rlhAtlasCreateInfo_t *atlas_info;
+    // a shared atlas to use instead of creating one from atlas_info.
+    rlhAtlas_h atlas;
+    // the allocator of the memory of the terminal, or NULL to use the one set with rlhSetAllocator(). It is
+    // read even when it is not set, so a struct that is not zero initialized passes a garbage allocator.
+    const rlhAllocator_t *allocator;
   } rlhTermCreateInfo_t;
 
+  // RGBA8 pixels that rlhCmdListRasterize() draws into.
+  typedef struct rlhRasterTarget_t
+  {
+    // the pixels, starting at the top row
+    uint8_t *pixels;
+    int width;
+    int height;
+    // the bytes from the start of a row to the start of the next one, or 0 for width * 4
+    int row_stride;
+    // the rows that are drawn, or a row count of 0 to draw to the last row
+    int first_row;
+    int row_count;
+  } rlhRasterTarget_t;
+
+  typedef enum rlheffecttype_t
+  {
+    RLH_EFFECT_NONE,
+    // switch to the effect color for the second half of each period
+    RLH_EFFECT_BLINK,
+    // move to the effect color and back over each period
+    RLH_EFFECT_CYCLE,
+    // move to the effect color over one period and stay there
+    RLH_EFFECT_FADE,
+    RLH_EFFECT_TYPE_COUNT
+  } rlheffecttype_t;
+
+  // Bits of the colors of a tile that an effect changes.
+  typedef enum rlheffecttarget_t
+  {
+    RLH_EFFECT_TARGET_FG = 1,
+    RLH_EFFECT_TARGET_BG = 2,
+    RLH_EFFECT_TARGET_BOTH = 3
+  } rlheffecttarget_t;
+
+  // An effect that animates the colors of tiles by the effect time of their terminal.
+  typedef struct rlhTileEffect_t
+  {
+    rlheffecttype_t type;
+    // bits from rlheffecttarget_t
+    int targets;
+    rlhColor_s color;
+    // seconds of one blink or cycle, or of the fade
+    float period;
+    // the effect time that the first period starts at
+    float start_time;
+    // periods that the phase of each grid cell is ahead by for each cell of x plus y position
+    float phase_per_tile;
+  } rlhTileEffect_t;
+
+  // Set the allocator that objects created after this allocate their memory with, or NULL to use malloc, realloc,
+  // and free. Objects keep the allocator they were created with.
+  rlhresult_t rlhSetAllocator(const rlhAllocator_t *const allocator);
+  // Start a frame. Until rlhEndFrame() is called, OpenGL state that an earlier draw already set is not set again.
+  void rlhBeginFrame(void);
+  // End a frame and restore the OpenGL state from before rlhBeginFrame().
+  void rlhEndFrame(void);
   // Clear the color of the console area with a solid color.
   void rlhClearColor(const rlhColor_s color);
   // Set viewport area to draw to.
   void rlhViewport(int x, int y, int width, int height);
+  // Create an atlas that can be shared by many terminals.
+  rlhresult_t rlhAtlasCreate(rlhAtlasCreateInfo_t *atlas_info, rlhAtlas_h *atlas);
+  // Release the reference to an atlas that rlhAtlasCreate() returned. The atlas is destroyed when no terminal uses it.
+  void rlhAtlasDestroy(rlhAtlas_h const atlas);
+  // Create an atlas that uploads its pixels without blocking. Check when the upload is done with rlhAtlasIsReady().
+  rlhresult_t rlhAtlasCreateAsync(rlhAtlasCreateInfo_t *atlas_info, rlhAtlas_h *atlas);
+  // Get the memory that the pixels of an atlas created asynchronously without pixel data are staged in. It can be
+  // written to from any thread until rlhAtlasStartUpload() is called.
+  uint8_t *rlhAtlasGetStagingPixels(rlhAtlas_h const atlas);
+  // Start uploading the staged pixels of an atlas created asynchronously without pixel data.
+  rlhresult_t rlhAtlasStartUpload(rlhAtlas_h const atlas);
+  // Check if the pixels of an atlas are done uploading, without waiting for them.
+  rlhbool_t rlhAtlasIsReady(rlhAtlas_h const atlas);
+  // Create an atlas from an atlas file.
+  rlhresult_t rlhAtlasCreateFromFile(const char *const path, rlhAtlas_h *atlas);
+  // Get the amount of glyphs in an atlas.
+  int rlhAtlasGetGlyphCount(rlhAtlas_h const atlas);
+  // Get the color type of an atlas.
+  rlhcolortype_t rlhAtlasGetColor(rlhAtlas_h const atlas);
+  // Upload a rectangle of pixels to a page of an atlas. The pixels must have the color type and channel size of the atlas.
+  rlhresult_t rlhAtlasUploadPixels(rlhAtlas_h const atlas, const int x, const int y, const int page, const int width, const int height, const uint8_t *const pixel_data);
+  // Set the stpqp coordinates of a range of glyphs in an atlas. Glyphs past the last glyph of the atlas are appended to it.
+  rlhresult_t rlhAtlasSetGlyphs(rlhAtlas_h const atlas, const int first_glyph, const int glyph_count, const float *const glyph_stpqp);
   // Create a terminal.
   rlhresult_t rlhTermCreate(rlhTermCreateInfo_t *term_info, rlhTerm_h *term);
   // Destroy a term object and free all of its resources.
   void rlhTermDestroy(rlhTerm_h const term);
   // Set the atlas of a terminal.
   rlhresult_t rlhTermSetAtlas(rlhTerm_h const term, rlhAtlasCreateInfo_t *atlas_info);
+  // Set a terminal to use a shared atlas. If an atlas that is still uploading replaces another atlas, the terminal
+  // draws with the old atlas until the new one is ready.
+  rlhresult_t rlhTermSetSharedAtlas(rlhTerm_h const term, rlhAtlas_h const atlas);
+  // Get the atlas that a terminal uses.
+  rlhAtlas_h rlhTermGetAtlas(rlhTerm_h const term);
+  // Bind a shared atlas to an index from 1 to RLH_MAX_TERM_ATLASES - 1 of a terminal, or unbind it with NULL.
+  rlhresult_t rlhTermBindAtlas(rlhTerm_h const term, const int atlas_index, rlhAtlas_h const atlas);
+  // Select the atlas index that pushed tiles take their glyphs from, where 0 is the atlas of the terminal.
+  rlhresult_t rlhTermSelectAtlas(rlhTerm_h const term, const int atlas_index);
+  // Write the pixels, glyph coordinates and color type of an atlas to an atlas file.
+  rlhresult_t rlhAtlasFileWrite(const char *const path, const rlhAtlasCreateInfo_t *const atlas_info);
+  // Map an atlas file into memory.
+  rlhresult_t rlhAtlasFileOpen(const char *const path, rlhAtlasFile_h *atlas_file);
+  // Unmap an atlas file. The atlas info of the file can not be used anymore after this.
+  void rlhAtlasFileClose(rlhAtlasFile_h const atlas_file);
+  // Get the atlas info of an atlas file, which points into the mapped file.
+  rlhAtlasCreateInfo_t *rlhAtlasFileGetInfo(rlhAtlasFile_h const atlas_file);
+  // Fill an atlas info with pointers into an atlas file that is already in memory, without copying it.
+  rlhresult_t rlhAtlasFileParse(const void *const data, const size_t size, rlhAtlasCreateInfo_t *const atlas_info);
   // Get the amount of glyphs in a terminal's atlas.
   int rlhTermGetGlyphCount(rlhTerm_h const term);
   // Get the size ratio of a terminal pixel per screen pixel.
@@ -390,10 +941,39 @@ extern "C"
   void rlhTermGetTileSize(rlhTerm_h const term, int *const tile_width, int *const tile_height);
   // Resize a terminal object.
   rlhresult_t rlhTermSetSize(rlhTerm_h const term, rlhTermSizeInfo_t *const size_info);
+  // Resize a terminal object and reserve room in its tile buffers for the new tile count in one step. With
+  // rescale_tiles, the tiles already in the layers are scaled to the new tile size instead of being pushed again.
+  // The terminal is resized even if reserving fails with RLH_RESULT_ERROR_OUT_OF_MEMORY.
+  rlhresult_t rlhTermResize(rlhTerm_h const term, rlhTermSizeInfo_t *const size_info, const rlhbool_t rescale_tiles);
   // Clear a terminal's data buffer.
   rlhresult_t rlhTermClearTileData(rlhTerm_h const term);
+  // Set how the tile buffer of a terminal is streamed to the vertex buffer on the GPU. This clears the tile buffer.
+  rlhresult_t rlhTermSetStreamMode(rlhTerm_h const term, const rlhstreammode_t stream_mode);
+  // Get how the tile buffer of a terminal is streamed to the vertex buffer on the GPU.
+  rlhstreammode_t rlhTermGetStreamMode(rlhTerm_h const term);
+  // Add a tile layer to a terminal. Layers are drawn from the lowest z order to the highest, and layers with the same
+  // z order are drawn in the order they were added. Immediate layers are cleared after each draw, and retained layers
+  // keep their tiles until they are cleared.
+  rlhresult_t rlhTermAddLayer(rlhTerm_h const term, const char *const name, const int z_order, const rlhlayermode_t mode, int *const layer);
+  // Get the index of the tile layer of a terminal with a name.
+  rlhresult_t rlhTermFindLayer(rlhTerm_h const term, const char *const name, int *const layer);
+  // Select the tile layer of a terminal that pushes and the tile buffer functions apply to.
+  rlhresult_t rlhTermSelectLayer(rlhTerm_h const term, const int layer);
+  // Get the index of the selected tile layer of a terminal.
+  int rlhTermGetSelectedLayer(rlhTerm_h const term);
+  // Get the amount of tile layers in a terminal.
+  int rlhTermGetLayerCount(rlhTerm_h const term);
+  // Clear the tile buffer of a tile layer of a terminal.
+  rlhresult_t rlhTermClearLayer(rlhTerm_h const term, const int layer);
   // Get how many tiles have been set since the last clear.
   int rlhTermGetTileDataCount(rlhTerm_h const term);
+  // Make room for at least tile_count tiles in the tile buffer of the selected layer of a terminal.
+  rlhresult_t rlhTermReserveTiles(rlhTerm_h const term, const int tile_count);
+  // Shrink the tile buffers of every layer of a terminal to the tiles they hold.
+  rlhresult_t rlhTermShrinkToFit(rlhTerm_h const term);
+  // Shrink a tile buffer of a terminal when it had room for more than twice as many tiles as it held at most over
+  // the last window_draws draws of the terminal. 0 never shrinks tile buffers, which is the default.
+  rlhresult_t rlhTermSetShrinkPolicy(rlhTerm_h const term, const int window_draws);
   // Push a tile to the terminal that is stretched over the entire terminal area.
   rlhresult_t rlhTermPushFill(rlhTerm_h const term, const uint16_t glyph, const rlhColor_s fg, const rlhColor_s bg);
   // Push a tile to a terminal in a grid cell position with default pixel width and pixel height.
@@ -404,6 +984,176 @@ extern "C"
   rlhresult_t rlhTermPushFree(rlhTerm_h const term, const int screen_pixel_x, const int screen_pixel_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
   // Push a tile to a terminal in a pixel position with a custom pixel width and pixel height.
   rlhresult_t rlhTermPushFreeSized(rlhTerm_h const term, const int screen_pixel_x, const int screen_pixel_y, const int tile_pixel_width, const int tile_pixel_height, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
+  // Overwrite the glyph and colors of a tile in the tile buffer of a terminal, keeping its position and size. The
+  // index of a tile is the value rlhTermGetTileDataCount() returned right before it was pushed. Returns
+  // RLH_RESULT_ERROR_UNSUPPORTED in the RLH_STREAM_PERSISTENT stream mode.
+  rlhresult_t rlhTermSetTile(rlhTerm_h const term, const int tile_index, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
+  // Set an effect of a terminal, from 1 to 255.
+  rlhresult_t rlhTermSetEffect(rlhTerm_h const term, const int effect, const rlhTileEffect_t *const effect_info);
+  // Set the time in seconds that the effects of a terminal are drawn at.
+  rlhresult_t rlhTermSetEffectTime(rlhTerm_h const term, const float seconds);
+  // Set the effect that tiles pushed to a terminal get, or 0 for none.
+  rlhresult_t rlhTermSetPushEffect(rlhTerm_h const term, const int effect);
+  // Set the effect of a tile in the tile buffer of a terminal, or 0 for none. Returns RLH_RESULT_ERROR_UNSUPPORTED
+  // in the RLH_STREAM_PERSISTENT stream mode.
+  rlhresult_t rlhTermSetTileEffect(rlhTerm_h const term, const int tile_index, const int effect);
+  // Enable or disable the cell grid of a terminal. The cell grid keeps a glyph, foreground color, and background color
+  // for every grid cell on the GPU, and is drawn beneath the tiles in the tile buffer.
+  rlhresult_t rlhTermSetGridMode(rlhTerm_h const term, const rlhbool_t enabled);
+  // Get if the cell grid of a terminal is enabled.
+  rlhbool_t rlhTermGetGridMode(rlhTerm_h const term);
+  // Set the glyph and colors of a cell in the cell grid of a terminal.
+  rlhresult_t rlhTermSetCell(rlhTerm_h const term, const int grid_x, const int grid_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
+  // Clear every cell in the cell grid of a terminal so that they are transparent.
+  rlhresult_t rlhTermClearCells(rlhTerm_h const term);
+  // Enable or disable removing the tiles of immediate layers that are covered by grid tiles with an opaque foreground
+  // and background color that are drawn after them, right before a terminal is drawn.
+  rlhresult_t rlhTermSetOverdrawCulling(rlhTerm_h const term, const rlhbool_t enabled);
+  // Get if overdraw culling of a terminal is enabled.
+  rlhbool_t rlhTermGetOverdrawCulling(rlhTerm_h const term);
+  // Enable or disable drawing a terminal into an offscreen texture, and drawing that texture instead of the tiles
+  // of the terminal until they change.
+  rlhresult_t rlhTermSetRenderCache(rlhTerm_h const term, const rlhbool_t enabled);
+  // Get if the render cache of a terminal is enabled.
+  rlhbool_t rlhTermGetRenderCache(rlhTerm_h const term);
+  // Push a row of tiles to a terminal starting at a grid cell position, all with the same colors.
+  rlhresult_t rlhTermPushGridSpan(rlhTerm_h const term, const int grid_x, const int grid_y, const rlhglyph_t *const glyphs, const int glyph_count, const rlhColor_s fg, const rlhColor_s bg);
+  // Push a row of tiles to a terminal starting at a grid cell position, with a foreground and background color per tile.
+  rlhresult_t rlhTermPushGridSpanColored(rlhTerm_h const term, const int grid_x, const int grid_y, const rlhglyph_t *const glyphs, const rlhColor_s *const fgs, const rlhColor_s *const bgs, const int glyph_count);
+  // Push an array of tiles to grid cell positions of a terminal.
+  rlhresult_t rlhTermPushGridArray(rlhTerm_h const term, const rlhGridTile_s *const tiles, const int tile_count);
+  // Make room for up to tile_count tiles at the end of the selected tile buffer of a terminal, to be written
+  // directly by wrappers that check and pack their tiles themselves. Written tiles are not checked, so they
+  // must be inside of the terminal and follow the rules in write. Nothing else may change the terminal before
+  // rlhTermEndTileWrite().
+  rlhresult_t rlhTermBeginTileWrite(rlhTerm_h const term, const int tile_count, rlhTileWrite_t *const write);
+  // Add the first tile_count tiles written since rlhTermBeginTileWrite() to the tile buffer of a terminal, and count
+  // rejected_count tiles that the writer dropped for their glyph in the stats of the terminal.
+  rlhresult_t rlhTermEndTileWrite(rlhTerm_h const term, const int tile_count, const int rejected_count);
+  // Push a null terminated string to a terminal as a row of tiles starting at a grid cell position. Each byte of the
+  // string is used as a glyph index.
+  rlhresult_t rlhTermPushString(rlhTerm_h const term, const int grid_x, const int grid_y, const char *const string, const rlhColor_s fg, const rlhColor_s bg);
+  // Pack a color into a uint32_t with 8 bits per channel, with red in the lowest byte.
+  uint32_t rlhPackColor(const rlhColor_s color);
+  // Push a tile to a terminal in a grid cell position with packed colors.
+  rlhresult_t rlhTermPushGridPacked(rlhTerm_h const term, const int grid_x, const int grid_y, const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg);
+  // Push a tile to a terminal in a free pixel position with packed colors.
+  rlhresult_t rlhTermPushFreePacked(rlhTerm_h const term, const int screen_pixel_x, const int screen_pixel_y, const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg);
+  // Set a range of colors in the palette of a terminal, starting at the palette index first_index.
+  rlhresult_t rlhTermSetPalette(rlhTerm_h const term, const int first_index, const uint32_t *const colors, const int color_count);
+  // Push a tile to a terminal in a grid cell position with colors from the palette of the terminal.
+  rlhresult_t rlhTermPushGridIndexed(rlhTerm_h const term, const int grid_x, const int grid_y, const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index);
+  // Push a tile to a terminal in a free pixel position with colors from the palette of the terminal.
+  rlhresult_t rlhTermPushFreeIndexed(rlhTerm_h const term, const int screen_pixel_x, const int screen_pixel_y, const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index);
+  // Push a row of tiles to a terminal starting at a grid cell position, all with the same colors from the palette.
+  rlhresult_t rlhTermPushGridSpanIndexed(rlhTerm_h const term, const int grid_x, const int grid_y, const rlhglyph_t *const glyphs, const int glyph_count, const uint8_t fg_index, const uint8_t bg_index);
+  // Set the light map of a terminal with a value for each cell of the terminal in rows from the top left. light has
+  // three bytes of RGB light per cell, or is NULL for full light. visible and explored have a byte per cell that
+  // is nonzero for visible and explored cells. With no visible mask every cell is visible, and with no explored
+  // mask the cells that are not visible are unexplored.
+  rlhresult_t rlhTermSetLightMap(rlhTerm_h const term, const uint8_t *const light, const uint8_t *const visible, const uint8_t *const explored);
+  // Remove the light map of a terminal.
+  rlhresult_t rlhTermClearLightMap(rlhTerm_h const term);
+  // Set if the light map of a terminal is interpolated between the centers of cells.
+  rlhresult_t rlhTermSetLightMapSmooth(rlhTerm_h const term, const rlhbool_t smooth);
+  // Set the light of cells of a light map that are explored but not visible. Only the RGB channels are used.
+  rlhresult_t rlhTermSetExploredLight(rlhTerm_h const term, const rlhColor_s light);
+  // Create a command list that records tiles against a snapshot of the size and glyph count of a terminal.
+  rlhresult_t rlhCmdListCreate(rlhTerm_h const term, rlhCmdList_h *cmd_list);
+  // Create a command list that records tiles against a terminal size and a glyph count, without a terminal or an
+  // OpenGL context.
+  rlhresult_t rlhCmdListCreateHeadless(rlhTermSizeInfo_t *const size_info, const int glyph_count, rlhCmdList_h *cmd_list);
+  // Destroy a command list and free all of its resources.
+  void rlhCmdListDestroy(rlhCmdList_h const cmd_list);
+  // Clear the recorded tiles of a command list and take a new snapshot of a terminal.
+  rlhresult_t rlhCmdListReset(rlhCmdList_h const cmd_list, rlhTerm_h const term);
+  // Clear the recorded tiles of a command list.
+  rlhresult_t rlhCmdListClear(rlhCmdList_h const cmd_list);
+  // Get how many tiles have been recorded in a command list since the last clear.
+  int rlhCmdListGetTileCount(rlhCmdList_h const cmd_list);
+  // Blend the tiles of a command list into the rows of a target on the CPU, with the pixels and glyphs of an atlas.
+  // Each pixel of the terminal covers pixel_scale target pixels in both directions.
+  rlhresult_t rlhCmdListRasterize(rlhCmdList_h const cmd_list, const rlhAtlasCreateInfo_t *const atlas_info, const rlhRasterTarget_t *const target);
+  // Record a tile in a command list that is stretched over the entire terminal area.
+  rlhresult_t rlhCmdListPushFill(rlhCmdList_h const cmd_list, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
+  // Record a tile in a command list in a grid cell position with default pixel width and pixel height.
+  rlhresult_t rlhCmdListPushGrid(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
+  // Record a tile in a command list in a grid cell position with a custom pixel width and pixel height.
+  rlhresult_t rlhCmdListPushGridSized(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y, const int tile_pixel_width, const int tile_pixel_height, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
+  // Record a tile in a command list in a pixel position with a default pixel width and pixel height.
+  rlhresult_t rlhCmdListPushFree(rlhCmdList_h const cmd_list, const int screen_pixel_x, const int screen_pixel_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
+  // Record a tile in a command list in a pixel position with a custom pixel width and pixel height.
+  rlhresult_t rlhCmdListPushFreeSized(rlhCmdList_h const cmd_list, const int screen_pixel_x, const int screen_pixel_y, const int tile_pixel_width, const int tile_pixel_height, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
+  // Record a row of tiles in a command list starting at a grid cell position, all with the same colors.
+  rlhresult_t rlhCmdListPushGridSpan(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y, const rlhglyph_t *const glyphs, const int glyph_count, const rlhColor_s fg, const rlhColor_s bg);
+  // Record a row of tiles in a command list starting at a grid cell position, with a foreground and background color per tile.
+  rlhresult_t rlhCmdListPushGridSpanColored(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y, const rlhglyph_t *const glyphs, const rlhColor_s *const fgs, const rlhColor_s *const bgs, const int glyph_count);
+  // Record an array of tiles in grid cell positions in a command list.
+  rlhresult_t rlhCmdListPushGridArray(rlhCmdList_h const cmd_list, const rlhGridTile_s *const tiles, const int tile_count);
+  // Record a null terminated string in a command list as a row of tiles starting at a grid cell position.
+  rlhresult_t rlhCmdListPushString(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y, const char *const string, const rlhColor_s fg, const rlhColor_s bg);
+  // Record a tile in a command list in a grid cell position with packed colors.
+  rlhresult_t rlhCmdListPushGridPacked(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y, const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg);
+  // Record a tile in a command list in a free pixel position with packed colors.
+  rlhresult_t rlhCmdListPushFreePacked(rlhCmdList_h const cmd_list, const int screen_pixel_x, const int screen_pixel_y, const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg);
+  // Set the effect that tiles recorded in a command list get, or 0 for none.
+  rlhresult_t rlhCmdListSetPushEffect(rlhCmdList_h const cmd_list, const int effect);
+  // Select the atlas index that tiles recorded in a command list take their glyphs from.
+  rlhresult_t rlhCmdListSelectAtlas(rlhCmdList_h const cmd_list, const int atlas_index);
+  // Set a range of colors in the palette that a command list is rasterized with.
+  rlhresult_t rlhCmdListSetPalette(rlhCmdList_h const cmd_list, const int first_index, const uint32_t *const colors, const int color_count);
+  // Record a tile in a command list in a grid cell position with palette indices.
+  rlhresult_t rlhCmdListPushGridIndexed(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y, const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index);
+  // Record a tile in a command list in a free pixel position with palette indices.
+  rlhresult_t rlhCmdListPushFreeIndexed(rlhCmdList_h const cmd_list, const int screen_pixel_x, const int screen_pixel_y, const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index);
+  // Record a row of tiles in a command list starting at a grid cell position, all with the same palette indices.
+  rlhresult_t rlhCmdListPushGridSpanIndexed(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y, const rlhglyph_t *const glyphs, const int glyph_count, const uint8_t fg_index, const uint8_t bg_index);
+  // Append the tiles recorded in command lists to the tile buffer of a terminal, in the order of the array.
+  rlhresult_t rlhTermSubmit(rlhTerm_h const term, const rlhCmdList_h *const cmd_lists, const int cmd_list_count);
+  // Enable or disable publishing frames that are recorded on another thread to a terminal. Published frames are drawn
+  // in the layer that is selected when publishing is enabled.
+  rlhresult_t rlhTermSetFramePublishing(rlhTerm_h const term, const rlhbool_t enabled);
+  // Get if frame publishing of a terminal is enabled.
+  rlhbool_t rlhTermGetFramePublishing(rlhTerm_h const term);
+  // Get the command list that the next frame of a terminal is recorded into. Only call this on the thread that
+  // publishes frames.
+  rlhCmdList_h rlhTermGetBackFrame(rlhTerm_h const term);
+  // Publish the back frame of a terminal to be drawn, and replace it with a cleared frame that is not used anymore.
+  rlhresult_t rlhTermPublish(rlhTerm_h const term);
+  // Create a tile stream that encodes or decodes the tiles of a terminal.
+  rlhresult_t rlhTileStreamCreate(rlhTileStream_h *stream);
+  // Destroy a tile stream and free all of its resources.
+  void rlhTileStreamDestroy(rlhTileStream_h const stream);
+  // Encode the tiles of the selected layer of a terminal as a snapshot, or as a delta from the last encode of a stream.
+  // The bytes belong to the stream and are valid until its next encode.
+  rlhresult_t rlhTermEncodeTiles(rlhTerm_h const term, rlhTileStream_h const stream, const rlhbool_t snapshot, const uint8_t **const data, size_t *const size);
+  // Encode the tiles of a command list as a snapshot, or as a delta from the last encode of a stream.
+  // The bytes belong to the stream and are valid until its next encode.
+  rlhresult_t rlhCmdListEncodeTiles(rlhCmdList_h const cmd_list, rlhTileStream_h const stream, const rlhbool_t snapshot, const uint8_t **const data, size_t *const size);
+  // Decode encoded tiles into a tile stream. A delta needs the stream to have applied every packet since the last snapshot.
+  rlhresult_t rlhTileStreamApply(rlhTileStream_h const stream, const uint8_t *const data, const size_t size);
+  // Push the decoded tiles of a tile stream to a terminal.
+  rlhresult_t rlhTermPushTileStream(rlhTerm_h const term, rlhTileStream_h const stream);
+  // Record the decoded tiles of a tile stream in a command list.
+  rlhresult_t rlhCmdListPushTileStream(rlhCmdList_h const cmd_list, rlhTileStream_h const stream);
+  // Create a tilemap of cells that terminals draw beneath their layers.
+  rlhresult_t rlhTilemapCreate(const int cells_wide, const int cells_tall, rlhTilemap_h *tilemap);
+  // Destroy a tilemap. Terminals that draw the tilemap keep it until they stop drawing it.
+  void rlhTilemapDestroy(rlhTilemap_h const tilemap);
+  // Get the size of a tilemap in cells.
+  void rlhTilemapGetSize(rlhTilemap_h const tilemap, int *const cells_wide, int *const cells_tall);
+  // Set a cell of a tilemap.
+  rlhresult_t rlhTilemapSetCell(rlhTilemap_h const tilemap, const int cell_x, const int cell_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg);
+  // Set a cell of a tilemap with packed RGBA8 colors.
+  rlhresult_t rlhTilemapSetCellPacked(rlhTilemap_h const tilemap, const int cell_x, const int cell_y, const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg);
+  // Set a cell of a tilemap with indices into the palette of the terminal that draws it.
+  rlhresult_t rlhTilemapSetCellIndexed(rlhTilemap_h const tilemap, const int cell_x, const int cell_y, const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index);
+  // Clear a cell of a tilemap, so that nothing is drawn in it.
+  rlhresult_t rlhTilemapClearCell(rlhTilemap_h const tilemap, const int cell_x, const int cell_y);
+  // Set the tilemap that a terminal draws beneath its layers, or NULL for none.
+  rlhresult_t rlhTermSetTilemap(rlhTerm_h const term, rlhTilemap_h const tilemap);
+  // Set the pixel of the tilemap of a terminal that is drawn at the top left corner of the terminal.
+  rlhresult_t rlhTermSetCamera(rlhTerm_h const term, const int camera_pixel_x, const int camera_pixel_y);
   // Draw a terminal to the current bound framebuffer of the current graphics context. Draws it to fit the viewport, which might distort pixels.
   rlhresult_t rlhTermDraw(rlhTerm_h const term);
   // Draw a terminal pixel perfect, centered in the viewport.
@@ -414,6 +1164,17 @@ extern "C"
   rlhresult_t rlhTermDrawTransformed(rlhTerm_h const term, const int translate_x, const int translate_y, const float scale_x, const float scale_y, const int viewport_width, const int viewport_height);
   // Draw a terminal transformed by a matrix 4x4 (with 16 floats)
   rlhresult_t rlhTermDrawMatrix(rlhTerm_h const term, const float *const matrix_4x4);
+  // Draw an array of terminals, each transformed by its own matrix 4x4 (with 16 floats per terminal). Terminals
+  // next to each other in the array that share an atlas are drawn with a single draw call.
+  rlhresult_t rlhDrawBatch(rlhTerm_h const *const terms, const float *const matrices_4x4, const int term_count);
+  // Get the performance counters of a terminal.
+  rlhresult_t rlhTermGetStats(rlhTerm_h const term, rlhTermStats_t *const stats);
+  // Set the performance counters of a terminal back to zero.
+  rlhresult_t rlhTermResetStats(rlhTerm_h const term);
+  // Enable or disable timing the draws of a terminal on the GPU with timer queries.
+  rlhresult_t rlhTermSetGpuTiming(rlhTerm_h const term, const rlhbool_t enabled);
+  // Set a function to call when terminals are drawn, or NULL to not call one.
+  void rlhSetStatsHook(rlhStatsHook_f hook, void *const user_data);
 
 #ifdef RLH_IMPLEMENTATION
 
@@ -422,76 +1183,292 @@ extern "C"
 #include <string.h>
 #include <math.h>
 
+#if !defined(RLH_NO_FILE_MAPPING) && defined(_WIN32)
+#define RLH_FILE_MAPPING_WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif !defined(RLH_NO_FILE_MAPPING) && (defined(__unix__) || defined(__APPLE__))
+#define RLH_FILE_MAPPING_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if !defined(RLH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RLH_SIMD_SSE2
+#include <emmintrin.h>
+#elif !defined(RLH_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define RLH_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#define RLH_ATOMICS_MSVC
+#include <intrin.h>
+#elif defined(__GNUC__) || defined(__clang__)
+#define RLH_ATOMICS_GNUC
+#endif
+
 #ifndef MAX
-#define MAX(x, y) ((x) > (y)) ? (x) : y
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#endif
+#ifndef MIN
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #endif
 
   const char *const RLH_RESULT_DESCRIPTIONS[RLH_RESULT_COUNT] = {
       "no errors occured", "unexpected null argument",
-      "unexpected argument value", "out of memory"};
+      "unexpected argument value", "out of memory",
+      "unsupported by the build or the OpenGL context",
+      "file could not be read or written, or is not a valid atlas file"};
 
   const float RLH_OPENGL_SCREEN_MATRIX[4 * 4] = {2.0f, 0.0f, 0.0f, -1.0f, 0.0f, -2.0f, 0.0f, 1.0f,
                                                  0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
 
+// The vertex shaders look up the palette colors of a tile and apply its effect with these functions.
+#define RLH_VERTEX_COLOR_SOURCE                                                                                   \
+  "uniform sampler2D u_palette;\n"                                                                               \
+  "uniform samplerBuffer u_effects;\n"                                                                           \
+  "uniform float u_time;\n"                                                                                      \
+  "uniform vec2 u_tile_size;\n"                                                                                  \
+  "vec4 rlhPaletteColor(vec4 color, bool indexed)\n"                                                             \
+  "{\n"                                                                                                          \
+  "  return indexed ? texelFetch(u_palette, ivec2(int(color.r * 255.0 + 0.5), 0), 0) : color;\n"                 \
+  "}\n"                                                                                                          \
+  "void rlhApplyEffect(uint glyph, vec2 pixel, inout vec4 fg, inout vec4 bg)\n"                                  \
+  "{\n"                                                                                                          \
+  "  int effect = int((glyph >> 16) & 0xFFu);\n"                                                                 \
+  "  if (effect == 0)\n"                                                                                         \
+  "    return;\n"                                                                                                \
+  "  vec4 params = texelFetch(u_effects, effect * 2);\n"                                                         \
+  "  vec4 color = texelFetch(u_effects, effect * 2 + 1);\n"                                                      \
+  "  vec2 cell = floor(pixel / u_tile_size);\n"                                                                  \
+  "  float phase = u_time * params.y + params.z + (cell.x + cell.y) * params.w;\n"                               \
+  "  int code = int(params.x);\n"                                                                                \
+  "  int type = code >> 2;\n"                                                                                    \
+  "  float amount = (type == 1) ? step(0.5, fract(phase)) : (type == 2) ? 0.5 - 0.5 * cos(6.2831853 * phase) : clamp(phase, 0.0, 1.0);\n" \
+  "  if ((code & 1) != 0)\n"                                                                                     \
+  "    fg = mix(fg, color, amount);\n"                                                                           \
+  "  if ((code & 2) != 0)\n"                                                                                     \
+  "    bg = mix(bg, color, amount);\n"                                                                           \
+  "}\n"
+
   const char *RLH_VERTEX_SOURCE =
       "#version 330 core\n"
-      "in vec2 a_pos;\n"
-      "in vec3 a_uvp;\n"
-      "in vec4 a_fg;\n"
-      "in vec4 a_bg;\n"
+      "layout(location = 0) in ivec4 a_rect;\n"
+      "layout(location = 1) in uint a_glyph;\n"
+      "layout(location = 2) in vec4 a_fg;\n"
+      "layout(location = 3) in vec4 a_bg;\n"
       "out vec3 v_uvp;\n"
       "out vec4 v_fg;\n"
-      "out vec4 v_bg;"
+      "out vec4 v_bg;\n"
+      "out vec2 v_cell_pos;\n"
       "uniform mat4 u_matrix;\n"
+      "uniform vec2 u_term_size;\n"
+      "uniform vec2 u_offset;\n"
+      "uniform int u_atlas_index;\n"
+      "uniform samplerBuffer u_glyphs;\n"
+      RLH_VERTEX_COLOR_SOURCE
       "void main()\n"
       "{\n"
-      "  gl_Position = u_matrix * vec4(a_pos, 0.0, 1.0);\n"
-      "  v_uvp = a_uvp;\n"
-      "  v_fg = a_fg;\n"
-      "  v_bg = a_bg;"
+      "  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+      "  int glyph = int(a_glyph & 0xFFFFu);\n"
+      "  vec4 stpq = texelFetch(u_glyphs, glyph * 2);\n"
+      "  float page = texelFetch(u_glyphs, glyph * 2 + 1).r;\n"
+      "  vec2 pixel = vec2(a_rect.xy) + u_offset;\n"
+      "  vec2 pos = (pixel + corner * vec2(a_rect.zw)) / u_term_size;\n"
+      "  gl_Position = u_matrix * vec4(pos, 0.0, 1.0);\n"
+      "  v_cell_pos = (pixel + corner * vec2(a_rect.zw)) / u_tile_size;\n"
+      "  gl_ClipDistance[0] = pos.x;\n"
+      "  gl_ClipDistance[1] = 1.0 - pos.x;\n"
+      "  gl_ClipDistance[2] = pos.y;\n"
+      "  gl_ClipDistance[3] = 1.0 - pos.y;\n"
+      "  // tiles of other atlases are moved outside of the clip volume.\n"
+      "  if (int((a_glyph >> 24) & 7u) != u_atlas_index)\n"
+      "    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+      "  v_uvp = vec3(mix(stpq.xz, stpq.yw, corner), page);\n"
+      "  v_fg = rlhPaletteColor(a_fg, (a_glyph & 0x80000000u) != 0u);\n"
+      "  v_bg = rlhPaletteColor(a_bg, (a_glyph & 0x40000000u) != 0u);\n"
+      "  rlhApplyEffect(a_glyph, pixel, v_fg, v_bg);\n"
       "}";
 
-  const char *RLH_FRAGMENT_ALPHA_BG_SOURCE =
+  // The batch vertex shader looks up the matrix and size of the terminal of each tile in a buffer
+  // texture, with five RGBA32F texels per terminal: the four rows of the matrix and then the size.
+  const char *RLH_BATCH_VERTEX_SOURCE =
+      "#version 330 core\n"
+      "layout(location = 0) in ivec4 a_rect;\n"
+      "layout(location = 1) in uint a_glyph;\n"
+      "layout(location = 2) in vec4 a_fg;\n"
+      "layout(location = 3) in vec4 a_bg;\n"
+      "layout(location = 4) in uint a_term;\n"
+      "out vec3 v_uvp;\n"
+      "out vec4 v_fg;\n"
+      "out vec4 v_bg;\n"
+      "out vec2 v_term_pos;\n"
+      "uniform samplerBuffer u_glyphs;\n"
+      "uniform samplerBuffer u_terms;\n"
+      RLH_VERTEX_COLOR_SOURCE
+      "void main()\n"
+      "{\n"
+      "  int term = int(a_term) * 5;\n"
+      "  mat4 matrix = transpose(mat4(texelFetch(u_terms, term), texelFetch(u_terms, term + 1),\n"
+      "                               texelFetch(u_terms, term + 2), texelFetch(u_terms, term + 3)));\n"
+      "  vec2 term_size = texelFetch(u_terms, term + 4).xy;\n"
+      "  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+      "  int glyph = int(a_glyph & 0xFFFFu);\n"
+      "  vec4 stpq = texelFetch(u_glyphs, glyph * 2);\n"
+      "  float page = texelFetch(u_glyphs, glyph * 2 + 1).r;\n"
+      "  vec2 pos = (vec2(a_rect.xy) + corner * vec2(a_rect.zw)) / term_size;\n"
+      "  gl_Position = matrix * vec4(pos, 0.0, 1.0);\n"
+      "  v_uvp = vec3(mix(stpq.xz, stpq.yw, corner), page);\n"
+      "  v_fg = rlhPaletteColor(a_fg, (a_glyph & 0x80000000u) != 0u);\n"
+      "  v_bg = rlhPaletteColor(a_bg, (a_glyph & 0x40000000u) != 0u);\n"
+      "  rlhApplyEffect(a_glyph, vec2(a_rect.xy), v_fg, v_bg);\n"
+      "  v_term_pos = pos;\n"
+      "}";
+
+  const char *RLH_GRID_VERTEX_SOURCE =
+      "#version 330 core\n"
+      "out vec2 v_pixel;\n"
+      "uniform mat4 u_matrix;\n"
+      "uniform vec2 u_term_size;\n"
+      "uniform vec2 u_tile_size;\n"
+      "uniform vec2 u_grid_size;\n"
+      "void main()\n"
+      "{\n"
+      "  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+      "  v_pixel = corner * u_grid_size * u_tile_size;\n"
+      "  gl_Position = u_matrix * vec4(v_pixel / u_term_size, 0.0, 1.0);\n"
+      "}";
+
+  // Fragment shaders are made of the header, the blend function of the fragment type, and the
+  // main function of the tile stream or cell grid.
+  // The render cache is drawn with a single quad, with the rows of the texture flipped because it was
+  // drawn with RLH_OPENGL_SCREEN_MATRIX.
+  const char *RLH_RENDER_CACHE_VERTEX_SOURCE =
       "#version 330 core\n"
+      "out vec2 v_uv;\n"
+      "uniform mat4 u_matrix;\n"
+      "void main()\n"
+      "{\n"
+      "  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+      "  gl_Position = u_matrix * vec4(corner, 0.0, 1.0);\n"
+      "  v_uv = vec2(corner.x, 1.0 - corner.y);\n"
+      "}";
+
+  const char *RLH_FRAGMENT_HEADER_SOURCE =
+      "#version 330 core\n";
+
+// The tile and cell grid fragment shaders apply the light map to a fragment at a position in cells with this
+// function. The alpha of a light map texel is 1 for visible cells and 0.5 for cells that are only explored, and
+// the smooth light map is interpolated between the lights of the four nearest cell centers. The blend functions
+// are linear in the colors, so multiplying the blended color is the same as multiplying fg and bg.
+#define RLH_FRAGMENT_LIGHT_SOURCE                                                                                 \
+  "uniform sampler2D u_light_map;\n"                                                                             \
+  "uniform vec2 u_light_size;\n"                                                                                 \
+  "uniform int u_light_smooth;\n"                                                                                \
+  "uniform vec3 u_explored_light;\n"                                                                             \
+  "vec3 rlhCellLight(ivec2 cell)\n"                                                                              \
+  "{\n"                                                                                                          \
+  "  vec4 texel = texelFetch(u_light_map, clamp(cell, ivec2(0), ivec2(u_light_size) - 1), 0);\n"                 \
+  "  return (texel.a > 0.75) ? texel.rgb : (texel.a > 0.25) ? u_explored_light : vec3(0.0);\n"                  \
+  "}\n"                                                                                                          \
+  "vec4 rlhApplyLight(vec4 color, vec2 cell_pos)\n"                                                              \
+  "{\n"                                                                                                          \
+  "  if (u_light_size.x == 0.0)\n"                                                                               \
+  "    return color;\n"                                                                                          \
+  "  if (u_light_smooth == 0)\n"                                                                                 \
+  "    return vec4(color.rgb * rlhCellLight(ivec2(floor(cell_pos))), color.a);\n"                               \
+  "  vec2 center_pos = cell_pos - 0.5;\n"                                                                        \
+  "  ivec2 cell = ivec2(floor(center_pos));\n"                                                                   \
+  "  vec2 amount = fract(center_pos);\n"                                                                         \
+  "  vec3 top = mix(rlhCellLight(cell), rlhCellLight(cell + ivec2(1, 0)), amount.x);\n"                          \
+  "  vec3 bottom = mix(rlhCellLight(cell + ivec2(0, 1)), rlhCellLight(cell + ivec2(1, 1)), amount.x);\n"         \
+  "  return vec4(color.rgb * mix(top, bottom, amount.y), color.a);\n"                                            \
+  "}\n"
+
+  const char *RLH_FRAGMENT_TILE_SOURCE =
       "in vec3 v_uvp;\n"
       "in vec4 v_fg;\n"
       "in vec4 v_bg;\n"
+      "in vec2 v_cell_pos;\n"
       "out vec4 f_color;\n"
       "uniform sampler2DArray u_atlas;\n"
+      RLH_FRAGMENT_LIGHT_SOURCE
       "void main()\n"
       "{\n"
-      "  vec4 tex_color = texture(u_atlas, v_uvp);\n"
-      "  vec4 actual_tex_color = vec4(tex_color.rgb, 1.0);\n"
-      "  f_color = mix(v_bg, v_fg * actual_tex_color, tex_color.a);\n"
+      "  f_color = rlhApplyLight(rlhBlend(texture(u_atlas, v_uvp), v_fg, v_bg), v_cell_pos);\n"
       "}";
 
-  const char *RLH_FRAGMENT_GREEN_BG_SOURCE =
-      "#version 330 core\n"
+  const char *RLH_FRAGMENT_RENDER_CACHE_SOURCE =
+      "in vec2 v_uv;\n"
+      "out vec4 f_color;\n"
+      "uniform sampler2D u_render_cache;\n"
+      "void main()\n"
+      "{\n"
+      "  f_color = texture(u_render_cache, v_uv);\n"
+      "}";
+
+  // Batched tiles are clipped to the area of their own terminal here instead of with a scissor rect.
+  const char *RLH_FRAGMENT_BATCH_SOURCE =
       "in vec3 v_uvp;\n"
       "in vec4 v_fg;\n"
       "in vec4 v_bg;\n"
+      "in vec2 v_term_pos;\n"
       "out vec4 f_color;\n"
       "uniform sampler2DArray u_atlas;\n"
       "void main()\n"
       "{\n"
-      "  vec4 tex_color = texture(u_atlas, v_uvp);\n"
-      "  vec4 actual_tex_color = vec4(tex_color.r, tex_color.r, tex_color.r, 1.0);\n"
-      "  f_color = mix(v_bg, v_fg * actual_tex_color, tex_color.g);\n"
+      "  if (any(lessThan(v_term_pos, vec2(0.0))) || any(greaterThan(v_term_pos, vec2(1.0))))\n"
+      "    discard;\n"
+      "  f_color = rlhBlend(texture(u_atlas, v_uvp), v_fg, v_bg);\n"
       "}";
 
-  const char *RLH_FRAGMENT_STENCIL_SOURCE =
-      "#version 330 core\n"
-      "in vec3 v_uvp;\n"
-      "in vec4 v_fg;\n"
-      "in vec4 v_bg;\n"
+  const char *RLH_FRAGMENT_GRID_SOURCE =
+      "in vec2 v_pixel;\n"
       "out vec4 f_color;\n"
       "uniform sampler2DArray u_atlas;\n"
+      "uniform samplerBuffer u_glyphs;\n"
+      "uniform usampler2D u_cells;\n"
+      "uniform vec2 u_tile_size;\n"
+      RLH_FRAGMENT_LIGHT_SOURCE
+      "vec4 rlhUnpackColor(uint color)\n"
+      "{\n"
+      "  return vec4((uvec4(color) >> uvec4(0u, 8u, 16u, 24u)) & 0xFFu) / 255.0;\n"
+      "}\n"
       "void main()\n"
       "{\n"
-      "  vec4 tex_color = texture(u_atlas, v_uvp);\n"
-      "  f_color = mix(v_bg, v_fg, tex_color.r);\n"
+      "  vec2 cell_pos = v_pixel / u_tile_size;\n"
+      "  uvec4 cell = texelFetch(u_cells, ivec2(cell_pos), 0);\n"
+      "  vec4 stpq = texelFetch(u_glyphs, int(cell.x) * 2);\n"
+      "  float page = texelFetch(u_glyphs, int(cell.x) * 2 + 1).r;\n"
+      "  vec3 uvp = vec3(mix(stpq.xz, stpq.yw, fract(cell_pos)), page);\n"
+      "  f_color = rlhApplyLight(rlhBlend(texture(u_atlas, uvp), rlhUnpackColor(cell.y), rlhUnpackColor(cell.z)), cell_pos);\n"
       "}";
 
+  const char *RLH_FRAGMENT_ALPHA_BG_SOURCE =
+      "vec4 rlhBlend(vec4 tex_color, vec4 fg, vec4 bg)\n"
+      "{\n"
+      "  vec4 actual_tex_color = vec4(tex_color.rgb, 1.0);\n"
+      "  return mix(bg, fg * actual_tex_color, tex_color.a);\n"
+      "}\n";
+
+  const char *RLH_FRAGMENT_GREEN_BG_SOURCE =
+      "vec4 rlhBlend(vec4 tex_color, vec4 fg, vec4 bg)\n"
+      "{\n"
+      "  vec4 actual_tex_color = vec4(tex_color.r, tex_color.r, tex_color.r, 1.0);\n"
+      "  return mix(bg, fg * actual_tex_color, tex_color.g);\n"
+      "}\n";
+
+  const char *RLH_FRAGMENT_STENCIL_SOURCE =
+      "vec4 rlhBlend(vec4 tex_color, vec4 fg, vec4 bg)\n"
+      "{\n"
+      "  return mix(bg, fg, tex_color.r);\n"
+      "}\n";
+
   typedef enum rlhfragmenttype_t
   {
     RLH_FRAGMENT_NONE,
@@ -501,12 +1478,209 @@ extern "C"
     RLH_FRAGMENT_COUNT
   } rlhfragmenttype_t;
 
-  const size_t RLH_VERTEX_DATA_ATTRIBUTES_PER_VERTEX = 13;
   const size_t RLH_FONTMAP_COORDINATES_PER_GLYPH = 5;
+  const size_t RLH_GLYPH_TABLE_FLOATS_PER_GLYPH = 8;
   const size_t RLH_VERTICES_PER_TILE = 4;
-  const size_t RLH_ELEMENTS_PER_TILE = 6;
   const size_t RLH_MATRIX_FLOAT_COUNT = 16;
   GLint RLH_ATLAS_TEXTURE_SLOT = 0;
+  GLint RLH_GLYPH_TABLE_TEXTURE_SLOT = 1;
+  GLint RLH_GRID_TEXTURE_SLOT = 2;
+  GLint RLH_BATCH_TERM_TEXTURE_SLOT = 3;
+  GLint RLH_RENDER_CACHE_TEXTURE_SLOT = 4;
+  GLint RLH_PALETTE_TEXTURE_SLOT = 5;
+  GLint RLH_EFFECT_TABLE_TEXTURE_SLOT = 6;
+  GLint RLH_LIGHT_MAP_TEXTURE_SLOT = 7;
+#define RLH_TEXTURE_SLOT_COUNT 8
+  // the texture target that is bound to each texture slot
+  const GLenum RLH_TEXTURE_SLOT_TARGETS[RLH_TEXTURE_SLOT_COUNT] = {GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER, GL_TEXTURE_2D, GL_TEXTURE_BUFFER, GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_BUFFER, GL_TEXTURE_2D};
+  const GLenum RLH_TEXTURE_SLOT_BINDINGS[RLH_TEXTURE_SLOT_COUNT] = {GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_BUFFER, GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_BUFFER, GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_BUFFER, GL_TEXTURE_BINDING_2D};
+  const size_t RLH_BATCH_FLOATS_PER_TERM = 20;
+  // the terminal index of a batched tile is an unsigned short.
+  const size_t RLH_MAX_BATCH_RUN_TERMS = 65536;
+#ifdef RLH_RETAINED_MODE
+  const rlhlayermode_t RLH_DEFAULT_LAYER_MODE = RLH_LAYER_RETAINED;
+#else
+  const rlhlayermode_t RLH_DEFAULT_LAYER_MODE = RLH_LAYER_IMMEDIATE;
+#endif
+  const char *const RLH_DEFAULT_LAYER_NAME = "default";
+  const size_t RLH_GRID_UINTS_PER_CELL = 4;
+  const char RLH_ATLAS_FILE_MAGIC[4] = {'R', 'L', 'H', 'A'};
+#define RLH_PUBLISHED_FRAME_COUNT 3
+  // set in the published frame index when that frame was not taken by a draw yet
+  const long RLH_FRAME_FRESH_BIT = 4;
+  const char RLH_TILE_STREAM_MAGIC[4] = {'R', 'L', 'H', 'S'};
+  const uint8_t RLH_TILE_STREAM_VERSION = 1;
+  // the magic, the version, and the flags of an encoded packet.
+  const size_t RLH_TILE_STREAM_HEADER_SIZE = 6;
+  // set in the flags of a packet that is a snapshot.
+  const uint8_t RLH_TILE_STREAM_KEYFRAME = 1;
+  // set in the flags of an encoded tile for each value that is the same as the tile encoded before it.
+  const uint8_t RLH_TILE_STREAM_SAME_SIZE = 1;
+  const uint8_t RLH_TILE_STREAM_SAME_FG = 2;
+  const uint8_t RLH_TILE_STREAM_SAME_BG = 4;
+  const uint32_t RLH_TILE_STREAM_NO_COLOR = UINT32_MAX;
+  const size_t RLH_TILE_STREAM_MAX_PALETTE_COLORS = 65536;
+  const size_t RLH_MAX_VARINT_SIZE = 5;
+  // the flags, five varints, and two colors that are new to the palette.
+  const size_t RLH_MAX_ENCODED_TILE_SIZE = 1 + 5 * 5 + 2 * (5 + 4);
+  const uint32_t RLH_ATLAS_FILE_VERSION = 1;
+  // the largest width, height, and page count of an atlas file, which is more than OpenGL implementations support
+  // for textures and array layers. It keeps the pixel size of a file from overflowing 64 bits.
+  const uint32_t RLH_ATLAS_FILE_MAX_DIMENSION = 65536;
+  // the pixels of an atlas file start at a multiple of this many bytes.
+  const size_t RLH_ATLAS_FILE_PIXEL_ALIGNMENT = 16;
+  // the least tiles that a tile buffer makes room for.
+  const size_t RLH_MIN_TILE_CAPACITY = 8;
+  // dirty tiles of a dirty tile bitmap that are at most this many tiles apart are uploaded with one call, because
+  // a call costs more than uploading a few clean tiles.
+  const size_t RLH_DIRTY_TILE_MERGE_GAP = 4;
+  // the light of explored cells of a light map until it is set.
+  const float RLH_DEFAULT_EXPLORED_LIGHT = 0.5f;
+  // a resize that needs more room reserves this fraction of the room it needs on top, so dragging the edge
+  // of a window does not reallocate on every step.
+  const size_t RLH_RESIZE_HEADROOM_DIVISOR = 4;
+#define RLH_PALETTE_COLOR_COUNT 256
+  // set in the glyph of a tile when its foreground or background is a palette index.
+  const uint32_t RLH_TILE_FG_INDEXED = 0x80000000u;
+  const uint32_t RLH_TILE_BG_INDEXED = 0x40000000u;
+  const uint32_t RLH_TILE_GLYPH_MASK = 0x0000FFFFu;
+  const uint32_t RLH_TILE_EFFECT_MASK = 0x00FF0000u;
+  const uint32_t RLH_TILE_EFFECT_SHIFT = 16;
+  const uint32_t RLH_TILE_ATLAS_MASK = 0x07000000u;
+  const uint32_t RLH_TILE_ATLAS_SHIFT = 24;
+#define RLH_TILEMAP_CHUNK_CELLS 32
+// tilemap chunks that keep a vertex buffer before the least recently drawn ones are evicted
+#define RLH_TILEMAP_CHUNK_BUDGET 64
+#define RLH_MAX_TERM_ATLASES 8
+#define RLH_MAX_TILE_EFFECTS 256
+  // the type and targets, the periods per second, the phase at time 0, and the phase per tile, then the color.
+#define RLH_FLOATS_PER_EFFECT 8
+#define RLH_MAX_DIRTY_TILE_RANGES 8
+#define RLH_STREAM_SEGMENT_COUNT 3
+// timer queries of a terminal that can wait for their results at once
+#define RLH_TIMER_QUERY_COUNT 4
+
+
+  // A range of tile indices in the tile buffer, from begin up to but not including end.
+  typedef struct rlhTileRange_s
+  {
+    size_t begin;
+    size_t end;
+  } rlhTileRange_s;
+
+  typedef struct rlhAtlas_s
+  {
+    size_t reference_count;
+    size_t width;
+    size_t height;
+    size_t pages;
+    rlhcolortype_t color;
+    size_t channel_size;
+    size_t glyph_count;
+    size_t glyph_capacity;
+    float *glyph_stpqp;
+    rlhfragmenttype_t fragment_type;
+    rlhAllocator_t allocator;
+    // incremented when pixels or glyphs of the atlas change, so that render caches know to draw again
+    size_t version;
+
+    // OpenGL
+    GLuint gl_texture_2d_array;
+    GLuint gl_glyph_table_buffer;
+    GLuint gl_glyph_table_texture_buffer;
+    // the pixel buffer object that the pixels of an asynchronous atlas are staged in until they are uploaded
+    GLuint gl_pixel_buffer;
+    uint8_t *gl_pixel_buffer_map;
+    GLsync gl_upload_fence;
+  } rlhAtlas_s;
+
+  // The header at the start of an atlas file. It is followed by the stpqp coordinates of every glyph,
+  // and then by the pixels of every page with each row padded to 4 bytes, which is the layout that
+  // glTexImage3D expects with the default unpack alignment. Values are in the byte order of the
+  // machine that wrote the file.
+  typedef struct rlhAtlasFileHeader_s
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pages;
+    uint32_t channel_size;
+    uint32_t color;
+    uint32_t glyph_count;
+    uint64_t stpqp_offset;
+    uint64_t pixel_offset;
+    uint64_t pixel_size;
+    uint64_t reserved;
+  } rlhAtlasFileHeader_s;
+
+  typedef struct rlhAtlasFile_s
+  {
+    rlhAtlasCreateInfo_t info;
+    void *data;
+    size_t size;
+    rlhAllocator_t allocator;
+  } rlhAtlasFile_s;
+
+  // A shader program that is shared by every terminal that draws with the same fragment type.
+  typedef struct rlhProgram_s
+  {
+    size_t reference_count;
+    GLuint gl_program;
+    GLuint gl_matrix_uniform_location;
+    GLuint gl_term_size_uniform_location;
+    GLuint gl_tile_size_uniform_location;
+    GLuint gl_grid_size_uniform_location;
+    GLuint gl_time_uniform_location;
+    GLuint gl_offset_uniform_location;
+    GLuint gl_atlas_index_uniform_location;
+    GLuint gl_light_size_uniform_location;
+    GLuint gl_light_smooth_uniform_location;
+    GLuint gl_explored_light_uniform_location;
+  } rlhProgram_s;
+
+  // A buffer of tiles and the vertex buffer that it is streamed to.
+  typedef struct rlhTileBuffer_s
+  {
+    size_t vertex_data_tile_capacity;
+    size_t vertex_data_tile_count;
+    // the tiles that were held when the tile buffer was last cleared, which a resize reserves room from
+    size_t cleared_tile_count;
+    rlhTileInstance_s *vertex_data;
+    rlhTileRange_s dirty_tile_ranges[RLH_MAX_DIRTY_TILE_RANGES];
+    size_t dirty_tile_range_count;
+    // a bit for every tile that changed, which replaces the dirty ranges when there are too many of them
+    uint64_t *dirty_tile_bits;
+    size_t dirty_tile_bit_capacity;
+    rlhbool_t dirty_tile_bits_used;
+
+    // OpenGL
+    GLuint gl_vertex_array;
+    GLuint gl_vertex_buffer;
+    size_t gl_vertex_buffer_tile_capacity;
+    rlhstreammode_t stream_mode;
+    size_t stream_segment;
+    rlhTileInstance_s *gl_vertex_buffer_map;
+    GLsync gl_stream_fences[RLH_STREAM_SEGMENT_COUNT];
+    rlhbool_t gl_vertex_attributes_set;
+    size_t gl_vertex_attributes_first_tile;
+    // bytes uploaded since the last draw, which are added to the stats of the terminal
+    size_t uploaded_byte_count;
+    // the most tiles held since the shrink policy last checked the tile buffer
+    size_t window_peak_tile_count;
+    const rlhAllocator_t *allocator;
+    // the tile count, and the hash of the tiles of immediate layers, when the render cache was last drawn
+    size_t render_cache_tile_count;
+    uint64_t render_cache_tile_hash;
+  } rlhTileBuffer_s;
+
+  typedef struct rlhTermLayer_s
+  {
+    rlhTileBuffer_s tiles;
+    char name[RLH_MAX_LAYER_NAME_LENGTH + 1];
+    int z_order;
+    rlhlayermode_t mode;
+  } rlhTermLayer_s;
 
   typedef struct rlhTerm_s
   {
@@ -519,187 +1693,673 @@ extern "C"
     int pixel_scale;
     size_t tile_width;
     size_t tile_height;
-    size_t vertex_data_tile_capacity;
-    size_t vertex_data_tile_count;
-    float *vertex_data;
-    rlhbool_t vertex_data_changed;
-    size_t atlas_width;
-    size_t atlas_height;
-    size_t atlas_pages;
+    rlhTermLayer_s *layers;
+    size_t layer_count;
+    size_t *layer_draw_order;
+    size_t selected_layer;
+    // the tile buffer of the selected layer
+    rlhTileBuffer_s *tiles;
+    rlhAtlas_h atlas;
+    // an atlas that is still uploading, which replaces the atlas once it is ready
+    rlhAtlas_h pending_atlas;
+    // the glyph count of the atlas when the terminal has no atlas, such as in a command list
     size_t glyph_count;
-    float *glyph_stpqp;
-    size_t element_glyph_count;
-    GLuint *element_data;
-    rlhcolortype_t atlas_color;
-    rlhfragmenttype_t fragment_type;
+    rlhbool_t grid_mode;
+    size_t grid_tiles_wide;
+    size_t grid_tiles_tall;
+    uint32_t *grid_cells;
+    // the cells that grid_cells has room for
+    size_t grid_cell_capacity;
+    rlhbool_t grid_resized;
+    rlhbool_t grid_cells_changed;
+    size_t grid_changed_min_x;
+    size_t grid_changed_min_y;
+    size_t grid_changed_max_x;
+    size_t grid_changed_max_y;
+    rlhTermStats_t stats;
+    rlhAllocator_t allocator;
+    size_t shrink_window_draws;
+    size_t shrink_window_draw_count;
+    rlhbool_t overdraw_culling;
+    // the generation that each grid cell was last covered by an opaque grid tile in
+    uint32_t *cover_cells;
+    size_t cover_cell_capacity;
+    uint32_t cover_generation;
+    rlhbool_t render_cache;
+    // set when a change that the render cache can not detect by itself was made to the terminal
+    rlhbool_t render_cache_stale;
+    // the atlas and atlas version that the render cache was drawn with
+    rlhAtlas_h render_cache_atlas;
+    size_t render_cache_atlas_version;
+    // the back frame belongs to the publishing thread and the front frame to the drawing thread, and the
+    // published frame is only swapped with atomic exchanges
+    rlhCmdList_h frames[RLH_PUBLISHED_FRAME_COUNT];
+    size_t back_frame;
+    size_t front_frame;
+    volatile long published_frame;
+    size_t frame_layer;
+    // RGBA8 colors that indexed tiles look up
+    uint8_t palette[RLH_PALETTE_COLOR_COUNT * 4];
+    rlhbool_t palette_changed;
+    // the effects in the layout of the effect table texture
+    float effect_data[RLH_MAX_TILE_EFFECTS * RLH_FLOATS_PER_EFFECT];
+    rlhbool_t effects_changed;
+    float effect_time;
+    float render_cache_effect_time;
+    // the effect and atlas bits that are added to the glyphs of pushed tiles
+    uint32_t push_glyph_bits;
+    // the atlases bound to the indices after 0, which is the atlas of the terminal, and their programs.
+    // Command lists only keep the glyph counts of the atlases.
+    rlhAtlas_h atlases[RLH_MAX_TERM_ATLASES];
+    rlhProgram_s *atlas_programs[RLH_MAX_TERM_ATLASES];
+    size_t atlas_glyph_counts[RLH_MAX_TERM_ATLASES];
+    size_t extra_atlas_count;
+    rlhAtlas_h render_cache_atlases[RLH_MAX_TERM_ATLASES];
+    size_t render_cache_atlas_versions[RLH_MAX_TERM_ATLASES];
+    // scratch memory for grouping the tiles of a layer by atlas
+    void *atlas_sort_data;
+    size_t atlas_sort_size;
+    rlhTilemap_h tilemap;
+    int camera_x;
+    int camera_y;
+    // the tilemap, its version, and the camera when the render cache was last drawn
+    rlhTilemap_h render_cache_tilemap;
+    size_t render_cache_tilemap_version;
+    int render_cache_camera_x;
+    int render_cache_camera_y;
+    // an RGBA8 texel for each cell of the light map, with the light and if the cell is visible or explored
+    uint8_t *light_map;
+    size_t light_map_capacity;
+    size_t light_map_wide;
+    size_t light_map_tall;
+    rlhbool_t light_map_changed;
+    rlhbool_t light_map_resized;
+    rlhbool_t light_map_smooth;
+    float explored_light[3];
 
     // OpenGL
-    GLuint gl_program;
-    GLuint gl_vertex_array;
-    GLuint gl_vertex_buffer;
-    GLuint gl_element_buffer;
-    GLuint gl_matrix_uniform_location;
-    GLuint gl_atlas_texture_2d_array;
+    rlhProgram_s *program;
+    rlhProgram_s *grid_program;
+    GLuint gl_grid_vertex_array;
+    GLuint gl_grid_texture_2d;
+    rlhbool_t gpu_timing;
+    GLuint gl_timer_queries[RLH_TIMER_QUERY_COUNT];
+    size_t timer_query_next;
+    size_t timer_queries_pending;
+    rlhProgram_s *render_cache_program;
+    GLuint gl_render_cache_framebuffer;
+    GLuint gl_render_cache_texture_2d;
+    GLuint gl_render_cache_vertex_array;
+    size_t gl_render_cache_width;
+    size_t gl_render_cache_height;
+    // only created once the palette is set
+    GLuint gl_palette_texture_2d;
+    // only created once an effect is set
+    GLuint gl_effect_table_buffer;
+    GLuint gl_effect_table_texture_buffer;
+    // only created once a light map is set
+    GLuint gl_light_map_texture_2d;
   } rlhTerm_s;
 
-  static inline GLenum _rlhColorTypeToGlFormat(const rlhcolortype_t color)
+  rlhAllocator_t _rlh_allocator;
+
+  static inline void *_rlhAllocate(const rlhAllocator_t *const allocator, const size_t size)
   {
-    switch (color)
-    {
-    case RLH_COLOR_G:
-      return GL_RED;
-    case RLH_COLOR_GA:
-      return GL_RG;
-    case RLH_COLOR_RGBA:
-      return GL_RGBA;
-    case RLH_COLOR_BGRA:
-      return GL_BGRA;
-    default:
-      return GL_NONE;
-    }
+    if (allocator->allocate == NULL)
+      return malloc(size);
+    return allocator->allocate(size, allocator->user_data);
   }
 
-  static inline GLenum _rlhColorTypeToGlInternalFormat(const rlhcolortype_t color)
+  static inline void *_rlhReallocate(const rlhAllocator_t *const allocator, void *const memory, const size_t size)
   {
-    switch (color)
-    {
-    case RLH_COLOR_G:
-      return GL_R8;
-    case RLH_COLOR_GA:
-      return GL_RG;
-    case RLH_COLOR_RGBA:
-    case RLH_COLOR_BGRA:
-      return GL_RGBA;
-    default:
-      return GL_NONE;
-    }
+    if (allocator->reallocate == NULL)
+      return realloc(memory, size);
+    return allocator->reallocate(memory, size, allocator->user_data);
   }
 
-  static inline GLenum _rlhChannelSizeToType(const size_t channel_size)
+  static inline void _rlhDeallocate(const rlhAllocator_t *const allocator, void *const memory)
   {
-    switch (channel_size)
+    if (memory == NULL)
+      return;
+    if (allocator->deallocate == NULL)
     {
-    case 1:
-      return GL_UNSIGNED_BYTE;
-    case 2:
-      return GL_UNSIGNED_SHORT;
-    case 4:
-      return GL_UNSIGNED_INT;
-    default:
-      return GL_NONE;
+      free(memory);
+      return;
     }
+    allocator->deallocate(memory, allocator->user_data);
   }
 
-  static inline rlhresult_t _rlhCreateGlTextureArray(const rlhAtlasCreateInfo_t *const atlas_info, GLint *const gl_texture_2d_array)
+  static inline rlhbool_t _rlhAllocatorCheck(const rlhAllocator_t *const allocator)
   {
-    *gl_texture_2d_array = GL_NONE;
-    const GLenum format = _rlhColorTypeToGlFormat(atlas_info->color);
-    const GLenum internal_format = _rlhColorTypeToGlInternalFormat(atlas_info->color);
-    const GLenum pixel_type = _rlhChannelSizeToType(atlas_info->channel_size);
-    if (internal_format == GL_NONE || format == GL_NONE)
-    {
-      return RLH_RESULT_ERROR_INVALID_VALUE;
-    }
-    GLD_START();
-    GLD_CALL(glGenTextures(1, gl_texture_2d_array));
-    GLD_CALL(glBindTexture(GL_TEXTURE_2D_ARRAY, *gl_texture_2d_array));
-    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
-    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
-    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0));
-    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0));
-    GLD_CALL(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internal_format, atlas_info->width, atlas_info->height, atlas_info->pages, 0, format, pixel_type, atlas_info->pixel_data));
-    return RLH_RESULT_OK;
+    const rlhbool_t any_set = allocator->allocate != NULL || allocator->reallocate != NULL || allocator->deallocate != NULL;
+    const rlhbool_t all_set = allocator->allocate != NULL && allocator->reallocate != NULL && allocator->deallocate != NULL;
+    return any_set == all_set;
   }
 
-  static inline GLuint _rlhCreateGlProgram(const char *vertex_source, const char *fragment_source)
+  // Programs are compiled once per fragment type and shared by every terminal.
+  rlhProgram_s _rlh_tile_programs[RLH_FRAGMENT_COUNT];
+  rlhProgram_s _rlh_grid_programs[RLH_FRAGMENT_COUNT];
+  // the render cache program does not depend on a fragment type, so it is always cached as RLH_FRAGMENT_NONE.
+  rlhProgram_s _rlh_render_cache_program;
+
+  // A command list records tiles into a terminal that has no OpenGL objects or layers. Only the size
+  // and the glyph count of the terminal it was created from are copied into it.
+  typedef struct rlhCmdList_s
   {
-    GLint gl_program, gl_vertex_shader, gl_fragment_shader;
-    GLD_CALL(gl_vertex_shader = glCreateShader(GL_VERTEX_SHADER));
-    GLD_CALL(glShaderSource(gl_vertex_shader, 1, &vertex_source, NULL));
-    GLD_COMPILE(gl_vertex_shader, "rlh vertex shader");
-    GLD_CALL(gl_fragment_shader = glCreateShader(GL_FRAGMENT_SHADER));
-    GLD_CALL(glShaderSource(gl_fragment_shader, 1, &fragment_source, NULL));
-    GLD_COMPILE(gl_fragment_shader, "rlh fragment shader");
-    GLD_CALL(gl_program = glCreateProgram());
-    GLD_CALL(glAttachShader(gl_program, gl_vertex_shader));
-    GLD_CALL(glAttachShader(gl_program, gl_fragment_shader));
-    GLD_LINK(gl_program, "rlh shader program");
-    GLD_CALL(glDetachShader(gl_program, gl_vertex_shader));
-    GLD_CALL(glDetachShader(gl_program, gl_fragment_shader));
-    GLD_CALL(glDeleteShader(gl_vertex_shader));
-    GLD_CALL(glDeleteShader(gl_fragment_shader));
-    return gl_program;
-  }
+    rlhTerm_s term;
+    rlhTileBuffer_s tiles;
+  } rlhCmdList_s;
 
-  static inline size_t _rlhGetVertexDataSize(size_t tile_count)
+  // A tile stream keeps the tiles of the last packet that it encoded or applied, and the palette of the
+  // colors that were sent since the last snapshot. The table finds the palette index of a color when
+  // encoding.
+  typedef struct rlhTileStream_s
   {
-    return tile_count *
-           RLH_VERTEX_DATA_ATTRIBUTES_PER_VERTEX *
-           RLH_VERTICES_PER_TILE *
-           sizeof(float);
-  }
+    rlhAllocator_t allocator;
+    rlhTileInstance_s *tiles;
+    size_t tile_count;
+    size_t tile_capacity;
+    uint32_t *palette;
+    size_t palette_count;
+    size_t palette_capacity;
+    uint32_t *palette_table;
+    size_t palette_table_capacity;
+    uint8_t *data;
+    size_t data_size;
+    size_t data_capacity;
+    // if the tiles match the other side of the stream, so the next packet can be a delta
+    rlhbool_t synchronized;
+  } rlhTileStream_s;
 
-  static inline size_t _rlhGetVertexAttributeCount(size_t tile_count)
+  // A cell of a tilemap, with the glyph bits and the colors of a tile. Cells that are all zero are empty.
+  typedef struct rlhTilemapCell_s
   {
-    return tile_count *
-           RLH_VERTEX_DATA_ATTRIBUTES_PER_VERTEX *
-           RLH_VERTICES_PER_TILE;
-  }
+    uint32_t glyph;
+    uint8_t fg[4];
+    uint8_t bg[4];
+  } rlhTilemapCell_s;
 
-  static inline size_t _rlhGetElementDataSize(size_t tile_count)
+  // The cells of a tilemap chunk are only allocated once one of them is set. Its tiles are in chunk
+  // pixels, and are built again when a cell changed or a terminal with another tile size or glyph
+  // count draws the chunk.
+  typedef struct rlhTilemapChunk_s
   {
-    return tile_count *
-           RLH_ELEMENTS_PER_TILE *
-           sizeof(GLuint);
-  }
+    rlhTilemapCell_s *cells;
+    rlhTileBuffer_s tiles;
+    rlhbool_t changed;
+    size_t built_tile_width;
+    size_t built_tile_height;
+    size_t built_glyph_count;
+    // the draw of the tilemap that last drew the chunk, which picks the chunks to evict
+    size_t drawn_tick;
+  } rlhTilemapChunk_s;
 
-  static inline size_t _rlhGetElementCount(size_t tile_count)
+  typedef struct rlhTilemap_s
   {
-    return tile_count *
-           RLH_ELEMENTS_PER_TILE;
-  }
+    rlhAllocator_t allocator;
+    size_t cells_wide;
+    size_t cells_tall;
+    size_t chunks_wide;
+    size_t chunks_tall;
+    rlhTilemapChunk_s *chunks;
+    // counts the draws of the tilemap, and the chunks that have a vertex buffer
+    size_t draw_tick;
+    size_t resident_chunk_count;
+    // counts the changes of cells, so render caches can see that the tilemap changed
+    size_t version;
+    size_t reference_count;
+  } rlhTilemap_s;
 
-  static inline rlhresult_t _rlhTermTryAppendElements(rlhTerm_h const term)
+  // Batched draws gather the tiles of many terminals into one vertex buffer, with the index of the
+  // terminal of each tile in a second instanced vertex attribute. It is shared by every terminal and
+  // destroyed along with the last of them.
+  typedef struct rlhBatch_s
   {
-    if (term->element_glyph_count >= term->vertex_data_tile_count)
-      return RLH_RESULT_OK;
-    unsigned int *new_element_data = realloc(term->element_data, _rlhGetElementDataSize(term->vertex_data_tile_count));
-    if (new_element_data == NULL)
-    {
-      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
-    }
-    term->element_data = new_element_data;
-    for (; term->element_glyph_count < term->vertex_data_tile_count; term->element_glyph_count++)
-    {
-      const GLuint vert0 = term->element_glyph_count * RLH_VERTICES_PER_TILE;
-      size_t element_data_i = term->element_glyph_count * RLH_ELEMENTS_PER_TILE;
-      term->element_data[element_data_i++] = vert0;
-      term->element_data[element_data_i++] = vert0 + 1;
-      term->element_data[element_data_i++] = vert0 + 2;
-      term->element_data[element_data_i++] = vert0 + 1;
-      term->element_data[element_data_i++] = vert0 + 2;
-      term->element_data[element_data_i] = vert0 + 3;
-    }
-    return RLH_RESULT_OK;
-  }
+    rlhTileBuffer_s tiles;
+    uint16_t *tile_terms;
+    size_t tile_terms_capacity;
+    float *term_data;
+    size_t term_data_capacity;
+    rlhProgram_s *programs[RLH_FRAGMENT_COUNT];
+    // the allocator when the batch first allocated memory
+    rlhAllocator_t allocator;
 
-  static inline rlhfragmenttype_t _rlhColorTypeToFragmentType(rlhcolortype_t color)
+    // OpenGL
+    GLuint gl_tile_term_buffer;
+    GLuint gl_term_buffer;
+    GLuint gl_term_texture_buffer;
+  } rlhBatch_s;
+
+  rlhProgram_s _rlh_batch_programs[RLH_FRAGMENT_COUNT];
+  rlhBatch_s _rlh_batch;
+
+  rlhStatsHook_f _rlh_stats_hook;
+  void *_rlh_stats_hook_user_data;
+  size_t _rlh_term_count;
+
+  typedef enum rlhblendmode_t
   {
-    switch (color)
-    {
-    case RLH_COLOR_G:
-      return RLH_FRAGMENT_STENCIL;
-    case RLH_COLOR_GA:
-      return RLH_FRAGMENT_GREEN_BG;
-    }
-    return RLH_FRAGMENT_ALPHA_BG;
-  }
+    RLH_BLEND_UNKNOWN,
+    // blend colors by their alpha
+    RLH_BLEND_ALPHA,
+    // blend colors by their alpha, and store premultiplied colors in a render cache
+    RLH_BLEND_RENDER_CACHE,
+    // blend premultiplied colors from a render cache
+    RLH_BLEND_PREMULTIPLIED
+  } rlhblendmode_t;
 
-  static inline const char *_rlhFragmentSourceFromFragmentType(rlhfragmenttype_t fragment)
+  // OpenGL state that is cached between rlhBeginFrame() and rlhEndFrame(), so that draws skip the
+  // calls that would set state that is already in effect. The state from before the frame is saved
+  // to be restored at the end of it.
+  typedef struct rlhGlStateCache_s
   {
-    switch (fragment)
+    rlhbool_t in_frame;
+    GLuint program;
+    GLuint vertex_array;
+    GLenum active_texture;
+    GLuint textures[RLH_TEXTURE_SLOT_COUNT];
+    rlhblendmode_t blend_mode;
+    rlhbool_t scissor_test;
+    GLint scissor_box[4];
+    // the clip planes are always disabled again after a draw, so this is known outside of frames too
+    rlhbool_t clip_planes;
+
+    GLint saved_program;
+    GLint saved_vertex_array;
+    GLint saved_array_buffer;
+    GLint saved_active_texture;
+    GLint saved_textures[RLH_TEXTURE_SLOT_COUNT];
+    GLboolean saved_blend;
+    GLint saved_blend_src_rgb;
+    GLint saved_blend_dst_rgb;
+    GLint saved_blend_src_alpha;
+    GLint saved_blend_dst_alpha;
+    GLboolean saved_scissor_test;
+    GLint saved_scissor_box[4];
+  } rlhGlStateCache_s;
+
+  rlhGlStateCache_s _rlh_gl_state;
+
+  static inline void _rlhUseProgram(const GLuint program)
+  {
+    if (_rlh_gl_state.in_frame && _rlh_gl_state.program == program)
+      return;
+    GLD_START();
+    GLD_CALL(glUseProgram(program));
+    _rlh_gl_state.program = program;
+  }
+
+  static inline void _rlhBindVertexArray(const GLuint vertex_array)
+  {
+    if (_rlh_gl_state.in_frame && _rlh_gl_state.vertex_array == vertex_array)
+      return;
+    GLD_START();
+    GLD_CALL(glBindVertexArray(vertex_array));
+    _rlh_gl_state.vertex_array = vertex_array;
+  }
+
+  // Bind a texture to a texture slot, with the texture target of that slot.
+  static inline void _rlhBindTexture(const GLint slot, const GLuint texture)
+  {
+    rlhGlStateCache_s *const state = &_rlh_gl_state;
+    if (state->in_frame && state->textures[slot] == texture)
+      return;
+    GLD_START();
+    const GLenum active_texture = GL_TEXTURE0 + (GLenum)slot;
+    if (!state->in_frame || state->active_texture != active_texture)
+    {
+      GLD_CALL(glActiveTexture(active_texture));
+      state->active_texture = active_texture;
+    }
+    GLD_CALL(glBindTexture(RLH_TEXTURE_SLOT_TARGETS[slot], texture));
+    state->textures[slot] = texture;
+  }
+
+  static inline void _rlhSetBlend(const rlhblendmode_t blend_mode)
+  {
+    if (_rlh_gl_state.in_frame && _rlh_gl_state.blend_mode == blend_mode)
+      return;
+    GLD_START();
+    GLD_CALL(glEnable(GL_BLEND));
+    if (blend_mode == RLH_BLEND_RENDER_CACHE)
+    {
+      GLD_CALL(glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+    }
+    else if (blend_mode == RLH_BLEND_PREMULTIPLIED)
+    {
+      GLD_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+    }
+    else
+    {
+      GLD_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    }
+    _rlh_gl_state.blend_mode = blend_mode;
+  }
+
+  // Enable or disable the four clip planes that the tile program clips tiles to the terminal with.
+  static inline void _rlhSetClipPlanes(const rlhbool_t enabled)
+  {
+    if (_rlh_gl_state.clip_planes == enabled)
+      return;
+    GLD_START();
+    for (GLenum plane_i = 0; plane_i < 4; plane_i++)
+    {
+      if (enabled)
+      {
+        GLD_CALL(glEnable(GL_CLIP_DISTANCE0 + plane_i));
+      }
+      else
+      {
+        GLD_CALL(glDisable(GL_CLIP_DISTANCE0 + plane_i));
+      }
+    }
+    _rlh_gl_state.clip_planes = enabled;
+  }
+
+  static inline void _rlhSetScissorTest(const rlhbool_t enabled)
+  {
+    if (_rlh_gl_state.in_frame && _rlh_gl_state.scissor_test == enabled)
+      return;
+    GLD_START();
+    if (enabled)
+    {
+      GLD_CALL(glEnable(GL_SCISSOR_TEST));
+    }
+    else
+    {
+      GLD_CALL(glDisable(GL_SCISSOR_TEST));
+    }
+    _rlh_gl_state.scissor_test = enabled;
+  }
+
+  static inline void _rlhSetScissorBox(const GLint x, const GLint y, const GLint width, const GLint height)
+  {
+    GLint *const box = _rlh_gl_state.scissor_box;
+    if (_rlh_gl_state.in_frame && box[0] == x && box[1] == y && box[2] == width && box[3] == height)
+      return;
+    GLD_START();
+    GLD_CALL(glScissor(x, y, width, height));
+    box[0] = x;
+    box[1] = y;
+    box[2] = width;
+    box[3] = height;
+  }
+
+  // Deleted objects are unbound by OpenGL and their names can be reused, so they must be forgotten
+  // by the state cache, and not be restored at the end of the frame.
+  static inline void _rlhForgetTexture(const GLuint texture)
+  {
+    for (size_t slot = 0; slot < RLH_TEXTURE_SLOT_COUNT; slot++)
+    {
+      if (_rlh_gl_state.textures[slot] == texture)
+      {
+        _rlh_gl_state.textures[slot] = GL_NONE;
+      }
+      if (_rlh_gl_state.saved_textures[slot] == (GLint)texture)
+      {
+        _rlh_gl_state.saved_textures[slot] = GL_NONE;
+      }
+    }
+  }
+
+  static inline void _rlhForgetVertexArray(const GLuint vertex_array)
+  {
+    if (_rlh_gl_state.vertex_array == vertex_array)
+    {
+      _rlh_gl_state.vertex_array = GL_NONE;
+    }
+    if (_rlh_gl_state.saved_vertex_array == (GLint)vertex_array)
+    {
+      _rlh_gl_state.saved_vertex_array = GL_NONE;
+    }
+  }
+
+  static inline void _rlhForgetArrayBuffer(const GLuint buffer)
+  {
+    if (_rlh_gl_state.saved_array_buffer == (GLint)buffer)
+    {
+      _rlh_gl_state.saved_array_buffer = GL_NONE;
+    }
+  }
+
+  static inline void _rlhForgetProgram(const GLuint program)
+  {
+    if (_rlh_gl_state.program == program)
+    {
+      _rlh_gl_state.program = GL_NONE;
+    }
+    if (_rlh_gl_state.saved_program == (GLint)program)
+    {
+      _rlh_gl_state.saved_program = GL_NONE;
+    }
+  }
+
+  static inline GLenum _rlhColorTypeToGlFormat(const rlhcolortype_t color)
+  {
+    switch (color)
+    {
+    case RLH_COLOR_G:
+      return GL_RED;
+    case RLH_COLOR_GA:
+      return GL_RG;
+    case RLH_COLOR_RGBA:
+      return GL_RGBA;
+    case RLH_COLOR_BGRA:
+      return GL_BGRA;
+    default:
+      return GL_NONE;
+    }
+  }
+
+  static inline GLenum _rlhColorTypeToGlInternalFormat(const rlhcolortype_t color)
+  {
+    switch (color)
+    {
+    case RLH_COLOR_G:
+      return GL_R8;
+    case RLH_COLOR_GA:
+      return GL_RG;
+    case RLH_COLOR_RGBA:
+    case RLH_COLOR_BGRA:
+      return GL_RGBA;
+    default:
+      return GL_NONE;
+    }
+  }
+
+  static inline GLenum _rlhChannelSizeToType(const size_t channel_size)
+  {
+    switch (channel_size)
+    {
+    case 1:
+      return GL_UNSIGNED_BYTE;
+    case 2:
+      return GL_UNSIGNED_SHORT;
+    case 4:
+      return GL_UNSIGNED_INT;
+    default:
+      return GL_NONE;
+    }
+  }
+
+  static inline size_t _rlhColorTypeToChannelCount(const rlhcolortype_t color)
+  {
+    switch (color)
+    {
+    case RLH_COLOR_G:
+      return 1;
+    case RLH_COLOR_GA:
+      return 2;
+    default:
+      return 4;
+    }
+  }
+
+  // Get the byte size of an atlas page, with each row padded to the default unpack alignment of 4 bytes.
+  static inline size_t _rlhGetAtlasPageSize(const size_t width, const size_t height, const rlhcolortype_t color, const size_t channel_size)
+  {
+    const size_t row_size = width * _rlhColorTypeToChannelCount(color) * channel_size;
+    return ((row_size + 3) & ~(size_t)3) * height;
+  }
+
+  // Upload the pages of an atlas through two pixel buffer objects in turn, so that copying a page into
+  // one of them overlaps with the transfer of the page before it from the other one.
+  static inline void _rlhUploadGlTextureArrayPages(const rlhAtlasCreateInfo_t *const atlas_info, const GLenum format, const GLenum pixel_type)
+  {
+    const size_t page_size = _rlhGetAtlasPageSize(atlas_info->width, atlas_info->height, atlas_info->color, atlas_info->channel_size);
+    GLD_START();
+    GLuint gl_pixel_buffers[2];
+    GLD_CALL(glGenBuffers(2, gl_pixel_buffers));
+    for (int page = 0; page < atlas_info->pages; page++)
+    {
+      const uint8_t *const page_pixels = atlas_info->pixel_data + page * page_size;
+      GLD_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gl_pixel_buffers[page % 2]));
+      // orphan the buffer so that mapping it does not wait for the transfer that used it last.
+      GLD_CALL(glBufferData(GL_PIXEL_UNPACK_BUFFER, page_size, NULL, GL_STREAM_DRAW));
+      void *page_map = NULL;
+      GLD_CALL(page_map = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, page_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+      if (page_map == NULL)
+      {
+        // upload straight from client memory if the buffer can not be mapped.
+        GLD_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE));
+        GLD_CALL(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, page, atlas_info->width, atlas_info->height, 1, format, pixel_type, page_pixels));
+        continue;
+      }
+      memcpy(page_map, page_pixels, page_size);
+      GLD_CALL(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+      GLD_CALL(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, page, atlas_info->width, atlas_info->height, 1, format, pixel_type, (void *)0));
+    }
+    GLD_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE));
+    GLD_CALL(glDeleteBuffers(2, gl_pixel_buffers));
+  }
+
+  static inline rlhresult_t _rlhCreateGlTextureArray(const rlhAtlasCreateInfo_t *const atlas_info, GLuint *const gl_texture_2d_array)
+  {
+    *gl_texture_2d_array = GL_NONE;
+    const GLenum format = _rlhColorTypeToGlFormat(atlas_info->color);
+    const GLenum internal_format = _rlhColorTypeToGlInternalFormat(atlas_info->color);
+    const GLenum pixel_type = _rlhChannelSizeToType(atlas_info->channel_size);
+    if (internal_format == GL_NONE || format == GL_NONE)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    GLD_START();
+    GLD_CALL(glGenTextures(1, gl_texture_2d_array));
+    _rlhBindTexture(RLH_ATLAS_TEXTURE_SLOT, *gl_texture_2d_array);
+    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0));
+    GLD_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0));
+    GLD_CALL(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internal_format, atlas_info->width, atlas_info->height, atlas_info->pages, 0, format, pixel_type, NULL));
+    if (atlas_info->pixel_data != NULL)
+    {
+      _rlhUploadGlTextureArrayPages(atlas_info, format, pixel_type);
+    }
+    return RLH_RESULT_OK;
+  }
+
+  static inline GLuint _rlhCreateGlProgram(const char *vertex_source, const char *fragment_blend_source, const char *fragment_main_source)
+  {
+    GLint gl_program, gl_vertex_shader, gl_fragment_shader;
+    const char *fragment_sources[3] = {RLH_FRAGMENT_HEADER_SOURCE, fragment_blend_source, fragment_main_source};
+    GLD_CALL(gl_vertex_shader = glCreateShader(GL_VERTEX_SHADER));
+    GLD_CALL(glShaderSource(gl_vertex_shader, 1, &vertex_source, NULL));
+    GLD_COMPILE(gl_vertex_shader, "rlh vertex shader");
+    GLD_CALL(gl_fragment_shader = glCreateShader(GL_FRAGMENT_SHADER));
+    GLD_CALL(glShaderSource(gl_fragment_shader, 3, fragment_sources, NULL));
+    GLD_COMPILE(gl_fragment_shader, "rlh fragment shader");
+    GLD_CALL(gl_program = glCreateProgram());
+    GLD_CALL(glAttachShader(gl_program, gl_vertex_shader));
+    GLD_CALL(glAttachShader(gl_program, gl_fragment_shader));
+    GLD_LINK(gl_program, "rlh shader program");
+    GLD_CALL(glDetachShader(gl_program, gl_vertex_shader));
+    GLD_CALL(glDetachShader(gl_program, gl_fragment_shader));
+    GLD_CALL(glDeleteShader(gl_vertex_shader));
+    GLD_CALL(glDeleteShader(gl_fragment_shader));
+    return gl_program;
+  }
+
+  static inline size_t _rlhGetVertexDataSize(size_t tile_count)
+  {
+    return tile_count * sizeof(rlhTileInstance_s);
+  }
+
+  static inline uint8_t _rlhColorChannelToByte(const float channel)
+  {
+    if (channel <= 0.0f)
+      return 0;
+    if (channel >= 1.0f)
+      return 255;
+    return (uint8_t)(channel * 255.0f + 0.5f);
+  }
+
+  static inline void _rlhPackColor(const rlhColor_s color, uint8_t *const packed)
+  {
+    packed[0] = _rlhColorChannelToByte(color.r);
+    packed[1] = _rlhColorChannelToByte(color.g);
+    packed[2] = _rlhColorChannelToByte(color.b);
+    packed[3] = _rlhColorChannelToByte(color.a);
+  }
+
+  // Pack a foreground and a background color into 8 bytes, the foreground in the first 4 and the
+  // background in the last 4. Both colors are converted at once when SIMD is available.
+  static inline void _rlhPackColorPair(const rlhColor_s fg, const rlhColor_s bg, uint8_t *const packed)
+  {
+#if defined(RLH_SIMD_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    // max returns its second operand when the first is NaN, so NaN channels become 0 like the scalar path.
+    const __m128 fg_channels = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&fg.r), zero), one);
+    const __m128 bg_channels = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&bg.r), zero), one);
+    const __m128i fg_ints = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(fg_channels, scale), half));
+    const __m128i bg_ints = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(bg_channels, scale), half));
+    const __m128i shorts = _mm_packs_epi32(fg_ints, bg_ints);
+    _mm_storel_epi64((__m128i *)packed, _mm_packus_epi16(shorts, shorts));
+#elif defined(RLH_SIMD_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t scale = vdupq_n_f32(255.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t fg_channels = vminq_f32(vmaxq_f32(vld1q_f32(&fg.r), zero), one);
+    const float32x4_t bg_channels = vminq_f32(vmaxq_f32(vld1q_f32(&bg.r), zero), one);
+    // converting NaN to an unsigned integer gives 0 like the scalar path.
+    const uint32x4_t fg_ints = vcvtq_u32_f32(vaddq_f32(vmulq_f32(fg_channels, scale), half));
+    const uint32x4_t bg_ints = vcvtq_u32_f32(vaddq_f32(vmulq_f32(bg_channels, scale), half));
+    vst1_u8(packed, vmovn_u16(vcombine_u16(vmovn_u32(fg_ints), vmovn_u32(bg_ints))));
+#else
+    _rlhPackColor(fg, packed);
+    _rlhPackColor(bg, packed + 4);
+#endif
+  }
+
+  // Pack a color into an unsigned integer with the red channel in the lowest byte.
+  static inline uint32_t _rlhPackColorUint(const rlhColor_s color)
+  {
+    return (uint32_t)_rlhColorChannelToByte(color.r) |
+           ((uint32_t)_rlhColorChannelToByte(color.g) << 8) |
+           ((uint32_t)_rlhColorChannelToByte(color.b) << 16) |
+           ((uint32_t)_rlhColorChannelToByte(color.a) << 24);
+  }
+
+  static inline rlhfragmenttype_t _rlhColorTypeToFragmentType(rlhcolortype_t color)
+  {
+    switch (color)
+    {
+    case RLH_COLOR_G:
+      return RLH_FRAGMENT_STENCIL;
+    case RLH_COLOR_GA:
+      return RLH_FRAGMENT_GREEN_BG;
+    }
+    return RLH_FRAGMENT_ALPHA_BG;
+  }
+
+  static inline const char *_rlhFragmentSourceFromFragmentType(rlhfragmenttype_t fragment)
+  {
+    switch (fragment)
     {
     case RLH_FRAGMENT_STENCIL:
       return RLH_FRAGMENT_STENCIL_SOURCE;
@@ -730,9 +2390,10 @@ extern "C"
 
   static inline rlhresult_t _rlhAtlasInfoCheck(rlhAtlasCreateInfo_t *atlas_info)
   {
+    // without pixel data the texture is created with undefined pixels to upload to later.
     if (
         atlas_info == NULL ||
-        atlas_info->pixel_data == NULL)
+        (atlas_info->glyph_stpqp == NULL && atlas_info->glyph_count > 0))
     {
       return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
@@ -742,7 +2403,9 @@ extern "C"
         atlas_info->pages <= 0 ||
         atlas_info->color < RLH_COLOR_G ||
         atlas_info->color >= RLH_COLOR_TYPE_COUNT ||
-        atlas_info->glyph_count <= 0)
+        atlas_info->glyph_count < 0 ||
+        atlas_info->glyph_capacity < 0 ||
+        (atlas_info->glyph_count == 0 && atlas_info->glyph_capacity == 0))
     {
       return RLH_RESULT_ERROR_INVALID_VALUE;
     }
@@ -761,6 +2424,14 @@ extern "C"
     {
       return result;
     }
+    if (term_info->allocator != NULL && !_rlhAllocatorCheck(term_info->allocator))
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    if (term_info->atlas != NULL)
+    {
+      return RLH_RESULT_OK;
+    }
     return _rlhAtlasInfoCheck(term_info->atlas_info);
   }
 
@@ -807,430 +2478,5417 @@ extern "C"
     term->tiles_tall = term->unscaled_pixel_height / size_info->tile_height;
   }
 
-  static inline rlhresult_t _rlhTermSetAtlas(rlhTerm_h term, rlhAtlasCreateInfo_t *atlas_info)
+  // Create a shader program for a terminal and bind its texture samplers to their texture slots.
+  static inline GLuint _rlhCreateTermProgram(const char *vertex_source, const char *fragment_main_source, const rlhfragmenttype_t fragment_type)
   {
-    const size_t stpqp_size = atlas_info->glyph_count * RLH_FONTMAP_COORDINATES_PER_GLYPH * sizeof(float);
-    float *glyph_stpqp = realloc(term->glyph_stpqp, stpqp_size);
-    if (glyph_stpqp == NULL)
+    GLD_START();
+    const GLuint gl_program = _rlhCreateGlProgram(vertex_source, _rlhFragmentSourceFromFragmentType(fragment_type), fragment_main_source);
+    _rlhUseProgram(gl_program);
+    GLuint atlas_slot_uniform = GLD_CALL(glGetUniformLocation(gl_program, "u_atlas"));
+    GLD_CALL(glUniform1i(atlas_slot_uniform, RLH_ATLAS_TEXTURE_SLOT));
+    GLuint glyph_table_slot_uniform = GLD_CALL(glGetUniformLocation(gl_program, "u_glyphs"));
+    GLD_CALL(glUniform1i(glyph_table_slot_uniform, RLH_GLYPH_TABLE_TEXTURE_SLOT));
+    GLuint grid_slot_uniform = GLD_CALL(glGetUniformLocation(gl_program, "u_cells"));
+    GLD_CALL(glUniform1i(grid_slot_uniform, RLH_GRID_TEXTURE_SLOT));
+    GLuint batch_term_slot_uniform = GLD_CALL(glGetUniformLocation(gl_program, "u_terms"));
+    GLD_CALL(glUniform1i(batch_term_slot_uniform, RLH_BATCH_TERM_TEXTURE_SLOT));
+    GLuint render_cache_slot_uniform = GLD_CALL(glGetUniformLocation(gl_program, "u_render_cache"));
+    GLD_CALL(glUniform1i(render_cache_slot_uniform, RLH_RENDER_CACHE_TEXTURE_SLOT));
+    GLuint palette_slot_uniform = GLD_CALL(glGetUniformLocation(gl_program, "u_palette"));
+    GLD_CALL(glUniform1i(palette_slot_uniform, RLH_PALETTE_TEXTURE_SLOT));
+    GLuint effect_table_slot_uniform = GLD_CALL(glGetUniformLocation(gl_program, "u_effects"));
+    GLD_CALL(glUniform1i(effect_table_slot_uniform, RLH_EFFECT_TABLE_TEXTURE_SLOT));
+    GLuint light_map_slot_uniform = GLD_CALL(glGetUniformLocation(gl_program, "u_light_map"));
+    GLD_CALL(glUniform1i(light_map_slot_uniform, RLH_LIGHT_MAP_TEXTURE_SLOT));
+    return gl_program;
+  }
+
+  // Get the shared program for a fragment type from a program cache, and compile it if no terminal uses it yet.
+  static inline rlhProgram_s *_rlhAcquireProgram(rlhProgram_s *const cache, const rlhfragmenttype_t fragment_type,
+                                                 const char *vertex_source, const char *fragment_main_source)
+  {
+    rlhProgram_s *const program = &cache[fragment_type];
+    if (program->reference_count == 0)
     {
-      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+      GLD_START();
+      program->gl_program = _rlhCreateTermProgram(vertex_source, fragment_main_source, fragment_type);
+      program->gl_matrix_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_matrix"));
+      program->gl_term_size_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_term_size"));
+      program->gl_tile_size_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_tile_size"));
+      program->gl_grid_size_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_grid_size"));
+      program->gl_time_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_time"));
+      program->gl_offset_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_offset"));
+      program->gl_atlas_index_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_atlas_index"));
+      program->gl_light_size_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_light_size"));
+      program->gl_light_smooth_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_light_smooth"));
+      program->gl_explored_light_uniform_location = GLD_CALL(glGetUniformLocation(program->gl_program, "u_explored_light"));
     }
-    term->glyph_stpqp = glyph_stpqp;
-    GLD_START();
-    GLint gl_atlas_texture_2d_array = GL_NONE;
-    rlhresult_t result = _rlhCreateGlTextureArray(atlas_info, &gl_atlas_texture_2d_array);
-    if (result != RLH_RESULT_OK)
+    program->reference_count++;
+    return program;
+  }
+
+  // Stop using a shared program, and delete it if no terminal uses it anymore.
+  static inline void _rlhReleaseProgram(rlhProgram_s *const program)
+  {
+    if (program == NULL)
+      return;
+    program->reference_count--;
+    if (program->reference_count == 0)
     {
-      return result;
+      GLD_START();
+      _rlhForgetProgram(program->gl_program);
+      GLD_CALL(glDeleteProgram(program->gl_program));
+      program->gl_program = GL_NONE;
     }
-    rlhfragmenttype_t fragment_type = _rlhColorTypeToFragmentType(atlas_info->color);
-    if (fragment_type != term->fragment_type)
+  }
+
+  // Upload the stpqp coordinates of a range of glyphs to the glyph table buffer texture, where the
+  // vertex shader looks them up by glyph index. Each glyph takes two RGBA32F texels: stpq and page.
+  static inline rlhresult_t _rlhAtlasUploadGlyphTable(rlhAtlas_h atlas, const size_t first_glyph, const size_t glyph_count)
+  {
+    if (glyph_count == 0)
+      return RLH_RESULT_OK;
+    const size_t table_size = glyph_count * RLH_GLYPH_TABLE_FLOATS_PER_GLYPH * sizeof(float);
+    float *table = (float *)_rlhAllocate(&atlas->allocator, table_size);
+    if (table == NULL)
     {
-      if (term->gl_program != GL_NONE)
-      {
-        GLD_CALL(glDeleteProgram(term->gl_program));
-        term->gl_program = GL_NONE;
-      }
-      const char *fragment_source = _rlhFragmentSourceFromFragmentType(fragment_type);
-      term->gl_program = _rlhCreateGlProgram(RLH_VERTEX_SOURCE, fragment_source);
-      GLD_CALL(glUseProgram(term->gl_program));
-      term->gl_matrix_uniform_location = GLD_CALL(glGetUniformLocation(term->gl_program, "u_matrix"));
-      GLuint atlas_slot_uniform = GLD_CALL(glGetUniformLocation(term->gl_program, "u_atlas"));
-      GLD_CALL(glUniform1i(atlas_slot_uniform, RLH_ATLAS_TEXTURE_SLOT));
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
     }
-    term->fragment_type = fragment_type;
-    if (term->gl_atlas_texture_2d_array != GL_NONE)
+    memset(table, 0, table_size);
+    for (size_t glyph = 0; glyph < glyph_count; glyph++)
     {
-      GLD_CALL(glDeleteTextures(1, &term->gl_atlas_texture_2d_array));
-      term->gl_atlas_texture_2d_array = GL_NONE;
+      memcpy(
+          table + glyph * RLH_GLYPH_TABLE_FLOATS_PER_GLYPH,
+          atlas->glyph_stpqp + (first_glyph + glyph) * RLH_FONTMAP_COORDINATES_PER_GLYPH,
+          RLH_FONTMAP_COORDINATES_PER_GLYPH * sizeof(float));
     }
-    term->gl_atlas_texture_2d_array = gl_atlas_texture_2d_array;
-    memcpy(term->glyph_stpqp, atlas_info->glyph_stpqp, stpqp_size);
-    term->glyph_count = atlas_info->glyph_count;
+    GLD_START();
+    GLD_CALL(glBindBuffer(GL_TEXTURE_BUFFER, atlas->gl_glyph_table_buffer));
+    GLD_CALL(glBufferSubData(GL_TEXTURE_BUFFER, first_glyph * RLH_GLYPH_TABLE_FLOATS_PER_GLYPH * sizeof(float), table_size, table));
+    _rlhDeallocate(&atlas->allocator, table);
     return RLH_RESULT_OK;
   }
 
-  void rlhClearColor(const rlhColor_s color)
+  // Allocate the glyph table buffer texture with room for the glyph capacity of the atlas, and upload
+  // every glyph to it.
+  static inline rlhresult_t _rlhAtlasCreateGlyphTable(rlhAtlas_h atlas)
   {
     GLD_START();
+    if (atlas->gl_glyph_table_buffer == GL_NONE)
+    {
+      GLD_CALL(glGenBuffers(1, &atlas->gl_glyph_table_buffer));
+      GLD_CALL(glGenTextures(1, &atlas->gl_glyph_table_texture_buffer));
+    }
+    GLD_CALL(glBindBuffer(GL_TEXTURE_BUFFER, atlas->gl_glyph_table_buffer));
+    GLD_CALL(glBufferData(GL_TEXTURE_BUFFER, atlas->glyph_capacity * RLH_GLYPH_TABLE_FLOATS_PER_GLYPH * sizeof(float), NULL, GL_STATIC_DRAW));
+    _rlhBindTexture(RLH_GLYPH_TABLE_TEXTURE_SLOT, atlas->gl_glyph_table_texture_buffer);
+    GLD_CALL(glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, atlas->gl_glyph_table_buffer));
+    return _rlhAtlasUploadGlyphTable(atlas, 0, atlas->glyph_count);
+  }
+
+  static inline size_t _rlhAtlasGetPixelSize(rlhAtlas_h atlas)
+  {
+    return _rlhGetAtlasPageSize(atlas->width, atlas->height, atlas->color, atlas->channel_size) * atlas->pages;
+  }
+
+  // Create and map a pixel buffer object with room for every page of an atlas, for its pixels to be
+  // staged in before the upload is started.
+  static inline rlhresult_t _rlhAtlasMapPixelBuffer(rlhAtlas_h atlas)
+  {
+    const size_t pixel_size = _rlhAtlasGetPixelSize(atlas);
+    GLD_START();
+    GLD_CALL(glGenBuffers(1, &atlas->gl_pixel_buffer));
+    GLD_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, atlas->gl_pixel_buffer));
+    GLD_CALL(glBufferData(GL_PIXEL_UNPACK_BUFFER, pixel_size, NULL, GL_STREAM_DRAW));
+    GLD_CALL(atlas->gl_pixel_buffer_map = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pixel_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    GLD_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE));
+    if (atlas->gl_pixel_buffer_map == NULL)
+    {
+      GLD_CALL(glDeleteBuffers(1, &atlas->gl_pixel_buffer));
+      atlas->gl_pixel_buffer = GL_NONE;
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    return RLH_RESULT_OK;
+  }
+
+  // Unmap the staged pixels of an atlas and start copying them to its texture, with a fence to find
+  // out when the copy is done.
+  static inline void _rlhAtlasStartUpload(rlhAtlas_h atlas)
+  {
+    GLD_START();
+    _rlhBindTexture(RLH_ATLAS_TEXTURE_SLOT, atlas->gl_texture_2d_array);
+    GLD_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, atlas->gl_pixel_buffer));
+    GLD_CALL(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+    atlas->gl_pixel_buffer_map = NULL;
+    GLD_CALL(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, atlas->width, atlas->height, atlas->pages,
+                             _rlhColorTypeToGlFormat(atlas->color), _rlhChannelSizeToType(atlas->channel_size), (void *)0));
+    GLD_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE));
+    GLD_CALL(atlas->gl_upload_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+  }
+
+  static inline void _rlhAtlasDestroyPixelBuffer(rlhAtlas_h atlas)
+  {
+    GLD_START();
+    if (atlas->gl_pixel_buffer_map != NULL)
+    {
+      GLD_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, atlas->gl_pixel_buffer));
+      GLD_CALL(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+      GLD_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE));
+      atlas->gl_pixel_buffer_map = NULL;
+    }
+    if (atlas->gl_pixel_buffer != GL_NONE)
+    {
+      GLD_CALL(glDeleteBuffers(1, &atlas->gl_pixel_buffer));
+      atlas->gl_pixel_buffer = GL_NONE;
+    }
+    if (atlas->gl_upload_fence != NULL)
+    {
+      GLD_CALL(glDeleteSync(atlas->gl_upload_fence));
+      atlas->gl_upload_fence = NULL;
+    }
+  }
+
+  static inline void _rlhAtlasFree(rlhAtlas_h atlas)
+  {
+    const rlhAllocator_t allocator = atlas->allocator;
+    _rlhDeallocate(&allocator, atlas->glyph_stpqp);
+    _rlhAtlasDestroyPixelBuffer(atlas);
+    GLD_START();
+    if (atlas->gl_glyph_table_texture_buffer != GL_NONE)
+    {
+      _rlhForgetTexture(atlas->gl_glyph_table_texture_buffer);
+      GLD_CALL(glDeleteTextures(1, &atlas->gl_glyph_table_texture_buffer));
+    }
+    if (atlas->gl_glyph_table_buffer != GL_NONE)
+    {
+      GLD_CALL(glDeleteBuffers(1, &atlas->gl_glyph_table_buffer));
+    }
+    if (atlas->gl_texture_2d_array != GL_NONE)
+    {
+      _rlhForgetTexture(atlas->gl_texture_2d_array);
+      GLD_CALL(glDeleteTextures(1, &atlas->gl_texture_2d_array));
+    }
+    _rlhDeallocate(&allocator, atlas);
+  }
+
+  static inline void _rlhAtlasRelease(rlhAtlas_h atlas)
+  {
+    if (atlas == NULL)
+      return;
+    atlas->reference_count--;
+    if (atlas->reference_count == 0)
+    {
+      _rlhAtlasFree(atlas);
+    }
+  }
+
+  // Make a terminal reference an atlas, and get the shared programs for its fragment type.
+  static inline void _rlhTermUseAtlas(rlhTerm_h term, rlhAtlas_h atlas)
+  {
+    if (term->atlas == atlas)
+      return;
+    atlas->reference_count++;
+    if (term->atlas == NULL || term->atlas->fragment_type != atlas->fragment_type)
+    {
+      _rlhReleaseProgram(term->program);
+      term->program = _rlhAcquireProgram(_rlh_tile_programs, atlas->fragment_type, RLH_VERTEX_SOURCE, RLH_FRAGMENT_TILE_SOURCE);
+      // the cell grid program is acquired again the next time the grid is drawn.
+      _rlhReleaseProgram(term->grid_program);
+      term->grid_program = NULL;
+    }
+    _rlhAtlasRelease(term->atlas);
+    term->atlas = atlas;
+    term->glyph_count = atlas->glyph_count;
+  }
+
+  // Get the glyph count of the atlas of a terminal, which can grow after the terminal started using it.
+  static inline size_t _rlhTermGetGlyphCount(rlhTerm_h const term)
+  {
+    return (term->atlas != NULL) ? term->atlas->glyph_count : term->glyph_count;
+  }
+
+  // Get the glyph count of an atlas index of a terminal, which is 0 for indices without an atlas.
+  static inline size_t _rlhTermGetAtlasGlyphCount(rlhTerm_h const term, const size_t atlas_index)
+  {
+    if (atlas_index == 0)
+      return _rlhTermGetGlyphCount(term);
+    return (term->atlases[atlas_index] != NULL) ? term->atlases[atlas_index]->glyph_count : term->atlas_glyph_counts[atlas_index];
+  }
+
+  // Get the glyph count of the atlas that pushed tiles take their glyphs from.
+  static inline size_t _rlhTermGetPushGlyphCount(rlhTerm_h const term)
+  {
+    return _rlhTermGetAtlasGlyphCount(term, (term->push_glyph_bits & RLH_TILE_ATLAS_MASK) >> RLH_TILE_ATLAS_SHIFT);
+  }
+
+  static inline void _rlhTermDropPendingAtlas(rlhTerm_h term)
+  {
+    _rlhAtlasRelease(term->pending_atlas);
+    term->pending_atlas = NULL;
+  }
+
+  // Switch a terminal to the atlas that it is waiting for once the pixels of that atlas are uploaded.
+  static inline void _rlhTermUpdatePendingAtlas(rlhTerm_h term)
+  {
+    if (term->pending_atlas == NULL || !rlhAtlasIsReady(term->pending_atlas))
+      return;
+    _rlhTermUseAtlas(term, term->pending_atlas);
+    _rlhTermDropPendingAtlas(term);
+  }
+
+  static inline rlhresult_t _rlhTermSetAtlas(rlhTerm_h term, rlhAtlasCreateInfo_t *atlas_info)
+  {
+    rlhAtlas_h atlas = NULL;
+    rlhresult_t result = rlhAtlasCreate(atlas_info, &atlas);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    _rlhTermDropPendingAtlas(term);
+    _rlhTermUseAtlas(term, atlas);
+    // the terminal holds the only reference to its own atlas.
+    _rlhAtlasRelease(atlas);
+    return RLH_RESULT_OK;
+  }
+
+  static inline void _rlhTermMarkGridChanged(rlhTerm_h term, const size_t min_x, const size_t min_y,
+                                             const size_t max_x, const size_t max_y)
+  {
+    if (!term->grid_cells_changed)
+    {
+      term->grid_changed_min_x = min_x;
+      term->grid_changed_min_y = min_y;
+      term->grid_changed_max_x = max_x;
+      term->grid_changed_max_y = max_y;
+      term->grid_cells_changed = RLH_TRUE;
+      return;
+    }
+    if (min_x < term->grid_changed_min_x)
+      term->grid_changed_min_x = min_x;
+    if (min_y < term->grid_changed_min_y)
+      term->grid_changed_min_y = min_y;
+    if (max_x > term->grid_changed_max_x)
+      term->grid_changed_max_x = max_x;
+    if (max_y > term->grid_changed_max_y)
+      term->grid_changed_max_y = max_y;
+  }
+
+  // Move the cells of the grid that are still inside of the new tile dimensions of the terminal to their
+  // place in the same allocation, and clear the rest.
+  static inline void _rlhTermRearrangeGrid(rlhTerm_h term)
+  {
+    const size_t new_wide = term->tiles_wide;
+    const size_t old_wide = term->grid_tiles_wide;
+    const size_t copy_wide = (old_wide < new_wide) ? old_wide : new_wide;
+    const size_t copy_tall = (term->grid_tiles_tall < term->tiles_tall) ? term->grid_tiles_tall : term->tiles_tall;
+    const size_t cell_size = RLH_GRID_UINTS_PER_CELL * sizeof(uint32_t);
+    uint32_t *const cells = term->grid_cells;
+    if (new_wide > old_wide)
+    {
+      // the rows move up in memory, so move the last one first.
+      for (size_t y = copy_tall; y-- > 0;)
+      {
+        uint32_t *const row = cells + y * new_wide * RLH_GRID_UINTS_PER_CELL;
+        memmove(row, cells + y * old_wide * RLH_GRID_UINTS_PER_CELL, copy_wide * cell_size);
+        memset(row + copy_wide * RLH_GRID_UINTS_PER_CELL, 0, (new_wide - copy_wide) * cell_size);
+      }
+    }
+    else if (new_wide < old_wide)
+    {
+      for (size_t y = 1; y < copy_tall; y++)
+      {
+        memmove(
+            cells + y * new_wide * RLH_GRID_UINTS_PER_CELL,
+            cells + y * old_wide * RLH_GRID_UINTS_PER_CELL,
+            copy_wide * cell_size);
+      }
+    }
+    const size_t kept_cells = copy_tall * new_wide;
+    memset(
+        cells + kept_cells * RLH_GRID_UINTS_PER_CELL,
+        0,
+        (term->tiles_wide * term->tiles_tall - kept_cells) * cell_size + sizeof(uint32_t));
+  }
+
+  // Resize the cell grid to the tile dimensions of the terminal, keeping the cells that are still
+  // inside of it. The grid is only reallocated when it grows past the cells it has room for.
+  static inline rlhresult_t _rlhTermResizeGrid(rlhTerm_h term)
+  {
+    if (
+        term->grid_cells != NULL &&
+        term->grid_tiles_wide == term->tiles_wide &&
+        term->grid_tiles_tall == term->tiles_tall)
+    {
+      return RLH_RESULT_OK;
+    }
+    const size_t cell_count = term->tiles_wide * term->tiles_tall;
+    if (term->grid_cells != NULL && cell_count <= term->grid_cell_capacity)
+    {
+      _rlhTermRearrangeGrid(term);
+    }
+    else
+    {
+      // a grid that is already there grows with headroom, since a window that is being resized keeps growing.
+      const size_t cell_capacity = (term->grid_cells != NULL) ? cell_count + cell_count / RLH_RESIZE_HEADROOM_DIVISOR : cell_count;
+      const size_t grid_cells_size = (cell_capacity * RLH_GRID_UINTS_PER_CELL + 1) * sizeof(uint32_t);
+      uint32_t *grid_cells = (uint32_t *)_rlhAllocate(&term->allocator, grid_cells_size);
+      if (grid_cells == NULL)
+      {
+        return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+      }
+      memset(grid_cells, 0, grid_cells_size);
+      if (term->grid_cells != NULL)
+      {
+        const size_t copy_wide = (term->grid_tiles_wide < term->tiles_wide) ? term->grid_tiles_wide : term->tiles_wide;
+        const size_t copy_tall = (term->grid_tiles_tall < term->tiles_tall) ? term->grid_tiles_tall : term->tiles_tall;
+        for (size_t y = 0; y < copy_tall; y++)
+        {
+          memcpy(
+              grid_cells + y * term->tiles_wide * RLH_GRID_UINTS_PER_CELL,
+              term->grid_cells + y * term->grid_tiles_wide * RLH_GRID_UINTS_PER_CELL,
+              copy_wide * RLH_GRID_UINTS_PER_CELL * sizeof(uint32_t));
+        }
+        _rlhDeallocate(&term->allocator, term->grid_cells);
+      }
+      term->grid_cells = grid_cells;
+      term->grid_cell_capacity = cell_capacity;
+    }
+    term->grid_tiles_wide = term->tiles_wide;
+    term->grid_tiles_tall = term->tiles_tall;
+    term->grid_resized = RLH_TRUE;
+    return RLH_RESULT_OK;
+  }
+
+  static inline void _rlhTermDestroyGrid(rlhTerm_h term)
+  {
+    _rlhDeallocate(&term->allocator, term->grid_cells);
+    term->grid_cells = NULL;
+    term->grid_cell_capacity = 0;
+    term->grid_tiles_wide = 0;
+    term->grid_tiles_tall = 0;
+    term->grid_cells_changed = RLH_FALSE;
+    GLD_START();
+    if (term->gl_grid_vertex_array != GL_NONE)
+    {
+      _rlhForgetVertexArray(term->gl_grid_vertex_array);
+      GLD_CALL(glDeleteVertexArrays(1, &term->gl_grid_vertex_array));
+      term->gl_grid_vertex_array = GL_NONE;
+    }
+    if (term->gl_grid_texture_2d != GL_NONE)
+    {
+      _rlhForgetTexture(term->gl_grid_texture_2d);
+      GLD_CALL(glDeleteTextures(1, &term->gl_grid_texture_2d));
+      term->gl_grid_texture_2d = GL_NONE;
+    }
+    _rlhReleaseProgram(term->grid_program);
+    term->grid_program = NULL;
+  }
+
+  static inline void _rlhTermDestroyRenderCache(rlhTerm_h term)
+  {
+    GLD_START();
+    if (term->gl_render_cache_framebuffer != GL_NONE)
+    {
+      GLD_CALL(glDeleteFramebuffers(1, &term->gl_render_cache_framebuffer));
+      term->gl_render_cache_framebuffer = GL_NONE;
+    }
+    if (term->gl_render_cache_texture_2d != GL_NONE)
+    {
+      _rlhForgetTexture(term->gl_render_cache_texture_2d);
+      GLD_CALL(glDeleteTextures(1, &term->gl_render_cache_texture_2d));
+      term->gl_render_cache_texture_2d = GL_NONE;
+    }
+    if (term->gl_render_cache_vertex_array != GL_NONE)
+    {
+      _rlhForgetVertexArray(term->gl_render_cache_vertex_array);
+      GLD_CALL(glDeleteVertexArrays(1, &term->gl_render_cache_vertex_array));
+      term->gl_render_cache_vertex_array = GL_NONE;
+    }
+    term->gl_render_cache_width = 0;
+    term->gl_render_cache_height = 0;
+    _rlhReleaseProgram(term->render_cache_program);
+    term->render_cache_program = NULL;
+  }
+
+  static inline void _rlhTermDestroyEffects(rlhTerm_h term)
+  {
+    if (term->gl_effect_table_buffer == GL_NONE)
+      return;
+    GLD_START();
+    _rlhForgetTexture(term->gl_effect_table_texture_buffer);
+    GLD_CALL(glDeleteTextures(1, &term->gl_effect_table_texture_buffer));
+    GLD_CALL(glDeleteBuffers(1, &term->gl_effect_table_buffer));
+    term->gl_effect_table_texture_buffer = GL_NONE;
+    term->gl_effect_table_buffer = GL_NONE;
+  }
+
+  static inline void _rlhTermDestroyPalette(rlhTerm_h term)
+  {
+    if (term->gl_palette_texture_2d == GL_NONE)
+      return;
+    GLD_START();
+    _rlhForgetTexture(term->gl_palette_texture_2d);
+    GLD_CALL(glDeleteTextures(1, &term->gl_palette_texture_2d));
+    term->gl_palette_texture_2d = GL_NONE;
+  }
+
+  static inline void _rlhTermDestroyLightMap(rlhTerm_h term)
+  {
+    _rlhDeallocate(&term->allocator, term->light_map);
+    term->light_map = NULL;
+    term->light_map_capacity = 0;
+    term->light_map_wide = 0;
+    term->light_map_tall = 0;
+    term->light_map_changed = RLH_FALSE;
+    if (term->gl_light_map_texture_2d == GL_NONE)
+      return;
+    GLD_START();
+    _rlhForgetTexture(term->gl_light_map_texture_2d);
+    GLD_CALL(glDeleteTextures(1, &term->gl_light_map_texture_2d));
+    term->gl_light_map_texture_2d = GL_NONE;
+  }
+
+  static inline rlhbool_t _rlhTermHasLightMap(rlhTerm_h const term)
+  {
+    return term->light_map != NULL;
+  }
+
+  // Upload the light map of a terminal if it changed since the last draw, bind it, and set the light uniforms
+  // of a program. Terminals without a light map set a light map size of 0, which leaves their colors as they are.
+  static inline void _rlhTermBindLightMap(rlhTerm_h const term, const rlhProgram_s *const program)
+  {
+    GLD_START();
+    if (!_rlhTermHasLightMap(term))
+    {
+      GLD_CALL(glUniform2f(program->gl_light_size_uniform_location, 0.0f, 0.0f));
+      return;
+    }
+    if (term->light_map_changed)
+    {
+      if (term->gl_light_map_texture_2d == GL_NONE)
+      {
+        GLD_CALL(glGenTextures(1, &term->gl_light_map_texture_2d));
+        _rlhBindTexture(RLH_LIGHT_MAP_TEXTURE_SLOT, term->gl_light_map_texture_2d);
+        GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0));
+        GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+        term->light_map_resized = RLH_TRUE;
+      }
+      _rlhBindTexture(RLH_LIGHT_MAP_TEXTURE_SLOT, term->gl_light_map_texture_2d);
+      if (term->light_map_resized)
+      {
+        GLD_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, term->light_map_wide, term->light_map_tall, 0, GL_RGBA, GL_UNSIGNED_BYTE, term->light_map));
+      }
+      else
+      {
+        GLD_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, term->light_map_wide, term->light_map_tall, GL_RGBA, GL_UNSIGNED_BYTE, term->light_map));
+      }
+      term->stats.bytes_uploaded += term->light_map_wide * term->light_map_tall * 4;
+      term->light_map_changed = RLH_FALSE;
+      term->light_map_resized = RLH_FALSE;
+    }
+    _rlhBindTexture(RLH_LIGHT_MAP_TEXTURE_SLOT, term->gl_light_map_texture_2d);
+    GLD_CALL(glUniform2f(program->gl_light_size_uniform_location, (float)term->light_map_wide, (float)term->light_map_tall));
+    GLD_CALL(glUniform1i(program->gl_light_smooth_uniform_location, term->light_map_smooth ? 1 : 0));
+    GLD_CALL(glUniform3fv(program->gl_explored_light_uniform_location, 1, term->explored_light));
+  }
+
+  static inline void _rlhCmdListFree(rlhCmdList_h const cmd_list)
+  {
+    if (cmd_list == NULL)
+      return;
+    const rlhAllocator_t allocator = cmd_list->term.allocator;
+    _rlhDeallocate(&allocator, cmd_list->tiles.vertex_data);
+    _rlhDeallocate(&allocator, cmd_list->tiles.dirty_tile_bits);
+    _rlhDeallocate(&allocator, cmd_list);
+  }
+
+  static inline void _rlhTermDestroyFrames(rlhTerm_h term)
+  {
+    for (size_t frame_i = 0; frame_i < RLH_PUBLISHED_FRAME_COUNT; frame_i++)
+    {
+      _rlhCmdListFree(term->frames[frame_i]);
+      term->frames[frame_i] = NULL;
+    }
+  }
+
+  static inline rlhbool_t _rlhTermHasGrid(rlhTerm_h const term)
+  {
+    return term->grid_mode && term->grid_tiles_wide != 0 && term->grid_tiles_tall != 0;
+  }
+
+  // Upload the changed cells of the cell grid and draw it with a single quad that covers every cell.
+  static inline void _rlhTermDrawGrid(rlhTerm_h const term, const float *const matrix_4x4, const rlhblendmode_t blend_mode)
+  {
+    if (!_rlhTermHasGrid(term))
+      return;
+    GLD_START();
+    if (term->grid_program == NULL)
+    {
+      term->grid_program = _rlhAcquireProgram(_rlh_grid_programs, term->atlas->fragment_type, RLH_GRID_VERTEX_SOURCE, RLH_FRAGMENT_GRID_SOURCE);
+    }
+    if (term->gl_grid_texture_2d == GL_NONE)
+    {
+      GLD_CALL(glGenVertexArrays(1, &term->gl_grid_vertex_array));
+      GLD_CALL(glGenTextures(1, &term->gl_grid_texture_2d));
+      _rlhBindTexture(RLH_GRID_TEXTURE_SLOT, term->gl_grid_texture_2d);
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+      term->grid_resized = RLH_TRUE;
+    }
+    _rlhBindTexture(RLH_GRID_TEXTURE_SLOT, term->gl_grid_texture_2d);
+    if (term->grid_resized)
+    {
+      GLD_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32UI, term->grid_tiles_wide, term->grid_tiles_tall, 0, GL_RGBA_INTEGER, GL_UNSIGNED_INT, term->grid_cells));
+      term->stats.bytes_uploaded += term->grid_tiles_wide * term->grid_tiles_tall * RLH_GRID_UINTS_PER_CELL * sizeof(uint32_t);
+    }
+    else if (term->grid_cells_changed)
+    {
+      // only upload the rectangle of cells that changed since the last draw.
+      const size_t changed_wide = term->grid_changed_max_x - term->grid_changed_min_x;
+      const size_t changed_tall = term->grid_changed_max_y - term->grid_changed_min_y;
+      const uint32_t *changed_cells = term->grid_cells + (term->grid_changed_min_y * term->grid_tiles_wide + term->grid_changed_min_x) * RLH_GRID_UINTS_PER_CELL;
+      GLD_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH, term->grid_tiles_wide));
+      GLD_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, term->grid_changed_min_x, term->grid_changed_min_y, changed_wide, changed_tall, GL_RGBA_INTEGER, GL_UNSIGNED_INT, changed_cells));
+      GLD_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+      term->stats.bytes_uploaded += changed_wide * changed_tall * RLH_GRID_UINTS_PER_CELL * sizeof(uint32_t);
+    }
+    term->grid_resized = RLH_FALSE;
+    term->grid_cells_changed = RLH_FALSE;
+    _rlhBindVertexArray(term->gl_grid_vertex_array);
+    _rlhUseProgram(term->grid_program->gl_program);
+    _rlhBindTexture(RLH_ATLAS_TEXTURE_SLOT, term->atlas->gl_texture_2d_array);
+    _rlhBindTexture(RLH_GLYPH_TABLE_TEXTURE_SLOT, term->atlas->gl_glyph_table_texture_buffer);
+    GLD_CALL(glUniformMatrix4fv(term->grid_program->gl_matrix_uniform_location, 1, GL_TRUE, matrix_4x4));
+    GLD_CALL(glUniform2f(term->grid_program->gl_term_size_uniform_location, (float)term->unscaled_pixel_width, (float)term->unscaled_pixel_height));
+    GLD_CALL(glUniform2f(term->grid_program->gl_tile_size_uniform_location, (float)term->tile_width, (float)term->tile_height));
+    GLD_CALL(glUniform2f(term->grid_program->gl_grid_size_uniform_location, (float)term->grid_tiles_wide, (float)term->grid_tiles_tall));
+    _rlhTermBindLightMap(term, term->grid_program);
+    _rlhSetBlend(blend_mode);
+    GLD_CALL(glDrawArrays(GL_TRIANGLE_STRIP, 0, RLH_VERTICES_PER_TILE));
+    term->stats.draw_calls++;
+  }
+
+  static inline void _rlhTileBufferWaitStreamFence(rlhTileBuffer_s *const tiles, const size_t segment)
+  {
+    GLsync fence = tiles->gl_stream_fences[segment];
+    if (fence == NULL)
+      return;
+    GLD_START();
+    GLenum wait_result = GL_TIMEOUT_EXPIRED;
+    while (wait_result == GL_TIMEOUT_EXPIRED)
+    {
+      GLD_CALL(wait_result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000));
+    }
+    GLD_CALL(glDeleteSync(fence));
+    tiles->gl_stream_fences[segment] = NULL;
+  }
+
+  static inline void _rlhTileBufferReleaseStreamFences(rlhTileBuffer_s *const tiles)
+  {
+    GLD_START();
+    for (size_t segment = 0; segment < RLH_STREAM_SEGMENT_COUNT; segment++)
+    {
+      if (tiles->gl_stream_fences[segment] != NULL)
+      {
+        GLD_CALL(glDeleteSync(tiles->gl_stream_fences[segment]));
+        tiles->gl_stream_fences[segment] = NULL;
+      }
+    }
+  }
+
+  static inline rlhbool_t _rlhGlSupportsBufferStorage(void)
+  {
+#ifdef GL_MAP_PERSISTENT_BIT
+    GLD_START();
+    GLint major = 0, minor = 0, extension_count = 0;
+    GLD_CALL(glGetIntegerv(GL_MAJOR_VERSION, &major));
+    GLD_CALL(glGetIntegerv(GL_MINOR_VERSION, &minor));
+    if (major > 4 || (major == 4 && minor >= 4))
+    {
+      return RLH_TRUE;
+    }
+    GLD_CALL(glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count));
+    for (GLint extension_i = 0; extension_i < extension_count; extension_i++)
+    {
+      const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, extension_i);
+      if (extension != NULL && strcmp(extension, "GL_ARB_buffer_storage") == 0)
+      {
+        return RLH_TRUE;
+      }
+    }
+#endif
+    return RLH_FALSE;
+  }
+
+  static inline void _rlhTileBufferCreateVertexArray(rlhTileBuffer_s *const tiles)
+  {
+    if (tiles->gl_vertex_array != GL_NONE)
+      return;
+    GLD_START();
+    GLD_CALL(glGenVertexArrays(1, &tiles->gl_vertex_array));
+    GLD_CALL(glGenBuffers(1, &tiles->gl_vertex_buffer));
+    tiles->gl_vertex_buffer_tile_capacity = 0;
+    tiles->gl_vertex_attributes_set = RLH_FALSE;
+  }
+
+  // Replace the vertex buffer with a new one, so that a buffer with immutable storage can be replaced
+  // with one that can be resized again.
+  static inline void _rlhTileBufferReplaceVertexBuffer(rlhTileBuffer_s *const tiles)
+  {
+    GLD_START();
+    if (tiles->gl_vertex_buffer != GL_NONE)
+    {
+      _rlhForgetArrayBuffer(tiles->gl_vertex_buffer);
+      GLD_CALL(glDeleteBuffers(1, &tiles->gl_vertex_buffer));
+    }
+    GLD_CALL(glGenBuffers(1, &tiles->gl_vertex_buffer));
+    tiles->gl_vertex_buffer_map = NULL;
+    tiles->gl_vertex_buffer_tile_capacity = 0;
+    tiles->gl_vertex_attributes_set = RLH_FALSE;
+    _rlhTileBufferReleaseStreamFences(tiles);
+  }
+
+  // Create a persistently mapped vertex buffer with a segment for each frame in flight, and copy the
+  // tiles that were already written to the current segment of the old buffer to its first segment.
+  // The tile buffer of the terminal points directly into the mapped memory of the current segment.
+  static inline rlhresult_t _rlhTileBufferCreatePersistentVertexBuffer(rlhTileBuffer_s *const tiles, const size_t tile_capacity)
+  {
+#ifdef GL_MAP_PERSISTENT_BIT
+    GLD_START();
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const size_t buffer_size = _rlhGetVertexDataSize(tile_capacity * RLH_STREAM_SEGMENT_COUNT);
+    GLuint gl_vertex_buffer = GL_NONE;
+    GLD_CALL(glGenBuffers(1, &gl_vertex_buffer));
+    GLD_CALL(glBindBuffer(GL_ARRAY_BUFFER, gl_vertex_buffer));
+    GLD_CALL(glBufferStorage(GL_ARRAY_BUFFER, buffer_size, NULL, flags));
+    rlhTileInstance_s *gl_vertex_buffer_map = NULL;
+    GLD_CALL(gl_vertex_buffer_map = (rlhTileInstance_s *)glMapBufferRange(GL_ARRAY_BUFFER, 0, buffer_size, flags));
+    if (gl_vertex_buffer_map == NULL)
+    {
+      GLD_CALL(glDeleteBuffers(1, &gl_vertex_buffer));
+      GLD_CALL(glBindBuffer(GL_ARRAY_BUFFER, tiles->gl_vertex_buffer));
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    if (tiles->gl_vertex_buffer_map != NULL && tiles->vertex_data_tile_count > 0)
+    {
+      GLD_CALL(glBindBuffer(GL_COPY_READ_BUFFER, tiles->gl_vertex_buffer));
+      GLD_CALL(glBindBuffer(GL_COPY_WRITE_BUFFER, gl_vertex_buffer));
+      GLD_CALL(glCopyBufferSubData(
+          GL_COPY_READ_BUFFER,
+          GL_COPY_WRITE_BUFFER,
+          _rlhGetVertexDataSize(tiles->stream_segment * tiles->gl_vertex_buffer_tile_capacity),
+          0,
+          _rlhGetVertexDataSize(tiles->vertex_data_tile_count)));
+    }
+    if (tiles->gl_vertex_buffer != GL_NONE)
+    {
+      _rlhForgetArrayBuffer(tiles->gl_vertex_buffer);
+      GLD_CALL(glDeleteBuffers(1, &tiles->gl_vertex_buffer));
+    }
+    _rlhTileBufferReleaseStreamFences(tiles);
+    tiles->gl_vertex_buffer = gl_vertex_buffer;
+    tiles->gl_vertex_buffer_map = gl_vertex_buffer_map;
+    tiles->gl_vertex_buffer_tile_capacity = tile_capacity;
+    tiles->gl_vertex_attributes_set = RLH_FALSE;
+    tiles->stream_segment = 0;
+    tiles->vertex_data = gl_vertex_buffer_map;
+    tiles->vertex_data_tile_capacity = tile_capacity;
+    GLD_CALL(glBindBuffer(GL_ARRAY_BUFFER, tiles->gl_vertex_buffer));
+    return RLH_RESULT_OK;
+#else
+    return RLH_RESULT_ERROR_UNSUPPORTED;
+#endif
+  }
+
+  static inline size_t _rlhGetDirtyTileWordCount(const size_t tile_count)
+  {
+    return (tile_count + 63) / 64;
+  }
+
+  static inline rlhbool_t _rlhTileBufferHasDirtyTiles(const rlhTileBuffer_s *const tiles)
+  {
+    return tiles->dirty_tile_range_count != 0 || tiles->dirty_tile_bits_used;
+  }
+
+  // Forget the dirty tiles of a tile buffer after they were uploaded or the tiles were removed.
+  static inline void _rlhTileBufferClearDirtyTiles(rlhTileBuffer_s *const tiles)
+  {
+    tiles->dirty_tile_range_count = 0;
+    if (tiles->dirty_tile_bits_used)
+    {
+      memset(tiles->dirty_tile_bits, 0, _rlhGetDirtyTileWordCount(tiles->dirty_tile_bit_capacity) * sizeof(uint64_t));
+      tiles->dirty_tile_bits_used = RLH_FALSE;
+    }
+  }
+
+  static inline void _rlhTileBufferClear(rlhTileBuffer_s *const tiles)
+  {
+    if (tiles->vertex_data_tile_count != 0)
+      tiles->cleared_tile_count = tiles->vertex_data_tile_count;
+    tiles->vertex_data_tile_count = 0;
+    _rlhTileBufferClearDirtyTiles(tiles);
+  }
+
+  static inline void _rlhTileBufferDestroy(rlhTileBuffer_s *const tiles)
+  {
+    // the persistent tile buffer is mapped vertex buffer memory, which is unmapped when the buffer is deleted.
+    if (tiles->stream_mode != RLH_STREAM_PERSISTENT)
+    {
+      _rlhDeallocate(tiles->allocator, tiles->vertex_data);
+    }
+    tiles->vertex_data = NULL;
+    _rlhDeallocate(tiles->allocator, tiles->dirty_tile_bits);
+    tiles->dirty_tile_bits = NULL;
+    tiles->dirty_tile_bit_capacity = 0;
+    tiles->dirty_tile_bits_used = RLH_FALSE;
+    _rlhTileBufferReleaseStreamFences(tiles);
+    GLD_START();
+    if (tiles->gl_vertex_array != GL_NONE)
+    {
+      _rlhForgetVertexArray(tiles->gl_vertex_array);
+      GLD_CALL(glDeleteVertexArrays(1, &tiles->gl_vertex_array));
+      tiles->gl_vertex_array = GL_NONE;
+    }
+    if (tiles->gl_vertex_buffer != GL_NONE)
+    {
+      _rlhForgetArrayBuffer(tiles->gl_vertex_buffer);
+      GLD_CALL(glDeleteBuffers(1, &tiles->gl_vertex_buffer));
+      tiles->gl_vertex_buffer = GL_NONE;
+    }
+  }
+
+  static inline void _rlhTilemapFree(rlhTilemap_h tilemap)
+  {
+    const rlhAllocator_t allocator = tilemap->allocator;
+    for (size_t chunk_i = 0; chunk_i < tilemap->chunks_wide * tilemap->chunks_tall; chunk_i++)
+    {
+      rlhTilemapChunk_s *const chunk = tilemap->chunks + chunk_i;
+      _rlhTileBufferDestroy(&chunk->tiles);
+      _rlhDeallocate(&allocator, chunk->cells);
+    }
+    _rlhDeallocate(&allocator, tilemap->chunks);
+    _rlhDeallocate(&allocator, tilemap);
+  }
+
+  static inline void _rlhTilemapRelease(rlhTilemap_h tilemap)
+  {
+    if (tilemap == NULL)
+      return;
+    tilemap->reference_count--;
+    if (tilemap->reference_count == 0)
+    {
+      _rlhTilemapFree(tilemap);
+    }
+  }
+
+  // Add a layer to a terminal with room for tile_capacity tiles, and insert it in the draw order after the
+  // last layer with a z order that is not greater than its own.
+  static inline rlhresult_t _rlhTermAddLayer(rlhTerm_h const term, const char *const name, const int z_order,
+                                             const rlhlayermode_t mode, const size_t tile_capacity)
+  {
+    size_t *const layer_draw_order = (size_t *)_rlhReallocate(&term->allocator, term->layer_draw_order, (term->layer_count + 1) * sizeof(size_t));
+    if (layer_draw_order == NULL)
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    term->layer_draw_order = layer_draw_order;
+    rlhTermLayer_s *const layers = (rlhTermLayer_s *)_rlhReallocate(&term->allocator, term->layers, (term->layer_count + 1) * sizeof(rlhTermLayer_s));
+    if (layers == NULL)
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    term->layers = layers;
+    // the layers may have moved, so the selected tile buffer must be found again.
+    term->tiles = &term->layers[term->selected_layer].tiles;
+    rlhTermLayer_s *const layer = &term->layers[term->layer_count];
+    memset(layer, 0, sizeof(rlhTermLayer_s));
+    layer->tiles.allocator = &term->allocator;
+    if (tile_capacity > 0)
+    {
+      layer->tiles.vertex_data = (rlhTileInstance_s *)_rlhAllocate(&term->allocator, _rlhGetVertexDataSize(tile_capacity));
+      if (layer->tiles.vertex_data == NULL)
+      {
+        return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+      }
+      layer->tiles.vertex_data_tile_capacity = tile_capacity;
+    }
+    strncpy(layer->name, name, RLH_MAX_LAYER_NAME_LENGTH);
+    layer->z_order = z_order;
+    layer->mode = mode;
+    size_t order_i = term->layer_count;
+    while (order_i > 0 && term->layers[term->layer_draw_order[order_i - 1]].z_order > z_order)
+    {
+      term->layer_draw_order[order_i] = term->layer_draw_order[order_i - 1];
+      order_i--;
+    }
+    term->layer_draw_order[order_i] = term->layer_count;
+    term->layer_count++;
+    return RLH_RESULT_OK;
+  }
+
+  static inline void _rlhTermDestroyLayers(rlhTerm_h const term)
+  {
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+    {
+      _rlhTileBufferDestroy(&term->layers[layer_i].tiles);
+    }
+    _rlhDeallocate(&term->allocator, term->layers);
+    term->layers = NULL;
+    _rlhDeallocate(&term->allocator, term->layer_draw_order);
+    term->layer_draw_order = NULL;
+    term->layer_count = 0;
+    term->tiles = NULL;
+  }
+
+  static inline void _rlhBatchDestroy(void)
+  {
+    rlhBatch_s *const batch = &_rlh_batch;
+    _rlhTileBufferDestroy(&batch->tiles);
+    _rlhDeallocate(&batch->allocator, batch->tile_terms);
+    _rlhDeallocate(&batch->allocator, batch->term_data);
+    for (size_t fragment_i = 0; fragment_i < RLH_FRAGMENT_COUNT; fragment_i++)
+    {
+      _rlhReleaseProgram(batch->programs[fragment_i]);
+    }
+    GLD_START();
+    if (batch->gl_term_texture_buffer != GL_NONE)
+    {
+      _rlhForgetTexture(batch->gl_term_texture_buffer);
+      GLD_CALL(glDeleteTextures(1, &batch->gl_term_texture_buffer));
+    }
+    if (batch->gl_term_buffer != GL_NONE)
+    {
+      GLD_CALL(glDeleteBuffers(1, &batch->gl_term_buffer));
+    }
+    if (batch->gl_tile_term_buffer != GL_NONE)
+    {
+      _rlhForgetArrayBuffer(batch->gl_tile_term_buffer);
+      GLD_CALL(glDeleteBuffers(1, &batch->gl_tile_term_buffer));
+    }
+    memset(batch, 0, sizeof(rlhBatch_s));
+  }
+
+  rlhresult_t rlhSetAllocator(const rlhAllocator_t *const allocator)
+  {
+    if (allocator == NULL)
+    {
+      memset(&_rlh_allocator, 0, sizeof(rlhAllocator_t));
+      return RLH_RESULT_OK;
+    }
+    if (!_rlhAllocatorCheck(allocator))
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    _rlh_allocator = *allocator;
+    return RLH_RESULT_OK;
+  }
+
+  void rlhBeginFrame(void)
+  {
+    rlhGlStateCache_s *const state = &_rlh_gl_state;
+    if (state->in_frame)
+      return;
+    GLD_START();
+    // save the state of the caller
+    GLD_CALL(glGetIntegerv(GL_CURRENT_PROGRAM, &state->saved_program));
+    GLD_CALL(glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &state->saved_vertex_array));
+    GLD_CALL(glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &state->saved_array_buffer));
+    GLD_CALL(glGetIntegerv(GL_ACTIVE_TEXTURE, &state->saved_active_texture));
+    for (size_t slot = 0; slot < RLH_TEXTURE_SLOT_COUNT; slot++)
+    {
+      GLD_CALL(glActiveTexture(GL_TEXTURE0 + slot));
+      GLD_CALL(glGetIntegerv(RLH_TEXTURE_SLOT_BINDINGS[slot], &state->saved_textures[slot]));
+      state->textures[slot] = (GLuint)state->saved_textures[slot];
+    }
+    GLD_CALL(glActiveTexture(state->saved_active_texture));
+    GLD_CALL(glGetBooleanv(GL_BLEND, &state->saved_blend));
+    GLD_CALL(glGetIntegerv(GL_BLEND_SRC_RGB, &state->saved_blend_src_rgb));
+    GLD_CALL(glGetIntegerv(GL_BLEND_DST_RGB, &state->saved_blend_dst_rgb));
+    GLD_CALL(glGetIntegerv(GL_BLEND_SRC_ALPHA, &state->saved_blend_src_alpha));
+    GLD_CALL(glGetIntegerv(GL_BLEND_DST_ALPHA, &state->saved_blend_dst_alpha));
+    GLD_CALL(glGetBooleanv(GL_SCISSOR_TEST, &state->saved_scissor_test));
+    GLD_CALL(glGetIntegerv(GL_SCISSOR_BOX, state->saved_scissor_box));
+    // start the cache at the state of the caller
+    state->program = (GLuint)state->saved_program;
+    state->vertex_array = (GLuint)state->saved_vertex_array;
+    state->active_texture = (GLenum)state->saved_active_texture;
+    const rlhbool_t saved_blend_alpha = state->saved_blend &&
+                                        state->saved_blend_src_rgb == GL_SRC_ALPHA && state->saved_blend_src_alpha == GL_SRC_ALPHA &&
+                                        state->saved_blend_dst_rgb == GL_ONE_MINUS_SRC_ALPHA && state->saved_blend_dst_alpha == GL_ONE_MINUS_SRC_ALPHA;
+    state->blend_mode = saved_blend_alpha ? RLH_BLEND_ALPHA : RLH_BLEND_UNKNOWN;
+    state->scissor_test = state->saved_scissor_test ? RLH_TRUE : RLH_FALSE;
+    memcpy(state->scissor_box, state->saved_scissor_box, sizeof(state->scissor_box));
+    state->in_frame = RLH_TRUE;
+  }
+
+  void rlhEndFrame(void)
+  {
+    rlhGlStateCache_s *const state = &_rlh_gl_state;
+    if (!state->in_frame)
+      return;
+    state->in_frame = RLH_FALSE;
+    GLD_START();
+    // restore the state of the caller
+    GLD_CALL(glUseProgram(state->saved_program));
+    GLD_CALL(glBindVertexArray(state->saved_vertex_array));
+    GLD_CALL(glBindBuffer(GL_ARRAY_BUFFER, state->saved_array_buffer));
+    for (size_t slot = 0; slot < RLH_TEXTURE_SLOT_COUNT; slot++)
+    {
+      GLD_CALL(glActiveTexture(GL_TEXTURE0 + slot));
+      GLD_CALL(glBindTexture(RLH_TEXTURE_SLOT_TARGETS[slot], state->saved_textures[slot]));
+    }
+    GLD_CALL(glActiveTexture(state->saved_active_texture));
+    if (state->saved_blend)
+    {
+      GLD_CALL(glEnable(GL_BLEND));
+    }
+    else
+    {
+      GLD_CALL(glDisable(GL_BLEND));
+    }
+    GLD_CALL(glBlendFuncSeparate(state->saved_blend_src_rgb, state->saved_blend_dst_rgb, state->saved_blend_src_alpha, state->saved_blend_dst_alpha));
+    if (state->saved_scissor_test)
+    {
+      GLD_CALL(glEnable(GL_SCISSOR_TEST));
+    }
+    else
+    {
+      GLD_CALL(glDisable(GL_SCISSOR_TEST));
+    }
+    GLD_CALL(glScissor(state->saved_scissor_box[0], state->saved_scissor_box[1], state->saved_scissor_box[2], state->saved_scissor_box[3]));
+  }
+
+  void rlhClearColor(const rlhColor_s color)
+  {
+    GLD_START();
+    // the scissor of a translated draw may still be enabled in a frame
+    if (_rlh_gl_state.in_frame)
+    {
+      _rlhSetScissorTest(RLH_FALSE);
+    }
     GLD_CALL(glClearColor(color.r, color.g, color.b, color.a));
     GLD_CALL(glClear(GL_COLOR_BUFFER_BIT));
   }
 
-  void rlhViewport(const int x, const int y, const int width, const int height)
+  void rlhViewport(const int x, const int y, const int width, const int height)
+  {
+    GLD_START();
+    GLD_CALL(glViewport(x, y, width, height));
+  }
+
+  static inline rlhresult_t _rlhAtlasCreate(rlhAtlasCreateInfo_t *atlas_info, rlhAtlas_h *atlas, const rlhbool_t async)
+  {
+    if (atlas == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhresult_t result = _rlhAtlasInfoCheck(atlas_info);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    rlhAtlas_h atlas_h = (rlhAtlas_h)_rlhAllocate(&_rlh_allocator, sizeof(rlhAtlas_s));
+    if (atlas_h == NULL)
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    memset(atlas_h, 0, sizeof(rlhAtlas_s));
+    atlas_h->allocator = _rlh_allocator;
+    atlas_h->glyph_count = atlas_info->glyph_count;
+    atlas_h->glyph_capacity = (atlas_info->glyph_capacity > atlas_info->glyph_count) ? atlas_info->glyph_capacity : atlas_info->glyph_count;
+    atlas_h->glyph_stpqp = (float *)_rlhAllocate(&atlas_h->allocator, atlas_h->glyph_capacity * RLH_FONTMAP_COORDINATES_PER_GLYPH * sizeof(float));
+    if (atlas_h->glyph_stpqp == NULL)
+    {
+      _rlhDeallocate(&atlas_h->allocator, atlas_h);
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    if (atlas_h->glyph_count > 0)
+    {
+      memcpy(atlas_h->glyph_stpqp, atlas_info->glyph_stpqp, atlas_h->glyph_count * RLH_FONTMAP_COORDINATES_PER_GLYPH * sizeof(float));
+    }
+    atlas_h->reference_count = 1;
+    atlas_h->width = atlas_info->width;
+    atlas_h->height = atlas_info->height;
+    atlas_h->pages = atlas_info->pages;
+    atlas_h->color = atlas_info->color;
+    atlas_h->channel_size = atlas_info->channel_size;
+    atlas_h->fragment_type = _rlhColorTypeToFragmentType(atlas_info->color);
+    // the pixels of an asynchronous atlas are staged in a pixel buffer instead of uploaded right away.
+    rlhAtlasCreateInfo_t texture_info = *atlas_info;
+    if (async)
+    {
+      texture_info.pixel_data = NULL;
+    }
+    result = _rlhCreateGlTextureArray(&texture_info, &atlas_h->gl_texture_2d_array);
+    if (result == RLH_RESULT_OK)
+    {
+      result = _rlhAtlasCreateGlyphTable(atlas_h);
+    }
+    if (result == RLH_RESULT_OK && async)
+    {
+      result = _rlhAtlasMapPixelBuffer(atlas_h);
+    }
+    if (result != RLH_RESULT_OK)
+    {
+      _rlhAtlasFree(atlas_h);
+      return result;
+    }
+    if (async && atlas_info->pixel_data != NULL)
+    {
+      memcpy(atlas_h->gl_pixel_buffer_map, atlas_info->pixel_data, _rlhAtlasGetPixelSize(atlas_h));
+      _rlhAtlasStartUpload(atlas_h);
+    }
+    *atlas = atlas_h;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhAtlasCreate(rlhAtlasCreateInfo_t *atlas_info, rlhAtlas_h *atlas)
+  {
+    return _rlhAtlasCreate(atlas_info, atlas, RLH_FALSE);
+  }
+
+  rlhresult_t rlhAtlasCreateAsync(rlhAtlasCreateInfo_t *atlas_info, rlhAtlas_h *atlas)
+  {
+    return _rlhAtlasCreate(atlas_info, atlas, RLH_TRUE);
+  }
+
+  uint8_t *rlhAtlasGetStagingPixels(rlhAtlas_h const atlas)
+  {
+    if (atlas == NULL)
+    {
+      return NULL;
+    }
+    return atlas->gl_pixel_buffer_map;
+  }
+
+  rlhresult_t rlhAtlasStartUpload(rlhAtlas_h const atlas)
+  {
+    if (atlas == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (atlas->gl_pixel_buffer_map == NULL)
+    {
+      // the upload already started, or the atlas was not created asynchronously.
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    _rlhAtlasStartUpload(atlas);
+    return RLH_RESULT_OK;
+  }
+
+  rlhbool_t rlhAtlasIsReady(rlhAtlas_h const atlas)
+  {
+    if (atlas == NULL)
+    {
+      return RLH_FALSE;
+    }
+    if (atlas->gl_pixel_buffer == GL_NONE)
+    {
+      return RLH_TRUE;
+    }
+    if (atlas->gl_upload_fence == NULL)
+    {
+      return RLH_FALSE;
+    }
+    GLD_START();
+    GLenum wait_result = GL_TIMEOUT_EXPIRED;
+    GLD_CALL(wait_result = glClientWaitSync(atlas->gl_upload_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0));
+    if (wait_result != GL_ALREADY_SIGNALED && wait_result != GL_CONDITION_SATISFIED)
+    {
+      return RLH_FALSE;
+    }
+    _rlhAtlasDestroyPixelBuffer(atlas);
+    return RLH_TRUE;
+  }
+
+  void rlhAtlasDestroy(rlhAtlas_h const atlas)
+  {
+    _rlhAtlasRelease(atlas);
+  }
+
+  int rlhAtlasGetGlyphCount(rlhAtlas_h const atlas)
+  {
+    if (atlas == NULL)
+    {
+      return 0;
+    }
+    return (int)atlas->glyph_count;
+  }
+
+  rlhcolortype_t rlhAtlasGetColor(rlhAtlas_h const atlas)
+  {
+    if (atlas == NULL)
+    {
+      return RLH_COLOR_TYPE_COUNT;
+    }
+    return atlas->color;
+  }
+
+  rlhresult_t rlhAtlasUploadPixels(rlhAtlas_h const atlas, const int x, const int y, const int page,
+                                   const int width, const int height, const uint8_t *const pixel_data)
+  {
+    if (atlas == NULL || pixel_data == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (
+        x < 0 || y < 0 || page < 0 ||
+        width <= 0 || height <= 0 ||
+        (size_t)x + width > atlas->width ||
+        (size_t)y + height > atlas->height ||
+        (size_t)page >= atlas->pages)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    GLD_START();
+    _rlhBindTexture(RLH_ATLAS_TEXTURE_SLOT, atlas->gl_texture_2d_array);
+    // rows of a small glyph are rarely a multiple of 4 bytes long, so the alignment of the caller is swapped
+    // out for the upload.
+    GLint saved_unpack_alignment = 4;
+    GLD_CALL(glGetIntegerv(GL_UNPACK_ALIGNMENT, &saved_unpack_alignment));
+    GLD_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    GLD_CALL(glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, page, width, height, 1,
+                             _rlhColorTypeToGlFormat(atlas->color), _rlhChannelSizeToType(atlas->channel_size), pixel_data));
+    GLD_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, saved_unpack_alignment));
+    atlas->version++;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhAtlasSetGlyphs(rlhAtlas_h const atlas, const int first_glyph, const int glyph_count, const float *const glyph_stpqp)
+  {
+    if (atlas == NULL || glyph_stpqp == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    // glyphs can only be appended right after the last glyph, so there are no glyphs without coordinates.
+    if (first_glyph < 0 || glyph_count <= 0 || (size_t)first_glyph > atlas->glyph_count)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    const size_t end_glyph = (size_t)first_glyph + glyph_count;
+    const rlhbool_t grow = end_glyph > atlas->glyph_capacity;
+    if (grow)
+    {
+      // double the glyph capacity until the glyphs fit, so that appending one glyph at a time is cheap.
+      size_t new_capacity = atlas->glyph_capacity * 2;
+      while (new_capacity < end_glyph)
+      {
+        new_capacity *= 2;
+      }
+      float *const new_glyph_stpqp = (float *)_rlhReallocate(&atlas->allocator, atlas->glyph_stpqp, new_capacity * RLH_FONTMAP_COORDINATES_PER_GLYPH * sizeof(float));
+      if (new_glyph_stpqp == NULL)
+      {
+        return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+      }
+      atlas->glyph_stpqp = new_glyph_stpqp;
+      atlas->glyph_capacity = new_capacity;
+    }
+    memcpy(
+        atlas->glyph_stpqp + first_glyph * RLH_FONTMAP_COORDINATES_PER_GLYPH,
+        glyph_stpqp,
+        glyph_count * RLH_FONTMAP_COORDINATES_PER_GLYPH * sizeof(float));
+    if (end_glyph > atlas->glyph_count)
+    {
+      atlas->glyph_count = end_glyph;
+    }
+    atlas->version++;
+    if (grow)
+    {
+      return _rlhAtlasCreateGlyphTable(atlas);
+    }
+    return _rlhAtlasUploadGlyphTable(atlas, first_glyph, glyph_count);
+  }
+
+  // Map a whole file into read only memory, or read it into memory where files can not be mapped.
+  static inline rlhresult_t _rlhMapFile(const char *const path, const rlhAllocator_t *const allocator, void **const data, size_t *const size)
+  {
+#if defined(RLH_FILE_MAPPING_WIN32)
+    (void)allocator;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0)
+    {
+      CloseHandle(file);
+      return RLH_RESULT_ERROR_FILE;
+    }
+    // the view keeps the mapping and the file open until it is unmapped.
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (*data == NULL)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    *size = (size_t)file_size.QuadPart;
+    return RLH_RESULT_OK;
+#elif defined(RLH_FILE_MAPPING_POSIX)
+    (void)allocator;
+    const int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0 || file_stat.st_size <= 0)
+    {
+      close(file);
+      return RLH_RESULT_ERROR_FILE;
+    }
+    // the mapping keeps the file open until it is unmapped.
+    void *const map = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    *data = map;
+    *size = (size_t)file_stat.st_size;
+    return RLH_RESULT_OK;
+#else
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    long file_size = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+      file_size = ftell(file);
+    }
+    if (file_size <= 0 || fseek(file, 0, SEEK_SET) != 0)
+    {
+      fclose(file);
+      return RLH_RESULT_ERROR_FILE;
+    }
+    void *const buffer = _rlhAllocate(allocator, (size_t)file_size);
+    if (buffer == NULL)
+    {
+      fclose(file);
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    const size_t read_size = fread(buffer, 1, (size_t)file_size, file);
+    fclose(file);
+    if (read_size != (size_t)file_size)
+    {
+      _rlhDeallocate(allocator, buffer);
+      return RLH_RESULT_ERROR_FILE;
+    }
+    *data = buffer;
+    *size = (size_t)file_size;
+    return RLH_RESULT_OK;
+#endif
+  }
+
+  static inline void _rlhUnmapFile(const rlhAllocator_t *const allocator, void *const data, const size_t size)
+  {
+#if defined(RLH_FILE_MAPPING_WIN32)
+    (void)allocator;
+    (void)size;
+    UnmapViewOfFile(data);
+#elif defined(RLH_FILE_MAPPING_POSIX)
+    (void)allocator;
+    munmap(data, size);
+#else
+    (void)size;
+    _rlhDeallocate(allocator, data);
+#endif
+  }
+
+  rlhresult_t rlhAtlasFileParse(const void *const data, const size_t size, rlhAtlasCreateInfo_t *const atlas_info)
+  {
+    if (data == NULL || atlas_info == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhAtlasFileHeader_s header;
+    if (size < sizeof(rlhAtlasFileHeader_s))
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    memcpy(&header, data, sizeof(rlhAtlasFileHeader_s));
+    if (memcmp(header.magic, RLH_ATLAS_FILE_MAGIC, sizeof(RLH_ATLAS_FILE_MAGIC)) != 0 || header.version != RLH_ATLAS_FILE_VERSION)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    if (
+        header.width == 0 || header.width > RLH_ATLAS_FILE_MAX_DIMENSION ||
+        header.height == 0 || header.height > RLH_ATLAS_FILE_MAX_DIMENSION ||
+        header.pages == 0 || header.pages > RLH_ATLAS_FILE_MAX_DIMENSION ||
+        header.glyph_count == 0 || header.glyph_count > INT32_MAX ||
+        header.color >= RLH_COLOR_TYPE_COUNT ||
+        _rlhChannelSizeToType(header.channel_size) == GL_NONE)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    memset(atlas_info, 0, sizeof(rlhAtlasCreateInfo_t));
+    atlas_info->width = (int)header.width;
+    atlas_info->height = (int)header.height;
+    atlas_info->pages = (int)header.pages;
+    atlas_info->channel_size = (int)header.channel_size;
+    atlas_info->color = (rlhcolortype_t)header.color;
+    atlas_info->glyph_count = (int)header.glyph_count;
+    const uint64_t stpqp_size = (uint64_t)header.glyph_count * RLH_FONTMAP_COORDINATES_PER_GLYPH * sizeof(float);
+    // computed in 64 bits like _rlhGetAtlasPageSize(), which can not overflow with the dimensions checked above.
+    const uint64_t row_size = (uint64_t)header.width * _rlhColorTypeToChannelCount(atlas_info->color) * header.channel_size;
+    const uint64_t pixel_size = ((row_size + 3) & ~(uint64_t)3) * header.height * header.pages;
+    // the tables must be inside of the file, and the glyph coordinates must be aligned for reading floats.
+    if (
+        header.stpqp_offset % sizeof(float) != 0 ||
+        header.stpqp_offset > size || size - header.stpqp_offset < stpqp_size ||
+        header.pixel_offset > size || size - header.pixel_offset < pixel_size ||
+        header.pixel_size != pixel_size)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    // the atlas only ever reads from the pixels and glyph coordinates.
+    atlas_info->glyph_stpqp = (float *)((const uint8_t *)data + header.stpqp_offset);
+    atlas_info->pixel_data = (uint8_t *)data + header.pixel_offset;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhAtlasFileWrite(const char *const path, const rlhAtlasCreateInfo_t *const atlas_info)
+  {
+    if (path == NULL || atlas_info == NULL || atlas_info->pixel_data == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhresult_t result = _rlhAtlasInfoCheck((rlhAtlasCreateInfo_t *)atlas_info);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    if (atlas_info->glyph_count == 0 || _rlhChannelSizeToType(atlas_info->channel_size) == GL_NONE)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    rlhAtlasFileHeader_s header;
+    memset(&header, 0, sizeof(rlhAtlasFileHeader_s));
+    memcpy(header.magic, RLH_ATLAS_FILE_MAGIC, sizeof(RLH_ATLAS_FILE_MAGIC));
+    header.version = RLH_ATLAS_FILE_VERSION;
+    header.width = (uint32_t)atlas_info->width;
+    header.height = (uint32_t)atlas_info->height;
+    header.pages = (uint32_t)atlas_info->pages;
+    header.channel_size = (uint32_t)atlas_info->channel_size;
+    header.color = (uint32_t)atlas_info->color;
+    header.glyph_count = (uint32_t)atlas_info->glyph_count;
+    const size_t stpqp_size = atlas_info->glyph_count * RLH_FONTMAP_COORDINATES_PER_GLYPH * sizeof(float);
+    const size_t stpqp_end = sizeof(rlhAtlasFileHeader_s) + stpqp_size;
+    header.stpqp_offset = sizeof(rlhAtlasFileHeader_s);
+    header.pixel_offset = (stpqp_end + RLH_ATLAS_FILE_PIXEL_ALIGNMENT - 1) / RLH_ATLAS_FILE_PIXEL_ALIGNMENT * RLH_ATLAS_FILE_PIXEL_ALIGNMENT;
+    header.pixel_size = (uint64_t)_rlhGetAtlasPageSize(atlas_info->width, atlas_info->height, atlas_info->color, atlas_info->channel_size) * atlas_info->pages;
+    const uint8_t padding[16] = {0};
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+      return RLH_RESULT_ERROR_FILE;
+    }
+    rlhbool_t written =
+        fwrite(&header, sizeof(rlhAtlasFileHeader_s), 1, file) == 1 &&
+        fwrite(atlas_info->glyph_stpqp, stpqp_size, 1, file) == 1 &&
+        fwrite(padding, 1, header.pixel_offset - stpqp_end, file) == header.pixel_offset - stpqp_end &&
+        fwrite(atlas_info->pixel_data, header.pixel_size, 1, file) == 1;
+    if (fclose(file) != 0)
+    {
+      written = RLH_FALSE;
+    }
+    return written ? RLH_RESULT_OK : RLH_RESULT_ERROR_FILE;
+  }
+
+  rlhresult_t rlhAtlasFileOpen(const char *const path, rlhAtlasFile_h *atlas_file)
+  {
+    if (path == NULL || atlas_file == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhAtlasFile_h atlas_file_h = (rlhAtlasFile_h)_rlhAllocate(&_rlh_allocator, sizeof(rlhAtlasFile_s));
+    if (atlas_file_h == NULL)
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    memset(atlas_file_h, 0, sizeof(rlhAtlasFile_s));
+    atlas_file_h->allocator = _rlh_allocator;
+    rlhresult_t result = _rlhMapFile(path, &atlas_file_h->allocator, &atlas_file_h->data, &atlas_file_h->size);
+    if (result != RLH_RESULT_OK)
+    {
+      _rlhDeallocate(&atlas_file_h->allocator, atlas_file_h);
+      return result;
+    }
+    result = rlhAtlasFileParse(atlas_file_h->data, atlas_file_h->size, &atlas_file_h->info);
+    if (result != RLH_RESULT_OK)
+    {
+      _rlhUnmapFile(&atlas_file_h->allocator, atlas_file_h->data, atlas_file_h->size);
+      _rlhDeallocate(&atlas_file_h->allocator, atlas_file_h);
+      return result;
+    }
+    *atlas_file = atlas_file_h;
+    return RLH_RESULT_OK;
+  }
+
+  void rlhAtlasFileClose(rlhAtlasFile_h const atlas_file)
+  {
+    if (atlas_file == NULL)
+      return;
+    const rlhAllocator_t allocator = atlas_file->allocator;
+    _rlhUnmapFile(&allocator, atlas_file->data, atlas_file->size);
+    _rlhDeallocate(&allocator, atlas_file);
+  }
+
+  rlhAtlasCreateInfo_t *rlhAtlasFileGetInfo(rlhAtlasFile_h const atlas_file)
+  {
+    if (atlas_file == NULL)
+    {
+      return NULL;
+    }
+    return &atlas_file->info;
+  }
+
+  rlhresult_t rlhAtlasCreateFromFile(const char *const path, rlhAtlas_h *atlas)
+  {
+    if (path == NULL || atlas == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhAtlasFile_h atlas_file = NULL;
+    rlhresult_t result = rlhAtlasFileOpen(path, &atlas_file);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    result = rlhAtlasCreate(&atlas_file->info, atlas);
+    rlhAtlasFileClose(atlas_file);
+    return result;
+  }
+
+  static inline void _rlhTermDestroyGpuTimers(rlhTerm_h const term)
+  {
+    if (term->gl_timer_queries[0] == GL_NONE)
+      return;
+    GLD_START();
+    GLD_CALL(glDeleteQueries(RLH_TIMER_QUERY_COUNT, term->gl_timer_queries));
+    memset(term->gl_timer_queries, 0, sizeof(term->gl_timer_queries));
+    term->timer_query_next = 0;
+    term->timer_queries_pending = 0;
+  }
+
+  rlhresult_t rlhTermCreate(rlhTermCreateInfo_t *term_info, rlhTerm_h *term)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhresult_t result = _rlhTermInfoCheck(term_info);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    const rlhAllocator_t allocator = (term_info->allocator != NULL) ? *term_info->allocator : _rlh_allocator;
+    rlhTerm_h term_h = (rlhTerm_h)_rlhAllocate(&allocator, sizeof(rlhTerm_s));
+    if (term_h == NULL)
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+
+    memset(term_h, 0, sizeof(rlhTerm_s));
+    term_h->allocator = allocator;
+    for (size_t channel_i = 0; channel_i < 3; channel_i++)
+    {
+      term_h->explored_light[channel_i] = RLH_DEFAULT_EXPLORED_LIGHT;
+    }
+    _rlhTermSetPixelSize(
+        term_h,
+        term_info->size_info);
+    result = _rlhTermAddLayer(
+        term_h,
+        RLH_DEFAULT_LAYER_NAME,
+        0,
+        RLH_DEFAULT_LAYER_MODE,
+        term_h->tiles_wide * term_h->tiles_tall);
+    if (result != RLH_RESULT_OK)
+    {
+      _rlhTermDestroyLayers(term_h);
+      _rlhDeallocate(&allocator, term_h);
+      return result;
+    }
+    if (term_info->atlas != NULL)
+    {
+      _rlhTermUseAtlas(term_h, term_info->atlas);
+    }
+    else
+    {
+      result = _rlhTermSetAtlas(term_h, term_info->atlas_info);
+      if (result != RLH_RESULT_OK)
+      {
+        _rlhTermDestroyLayers(term_h);
+        _rlhDeallocate(&allocator, term_h);
+        return result;
+      }
+    }
+    _rlh_term_count++;
+    *term = term_h;
+    return RLH_RESULT_OK;
+  }
+
+  void rlhTermDestroy(rlhTerm_h const term)
+  {
+    if (term == NULL)
+      return;
+    _rlhTermDestroyLayers(term);
+    _rlhTermDestroyGrid(term);
+    _rlhReleaseProgram(term->program);
+    term->program = NULL;
+    _rlhTermDropPendingAtlas(term);
+    _rlhAtlasRelease(term->atlas);
+    term->atlas = NULL;
+    for (size_t atlas_i = 1; atlas_i < RLH_MAX_TERM_ATLASES; atlas_i++)
+    {
+      _rlhReleaseProgram(term->atlas_programs[atlas_i]);
+      _rlhAtlasRelease(term->atlases[atlas_i]);
+    }
+    _rlhDeallocate(&term->allocator, term->atlas_sort_data);
+    _rlhTermDestroyGpuTimers(term);
+    _rlhTermDestroyRenderCache(term);
+    _rlhTermDestroyPalette(term);
+    _rlhTermDestroyEffects(term);
+    _rlhTermDestroyLightMap(term);
+    _rlhTermDestroyFrames(term);
+    _rlhTilemapRelease(term->tilemap);
+    _rlhDeallocate(&term->allocator, term->cover_cells);
+    const rlhAllocator_t allocator = term->allocator;
+    _rlhDeallocate(&allocator, term);
+    _rlh_term_count--;
+    if (_rlh_term_count == 0)
+    {
+      _rlhBatchDestroy();
+    }
+  }
+
+  rlhresult_t rlhTermSetAtlas(rlhTerm_h const term, rlhAtlasCreateInfo_t *atlas_info)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhresult_t result = _rlhAtlasInfoCheck(atlas_info);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    return _rlhTermSetAtlas(term, atlas_info);
+  }
+
+  rlhresult_t rlhTermSetSharedAtlas(rlhTerm_h const term, rlhAtlas_h const atlas)
+  {
+    if (term == NULL || atlas == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (term->atlas != NULL && term->atlas != atlas && !rlhAtlasIsReady(atlas))
+    {
+      // keep drawing with the current atlas until the new one is uploaded.
+      atlas->reference_count++;
+      _rlhTermDropPendingAtlas(term);
+      term->pending_atlas = atlas;
+      return RLH_RESULT_OK;
+    }
+    _rlhTermDropPendingAtlas(term);
+    _rlhTermUseAtlas(term, atlas);
+    return RLH_RESULT_OK;
+  }
+
+  rlhAtlas_h rlhTermGetAtlas(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return NULL;
+    }
+    return term->atlas;
+  }
+
+  rlhresult_t rlhTermBindAtlas(rlhTerm_h const term, const int atlas_index, rlhAtlas_h const atlas)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (atlas_index <= 0 || atlas_index >= RLH_MAX_TERM_ATLASES)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    rlhProgram_s *program = NULL;
+    if (atlas != NULL)
+    {
+      atlas->reference_count++;
+      program = _rlhAcquireProgram(_rlh_tile_programs, atlas->fragment_type, RLH_VERTEX_SOURCE, RLH_FRAGMENT_TILE_SOURCE);
+    }
+    if (term->atlases[atlas_index] != NULL)
+    {
+      term->extra_atlas_count--;
+    }
+    _rlhReleaseProgram(term->atlas_programs[atlas_index]);
+    _rlhAtlasRelease(term->atlases[atlas_index]);
+    term->atlases[atlas_index] = atlas;
+    term->atlas_programs[atlas_index] = program;
+    if (atlas != NULL)
+    {
+      term->extra_atlas_count++;
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSelectAtlas(rlhTerm_h const term, const int atlas_index)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (atlas_index < 0 || atlas_index >= RLH_MAX_TERM_ATLASES)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    term->push_glyph_bits = (term->push_glyph_bits & ~RLH_TILE_ATLAS_MASK) | ((uint32_t)atlas_index << RLH_TILE_ATLAS_SHIFT);
+    return RLH_RESULT_OK;
+  }
+
+  int rlhTermGetGlyphCount(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return 0;
+    }
+    return (int)_rlhTermGetGlyphCount(term);
+  }
+
+  float rlhTermGetPixelScale(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return 0.0f;
+    }
+    return term->pixel_scale;
+  }
+
+  void rlhTermGetTerminalSize(rlhTerm_h const term, int *const tiles_wide, int *const tiles_tall)
+  {
+    if (term == NULL)
+    {
+      return;
+    }
+    if (tiles_wide != NULL)
+    {
+      *tiles_wide = (int)term->tiles_wide;
+    }
+    if (tiles_tall != NULL)
+    {
+      *tiles_tall = (int)term->tiles_tall;
+    }
+  }
+
+  void rlhTermGetScaledPixelSize(rlhTerm_h const term, int *const pixel_width, int *const pixel_height)
+  {
+    if (term == NULL)
+    {
+      return;
+    }
+    if (pixel_width != NULL)
+    {
+      *pixel_width = (int)term->scaled_pixel_width;
+    }
+    if (pixel_height != NULL)
+    {
+      *pixel_height = (int)term->scaled_pixel_height;
+    }
+  }
+
+  void rlhTermGetUnscaledPixelSize(rlhTerm_h const term, int *const pixel_width, int *const pixel_height)
+  {
+    if (term == NULL)
+    {
+      return;
+    }
+    if (pixel_width != NULL)
+    {
+      *pixel_width = (int)term->unscaled_pixel_width;
+    }
+    if (pixel_height != NULL)
+    {
+      *pixel_height = (int)term->unscaled_pixel_height;
+    }
+  }
+
+  void rlhTermGetTileSize(rlhTerm_h const term, int *const tile_width, int *const tile_height)
+  {
+    if (term == NULL)
+    {
+      return;
+    }
+    if (tile_width != NULL)
+    {
+      *tile_width = (int)term->tile_width;
+    }
+    if (tile_height != NULL)
+    {
+      *tile_height = (int)term->tile_height;
+    }
+  }
+
+  rlhresult_t rlhTermClearTileData(rlhTerm_h term)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    _rlhTileBufferClear(term->tiles);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetStreamMode(rlhTerm_h const term, const rlhstreammode_t stream_mode)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (stream_mode < RLH_STREAM_ORPHAN || stream_mode >= RLH_STREAM_MODE_COUNT)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    // retained layers keep their tiles between draws and only upload the dirty tile ranges.
+    if (term->layers[term->selected_layer].mode == RLH_LAYER_RETAINED && stream_mode != RLH_STREAM_ORPHAN)
+    {
+      return RLH_RESULT_ERROR_UNSUPPORTED;
+    }
+    if (stream_mode == term->tiles->stream_mode)
+    {
+      return RLH_RESULT_OK;
+    }
+    if (stream_mode == RLH_STREAM_PERSISTENT && !_rlhGlSupportsBufferStorage())
+    {
+      return RLH_RESULT_ERROR_UNSUPPORTED;
+    }
+    rlhTermClearTileData(term);
+    _rlhTileBufferCreateVertexArray(term->tiles);
+    if (stream_mode == RLH_STREAM_PERSISTENT)
+    {
+      rlhTileInstance_s *const vertex_data = term->tiles->vertex_data;
+      const size_t tile_capacity = (term->tiles->vertex_data_tile_capacity == 0) ? RLH_MIN_TILE_CAPACITY : term->tiles->vertex_data_tile_capacity;
+      rlhresult_t result = _rlhTileBufferCreatePersistentVertexBuffer(term->tiles, tile_capacity);
+      if (result != RLH_RESULT_OK)
+      {
+        return result;
+      }
+      // the tile buffer is now the mapped vertex buffer, so the old tile buffer is not needed.
+      _rlhDeallocate(term->tiles->allocator, vertex_data);
+    }
+    else if (term->tiles->stream_mode == RLH_STREAM_PERSISTENT)
+    {
+      rlhTileInstance_s *vertex_data = (rlhTileInstance_s *)_rlhAllocate(term->tiles->allocator, _rlhGetVertexDataSize(term->tiles->vertex_data_tile_capacity));
+      if (vertex_data == NULL)
+      {
+        return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+      }
+      term->tiles->vertex_data = vertex_data;
+      _rlhTileBufferReplaceVertexBuffer(term->tiles);
+    }
+    else
+    {
+      _rlhTileBufferReleaseStreamFences(term->tiles);
+      term->tiles->gl_vertex_buffer_tile_capacity = 0;
+    }
+    term->tiles->stream_segment = 0;
+    term->tiles->stream_mode = stream_mode;
+    return RLH_RESULT_OK;
+  }
+
+  rlhstreammode_t rlhTermGetStreamMode(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return RLH_STREAM_ORPHAN;
+    }
+    return term->tiles->stream_mode;
+  }
+
+  rlhresult_t rlhTermAddLayer(rlhTerm_h const term, const char *const name, const int z_order,
+                              const rlhlayermode_t mode, int *const layer)
+  {
+    if (term == NULL || name == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    int existing_layer;
+    if (
+        mode < RLH_LAYER_IMMEDIATE ||
+        mode >= RLH_LAYER_MODE_COUNT ||
+        strlen(name) > RLH_MAX_LAYER_NAME_LENGTH ||
+        rlhTermFindLayer(term, name, &existing_layer) == RLH_RESULT_OK)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    rlhresult_t result = _rlhTermAddLayer(term, name, z_order, mode, 0);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    if (layer != NULL)
+    {
+      *layer = (int)term->layer_count - 1;
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermFindLayer(rlhTerm_h const term, const char *const name, int *const layer)
+  {
+    if (term == NULL || name == NULL || layer == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+    {
+      if (strcmp(term->layers[layer_i].name, name) == 0)
+      {
+        *layer = (int)layer_i;
+        return RLH_RESULT_OK;
+      }
+    }
+    return RLH_RESULT_ERROR_INVALID_VALUE;
+  }
+
+  rlhresult_t rlhTermSelectLayer(rlhTerm_h const term, const int layer)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (layer < 0 || (size_t)layer >= term->layer_count)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    term->selected_layer = (size_t)layer;
+    term->tiles = &term->layers[layer].tiles;
+    return RLH_RESULT_OK;
+  }
+
+  int rlhTermGetSelectedLayer(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return 0;
+    }
+    return (int)term->selected_layer;
+  }
+
+  int rlhTermGetLayerCount(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return 0;
+    }
+    return (int)term->layer_count;
+  }
+
+  rlhresult_t rlhTermClearLayer(rlhTerm_h const term, const int layer)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (layer < 0 || (size_t)layer >= term->layer_count)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    _rlhTileBufferClear(&term->layers[layer].tiles);
+    return RLH_RESULT_OK;
+  }
+
+  int rlhTermGetTileDataCount(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return 0;
+    }
+    return (int)term->tiles->vertex_data_tile_count;
+  }
+
+  // Resize the tile buffer to room for exactly tile_capacity tiles, which must not be less than the tiles it holds.
+  static inline rlhbool_t _rlhTileBufferTrySetCapacity(rlhTileBuffer_s *const tiles, const size_t tile_capacity)
+  {
+    if (tiles->stream_mode == RLH_STREAM_PERSISTENT)
+    {
+      return _rlhTileBufferCreatePersistentVertexBuffer(tiles, tile_capacity) == RLH_RESULT_OK;
+    }
+    rlhTileInstance_s *new_vertex_data = (rlhTileInstance_s *)_rlhReallocate(
+        tiles->allocator,
+        tiles->vertex_data,
+        _rlhGetVertexDataSize(tile_capacity));
+    if (new_vertex_data == NULL)
+    {
+      return RLH_FALSE; // out of memory
+    }
+    tiles->vertex_data = new_vertex_data;
+    tiles->vertex_data_tile_capacity = tile_capacity;
+    return RLH_TRUE;
+  }
+
+  // Make sure there is room in the tile buffer for extra_tiles more tiles.
+  static inline rlhbool_t _rlhTileBufferTryReserveTiles(rlhTileBuffer_s *const tiles, const size_t extra_tiles)
+  {
+    // If we hit the reserved tile count, double the amount of reserved space until the tiles fit.
+    const size_t needed_capacity = tiles->vertex_data_tile_count + extra_tiles;
+    if (needed_capacity <= tiles->vertex_data_tile_capacity)
+      return RLH_TRUE;
+    size_t new_capacity = (tiles->vertex_data_tile_capacity == 0) ? RLH_MIN_TILE_CAPACITY : tiles->vertex_data_tile_capacity * 2;
+    while (new_capacity < needed_capacity)
+    {
+      new_capacity *= 2;
+    }
+    return _rlhTileBufferTrySetCapacity(tiles, new_capacity);
+  }
+
+  // Count a tile buffer of a terminal that grew from old_capacity in the stats of the terminal.
+  static inline void _rlhTermCountTileBufferGrowth(rlhTerm_h const term, const rlhTileBuffer_s *const tiles, const size_t old_capacity)
+  {
+    if (tiles->vertex_data_tile_capacity > old_capacity)
+    {
+      term->stats.tile_buffer_reallocs++;
+      term->stats.peak_tile_capacity = MAX(term->stats.peak_tile_capacity, tiles->vertex_data_tile_capacity);
+    }
+  }
+
+  // Make sure there is room in the selected tile buffer of a terminal for extra_tiles more tiles, and
+  // count it in the stats of the terminal if the tile buffer had to grow.
+  static inline rlhbool_t _rlhTermTryReserveTiles(rlhTerm_h const term, const size_t extra_tiles)
+  {
+    rlhTileBuffer_s *const tiles = term->tiles;
+    const size_t old_capacity = tiles->vertex_data_tile_capacity;
+    if (!_rlhTileBufferTryReserveTiles(tiles, extra_tiles))
+      return RLH_FALSE;
+    _rlhTermCountTileBufferGrowth(term, tiles, old_capacity);
+    return RLH_TRUE;
+  }
+
+  static inline rlhbool_t _rlhTermTryReserveVertexData(rlhTerm_h const term)
+  {
+    return _rlhTermTryReserveTiles(term, 1);
+  }
+
+  static inline size_t _rlhTileBufferCountDirtyTiles(const rlhTileBuffer_s *const tiles)
+  {
+    size_t dirty_count = 0;
+    const size_t word_count = _rlhGetDirtyTileWordCount(MIN(tiles->vertex_data_tile_count, tiles->dirty_tile_bit_capacity));
+    for (size_t word_i = 0; word_i < word_count; word_i++)
+    {
+      for (uint64_t word = tiles->dirty_tile_bits[word_i]; word != 0; word &= word - 1)
+      {
+        dirty_count++;
+      }
+    }
+    return dirty_count;
+  }
+
+  static inline void _rlhTileBufferUploadTileRange(rlhTileBuffer_s *const tiles, const size_t begin, const size_t end)
+  {
+    GLD_START();
+    GLD_CALL(glBufferSubData(
+        GL_ARRAY_BUFFER,
+        _rlhGetVertexDataSize(begin),
+        _rlhGetVertexDataSize(end - begin),
+        tiles->vertex_data + begin));
+    tiles->uploaded_byte_count += _rlhGetVertexDataSize(end - begin);
+  }
+
+  // Upload the runs of dirty tiles in the dirty tile bitmap, joining runs that are only a few tiles apart.
+  static inline void _rlhTileBufferUploadDirtyTileBits(rlhTileBuffer_s *const tiles)
+  {
+    const size_t tile_count = MIN(tiles->vertex_data_tile_count, tiles->dirty_tile_bit_capacity);
+    const size_t word_count = _rlhGetDirtyTileWordCount(tile_count);
+    size_t run_begin = 0;
+    size_t run_end = 0;
+    for (size_t word_i = 0; word_i < word_count; word_i++)
+    {
+      uint64_t word = tiles->dirty_tile_bits[word_i];
+      for (size_t bit_i = 0; word != 0; bit_i++, word >>= 1)
+      {
+        if ((word & 1) == 0)
+          continue;
+        const size_t tile_i = word_i * 64 + bit_i;
+        if (tile_i >= tile_count)
+          break;
+        if (run_end != 0 && tile_i - run_end > RLH_DIRTY_TILE_MERGE_GAP)
+        {
+          _rlhTileBufferUploadTileRange(tiles, run_begin, run_end);
+          run_end = 0;
+        }
+        if (run_end == 0)
+          run_begin = tile_i;
+        run_end = tile_i + 1;
+      }
+    }
+    if (run_end != 0)
+    {
+      _rlhTileBufferUploadTileRange(tiles, run_begin, run_end);
+    }
+  }
+
+  // Upload the dirty tiles to the vertex buffer. If the buffer is too small or at least half of the
+  // tiles changed, the buffer is orphaned and refilled, otherwise only the dirty tiles are uploaded.
+  static inline void _rlhTileBufferUploadVertexData(rlhTileBuffer_s *const tiles)
+  {
+    if (!_rlhTileBufferHasDirtyTiles(tiles))
+      return;
+    GLD_START();
+    rlhbool_t full_upload = tiles->vertex_data_tile_count > tiles->gl_vertex_buffer_tile_capacity;
+    if (tiles->dirty_tile_bits_used)
+    {
+      full_upload = full_upload || _rlhTileBufferCountDirtyTiles(tiles) * 2 >= tiles->vertex_data_tile_count;
+    }
+    for (size_t range_i = 0; range_i < tiles->dirty_tile_range_count && !full_upload; range_i++)
+    {
+      const rlhTileRange_s *const range = &tiles->dirty_tile_ranges[range_i];
+      full_upload = range->begin == 0 && range->end >= tiles->vertex_data_tile_count;
+    }
+    if (full_upload)
+    {
+      if (tiles->vertex_data_tile_count > tiles->gl_vertex_buffer_tile_capacity)
+      {
+        tiles->gl_vertex_buffer_tile_capacity = tiles->vertex_data_tile_capacity;
+      }
+      GLD_CALL(glBufferData(GL_ARRAY_BUFFER, _rlhGetVertexDataSize(tiles->gl_vertex_buffer_tile_capacity), NULL, GL_DYNAMIC_DRAW));
+      GLD_CALL(glBufferSubData(GL_ARRAY_BUFFER, 0, _rlhGetVertexDataSize(tiles->vertex_data_tile_count), tiles->vertex_data));
+      tiles->uploaded_byte_count += _rlhGetVertexDataSize(tiles->vertex_data_tile_count);
+    }
+    else if (tiles->dirty_tile_bits_used)
+    {
+      _rlhTileBufferUploadDirtyTileBits(tiles);
+    }
+    else
+    {
+      for (size_t range_i = 0; range_i < tiles->dirty_tile_range_count; range_i++)
+      {
+        const rlhTileRange_s *const range = &tiles->dirty_tile_ranges[range_i];
+        const size_t end = (range->end < tiles->vertex_data_tile_count) ? range->end : tiles->vertex_data_tile_count;
+        if (range->begin >= end)
+          continue;
+        _rlhTileBufferUploadTileRange(tiles, range->begin, end);
+      }
+    }
+    _rlhTileBufferClearDirtyTiles(tiles);
+  }
+
+  // Copy the tile buffer to the next segment of a ring of vertex buffer segments, after waiting for
+  // the draw that last used that segment to finish. Returns the index of the first tile in the ring.
+  static inline size_t _rlhTileBufferStreamRingVertexData(rlhTileBuffer_s *const tiles)
+  {
+    GLD_START();
+    if (tiles->vertex_data_tile_count > tiles->gl_vertex_buffer_tile_capacity)
+    {
+      _rlhTileBufferReleaseStreamFences(tiles);
+      tiles->gl_vertex_buffer_tile_capacity = tiles->vertex_data_tile_capacity;
+      tiles->stream_segment = 0;
+      GLD_CALL(glBufferData(GL_ARRAY_BUFFER, _rlhGetVertexDataSize(tiles->gl_vertex_buffer_tile_capacity * RLH_STREAM_SEGMENT_COUNT), NULL, GL_STREAM_DRAW));
+    }
+    else
+    {
+      tiles->stream_segment = (tiles->stream_segment + 1) % RLH_STREAM_SEGMENT_COUNT;
+      _rlhTileBufferWaitStreamFence(tiles, tiles->stream_segment);
+    }
+    const size_t first_tile = tiles->stream_segment * tiles->gl_vertex_buffer_tile_capacity;
+    void *segment_map = NULL;
+    GLD_CALL(segment_map = glMapBufferRange(
+                 GL_ARRAY_BUFFER,
+                 _rlhGetVertexDataSize(first_tile),
+                 _rlhGetVertexDataSize(tiles->vertex_data_tile_count),
+                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    if (segment_map != NULL)
+    {
+      memcpy(segment_map, tiles->vertex_data, _rlhGetVertexDataSize(tiles->vertex_data_tile_count));
+      GLD_CALL(glUnmapBuffer(GL_ARRAY_BUFFER));
+      tiles->uploaded_byte_count += _rlhGetVertexDataSize(tiles->vertex_data_tile_count);
+    }
+    _rlhTileBufferClearDirtyTiles(tiles);
+    return first_tile;
+  }
+
+  // Make sure that the tiles of this frame are in the vertex buffer. Returns the index of the first
+  // tile in the vertex buffer.
+  static inline size_t _rlhTileBufferStreamVertexData(rlhTileBuffer_s *const tiles)
+  {
+    switch (tiles->stream_mode)
+    {
+    case RLH_STREAM_RING:
+      return _rlhTileBufferStreamRingVertexData(tiles);
+    case RLH_STREAM_PERSISTENT:
+      // the tiles were written directly to the mapped segment when they were pushed.
+      _rlhTileBufferClearDirtyTiles(tiles);
+      tiles->uploaded_byte_count += _rlhGetVertexDataSize(tiles->vertex_data_tile_count);
+      return tiles->stream_segment * tiles->gl_vertex_buffer_tile_capacity;
+    default:
+      _rlhTileBufferUploadVertexData(tiles);
+      return 0;
+    }
+  }
+
+  // Fence the segment that was just drawn from and move on to the next segment. In persistent mode
+  // the tile buffer is moved to the next segment after waiting for its last draw to finish.
+  static inline void _rlhTileBufferEndStreamSegment(rlhTileBuffer_s *const tiles)
+  {
+    if (tiles->stream_mode == RLH_STREAM_ORPHAN)
+      return;
+    GLD_START();
+    GLD_CALL(tiles->gl_stream_fences[tiles->stream_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    if (tiles->stream_mode == RLH_STREAM_PERSISTENT)
+    {
+      tiles->stream_segment = (tiles->stream_segment + 1) % RLH_STREAM_SEGMENT_COUNT;
+      _rlhTileBufferWaitStreamFence(tiles, tiles->stream_segment);
+      tiles->vertex_data = tiles->gl_vertex_buffer_map + tiles->stream_segment * tiles->gl_vertex_buffer_tile_capacity;
+    }
+  }
+
+  // Point the instanced vertex attributes at the tiles of this frame in the vertex buffer.
+  static inline void _rlhTileBufferSetVertexAttributes(rlhTileBuffer_s *const tiles, const size_t first_tile)
+  {
+    if (tiles->gl_vertex_attributes_set && tiles->gl_vertex_attributes_first_tile == first_tile)
+      return;
+    GLD_START();
+    const size_t stride = sizeof(rlhTileInstance_s);
+    const size_t first = _rlhGetVertexDataSize(first_tile);
+    // pixel rect
+    GLD_CALL(glVertexAttribIPointer(0, 4, GL_SHORT, stride, (void *)(first + offsetof(rlhTileInstance_s, pixel_x))));
+    GLD_CALL(glVertexAttribDivisor(0, 1));
+    GLD_CALL(glEnableVertexAttribArray(0));
+    // glyph
+    GLD_CALL(glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, stride, (void *)(first + offsetof(rlhTileInstance_s, glyph))));
+    GLD_CALL(glVertexAttribDivisor(1, 1));
+    GLD_CALL(glEnableVertexAttribArray(1));
+    // forground color
+    GLD_CALL(glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(first + offsetof(rlhTileInstance_s, fg))));
+    GLD_CALL(glVertexAttribDivisor(2, 1));
+    GLD_CALL(glEnableVertexAttribArray(2));
+    // background color
+    GLD_CALL(glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)(first + offsetof(rlhTileInstance_s, bg))));
+    GLD_CALL(glVertexAttribDivisor(3, 1));
+    GLD_CALL(glEnableVertexAttribArray(3));
+    tiles->gl_vertex_attributes_set = RLH_TRUE;
+    tiles->gl_vertex_attributes_first_tile = first_tile;
+  }
+
+  static inline void _rlhTileBufferSetDirtyTileBits(rlhTileBuffer_s *const tiles, const size_t begin, const size_t end)
+  {
+    for (size_t tile_i = begin; tile_i < end;)
+    {
+      if (tile_i % 64 == 0 && end - tile_i >= 64)
+      {
+        tiles->dirty_tile_bits[tile_i / 64] = UINT64_MAX;
+        tile_i += 64;
+        continue;
+      }
+      tiles->dirty_tile_bits[tile_i / 64] |= (uint64_t)1 << (tile_i % 64);
+      tile_i++;
+    }
+  }
+
+  // Make room in the dirty tile bitmap for every tile the tile buffer has room for, and end. The new bits are clear.
+  static inline rlhbool_t _rlhTileBufferTryReserveDirtyTileBits(rlhTileBuffer_s *const tiles, const size_t end)
+  {
+    const size_t bit_capacity = MAX(tiles->vertex_data_tile_capacity, end);
+    if (bit_capacity <= tiles->dirty_tile_bit_capacity)
+      return RLH_TRUE;
+    const size_t old_word_count = _rlhGetDirtyTileWordCount(tiles->dirty_tile_bit_capacity);
+    const size_t new_word_count = _rlhGetDirtyTileWordCount(bit_capacity);
+    uint64_t *const dirty_tile_bits = (uint64_t *)_rlhReallocate(tiles->allocator, tiles->dirty_tile_bits, new_word_count * sizeof(uint64_t));
+    if (dirty_tile_bits == NULL)
+      return RLH_FALSE;
+    memset(dirty_tile_bits + old_word_count, 0, (new_word_count - old_word_count) * sizeof(uint64_t));
+    tiles->dirty_tile_bits = dirty_tile_bits;
+    tiles->dirty_tile_bit_capacity = bit_capacity;
+    return RLH_TRUE;
+  }
+
+  // Add a range of tiles to the ranges that must be uploaded before the next draw. Ranges that
+  // touch are merged, and if there are too many ranges every dirty tile is marked in the dirty
+  // tile bitmap instead, so that scattered changes upload about as many bytes as the tiles that
+  // changed. If the bitmap can not be allocated, the new range is merged into the closest one.
+  static inline void _rlhTileBufferMarkTilesDirty(rlhTileBuffer_s *const tiles, const size_t begin, const size_t end)
+  {
+    if (tiles->dirty_tile_bits_used)
+    {
+      if (_rlhTileBufferTryReserveDirtyTileBits(tiles, end))
+      {
+        _rlhTileBufferSetDirtyTileBits(tiles, begin, end);
+        return;
+      }
+      // without room for the new tiles, every tile is uploaded.
+      _rlhTileBufferClearDirtyTiles(tiles);
+      tiles->dirty_tile_ranges[0].begin = 0;
+      tiles->dirty_tile_ranges[0].end = MAX(tiles->vertex_data_tile_capacity, end);
+      tiles->dirty_tile_range_count = 1;
+      return;
+    }
+    size_t closest_i = 0;
+    size_t closest_gap = SIZE_MAX;
+    for (size_t range_i = 0; range_i < tiles->dirty_tile_range_count; range_i++)
+    {
+      rlhTileRange_s *const range = &tiles->dirty_tile_ranges[range_i];
+      const size_t gap = (end < range->begin) ? range->begin - end : (begin > range->end) ? begin - range->end : 0;
+      if (gap < closest_gap)
+      {
+        closest_gap = gap;
+        closest_i = range_i;
+      }
+    }
+    if (closest_gap != 0 && tiles->dirty_tile_range_count < RLH_MAX_DIRTY_TILE_RANGES)
+    {
+      tiles->dirty_tile_ranges[tiles->dirty_tile_range_count].begin = begin;
+      tiles->dirty_tile_ranges[tiles->dirty_tile_range_count].end = end;
+      tiles->dirty_tile_range_count++;
+      return;
+    }
+    if (closest_gap != 0 && _rlhTileBufferTryReserveDirtyTileBits(tiles, end))
+    {
+      for (size_t range_i = 0; range_i < tiles->dirty_tile_range_count; range_i++)
+      {
+        const rlhTileRange_s *const range = &tiles->dirty_tile_ranges[range_i];
+        _rlhTileBufferSetDirtyTileBits(tiles, range->begin, MIN(range->end, tiles->dirty_tile_bit_capacity));
+      }
+      _rlhTileBufferSetDirtyTileBits(tiles, begin, end);
+      tiles->dirty_tile_range_count = 0;
+      tiles->dirty_tile_bits_used = RLH_TRUE;
+      return;
+    }
+    rlhTileRange_s *const closest = &tiles->dirty_tile_ranges[closest_i];
+    if (begin < closest->begin)
+      closest->begin = begin;
+    if (end > closest->end)
+      closest->end = end;
+  }
+
+  // Scale the position and size of a tile coordinate from one tile size to another.
+  static inline int16_t _rlhRescaleTileCoordinate(const int16_t value, const size_t new_size, const size_t old_size)
+  {
+    const int64_t scaled = (int64_t)value * (int64_t)new_size / (int64_t)old_size;
+    return (int16_t)((scaled < INT16_MIN) ? INT16_MIN : (scaled > INT16_MAX) ? INT16_MAX : scaled);
+  }
+
+  // Scale the tiles of a tile buffer from the old tile size of a terminal to the new one.
+  static inline void _rlhTileBufferRescaleTiles(rlhTileBuffer_s *const tiles, const size_t old_tile_width, const size_t old_tile_height,
+                                                const size_t new_tile_width, const size_t new_tile_height)
+  {
+    // persistent mapped memory is write only, so its tiles are pushed again instead.
+    if (tiles->stream_mode == RLH_STREAM_PERSISTENT || tiles->vertex_data_tile_count == 0)
+      return;
+    for (size_t tile_i = 0; tile_i < tiles->vertex_data_tile_count; tile_i++)
+    {
+      rlhTileInstance_s *const tile = &tiles->vertex_data[tile_i];
+      tile->pixel_x = _rlhRescaleTileCoordinate(tile->pixel_x, new_tile_width, old_tile_width);
+      tile->pixel_y = _rlhRescaleTileCoordinate(tile->pixel_y, new_tile_height, old_tile_height);
+      tile->pixel_w = _rlhRescaleTileCoordinate(tile->pixel_w, new_tile_width, old_tile_width);
+      tile->pixel_h = _rlhRescaleTileCoordinate(tile->pixel_h, new_tile_height, old_tile_height);
+    }
+    _rlhTileBufferMarkTilesDirty(tiles, 0, tiles->vertex_data_tile_count);
+  }
+
+  // Make room in the tile buffers of a terminal for its tile count after a resize from old_cell_count
+  // cells, in proportion to the tiles they held before, or before they were last cleared. Buffers are
+  // not shrunk here, so that is left to the shrink policy.
+  static inline rlhresult_t _rlhTermReserveResizedLayers(rlhTerm_h const term, const size_t old_cell_count)
+  {
+    const size_t new_cell_count = term->tiles_wide * term->tiles_tall;
+    if (old_cell_count == 0 || new_cell_count <= old_cell_count)
+    {
+      return RLH_RESULT_OK;
+    }
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+    {
+      rlhTileBuffer_s *const tiles = &term->layers[layer_i].tiles;
+      // the mapped buffer of a persistent stream is remade when it grows, which would drop its tiles.
+      if (tiles->stream_mode == RLH_STREAM_PERSISTENT)
+        continue;
+      const size_t old_capacity = tiles->vertex_data_tile_capacity;
+      const size_t held_tile_count = MAX(tiles->vertex_data_tile_count, tiles->cleared_tile_count);
+      const size_t needed_capacity = (size_t)((uint64_t)held_tile_count * new_cell_count / old_cell_count);
+      if (needed_capacity <= old_capacity)
+        continue;
+      if (!_rlhTileBufferTrySetCapacity(tiles, needed_capacity + needed_capacity / RLH_RESIZE_HEADROOM_DIVISOR))
+      {
+        return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+      }
+      _rlhTermCountTileBufferGrowth(term, tiles, old_capacity);
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermResize(rlhTerm_h const term, rlhTermSizeInfo_t *const size_info, const rlhbool_t rescale_tiles)
+  {
+    if (term == NULL || size_info == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhresult_t result = _rlhSizeInfoCheck(size_info);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    const size_t old_cell_count = term->tiles_wide * term->tiles_tall;
+    const size_t old_tile_width = term->tile_width;
+    const size_t old_tile_height = term->tile_height;
+    _rlhTermSetPixelSize(
+        term,
+        size_info);
+    term->render_cache_stale = RLH_TRUE;
+    if (rescale_tiles && old_tile_width != 0 && old_tile_height != 0 &&
+        (old_tile_width != term->tile_width || old_tile_height != term->tile_height))
+    {
+      for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+      {
+        _rlhTileBufferRescaleTiles(&term->layers[layer_i].tiles, old_tile_width, old_tile_height, term->tile_width, term->tile_height);
+      }
+      term->camera_x = (int)((int64_t)term->camera_x * (int64_t)term->tile_width / (int64_t)old_tile_width);
+      term->camera_y = (int)((int64_t)term->camera_y * (int64_t)term->tile_height / (int64_t)old_tile_height);
+    }
+    result = _rlhTermReserveResizedLayers(term, old_cell_count);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    if (term->grid_mode)
+    {
+      return _rlhTermResizeGrid(term);
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetSize(rlhTerm_h const term, rlhTermSizeInfo_t *const size_info)
+  {
+    return rlhTermResize(term, size_info, RLH_FALSE);
+  }
+
+  // Shrink a tile buffer to room for tile_capacity tiles, but never less than the tiles it holds. The
+  // vertex buffer is replaced as well, so the tiles are uploaded again on the next draw.
+  static inline rlhbool_t _rlhTileBufferTryShrink(rlhTileBuffer_s *const tiles, const size_t tile_capacity)
+  {
+    const size_t new_capacity = MAX(tile_capacity, MAX(tiles->vertex_data_tile_count, RLH_MIN_TILE_CAPACITY));
+    if (new_capacity >= tiles->vertex_data_tile_capacity)
+      return RLH_TRUE;
+    if (!_rlhTileBufferTrySetCapacity(tiles, new_capacity))
+      return RLH_FALSE;
+    // the persistent vertex buffer was already replaced with one of the new size.
+    if (tiles->stream_mode == RLH_STREAM_PERSISTENT)
+      return RLH_TRUE;
+    if (tiles->gl_vertex_buffer != GL_NONE)
+    {
+      _rlhTileBufferReplaceVertexBuffer(tiles);
+      tiles->stream_segment = 0;
+    }
+    if (tiles->vertex_data_tile_count > 0)
+    {
+      _rlhTileBufferMarkTilesDirty(tiles, 0, tiles->vertex_data_tile_count);
+    }
+    return RLH_TRUE;
+  }
+
+  // Shrink the tile buffers of a terminal that had room for more than twice as many tiles as they held
+  // at most over the last shrink_window_draws draws, then start a new window.
+  static inline void _rlhTermApplyShrinkPolicy(rlhTerm_h const term)
+  {
+    if (term->shrink_window_draws == 0)
+      return;
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+    {
+      rlhTileBuffer_s *const tiles = &term->layers[layer_i].tiles;
+      tiles->window_peak_tile_count = MAX(tiles->window_peak_tile_count, tiles->vertex_data_tile_count);
+    }
+    term->shrink_window_draw_count++;
+    if (term->shrink_window_draw_count < term->shrink_window_draws)
+      return;
+    term->shrink_window_draw_count = 0;
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+    {
+      rlhTileBuffer_s *const tiles = &term->layers[layer_i].tiles;
+      if (tiles->vertex_data_tile_capacity > tiles->window_peak_tile_count * 2)
+      {
+        _rlhTileBufferTryShrink(tiles, tiles->window_peak_tile_count);
+      }
+      tiles->window_peak_tile_count = 0;
+    }
+  }
+
+  rlhresult_t rlhTermReserveTiles(rlhTerm_h const term, const int tile_count)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (tile_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    rlhTileBuffer_s *const tiles = term->tiles;
+    if ((size_t)tile_count <= tiles->vertex_data_tile_capacity)
+    {
+      return RLH_RESULT_OK;
+    }
+    const size_t old_capacity = tiles->vertex_data_tile_capacity;
+    if (!_rlhTileBufferTrySetCapacity(tiles, (size_t)tile_count))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    _rlhTermCountTileBufferGrowth(term, tiles, old_capacity);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermShrinkToFit(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhresult_t result = RLH_RESULT_OK;
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+    {
+      if (!_rlhTileBufferTryShrink(&term->layers[layer_i].tiles, 0))
+      {
+        result = RLH_RESULT_ERROR_OUT_OF_MEMORY;
+      }
+    }
+    return result;
+  }
+
+  rlhresult_t rlhTermSetShrinkPolicy(rlhTerm_h const term, const int window_draws)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (window_draws < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    term->shrink_window_draws = (size_t)window_draws;
+    term->shrink_window_draw_count = 0;
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+    {
+      term->layers[layer_i].tiles.window_peak_tile_count = 0;
+    }
+    return RLH_RESULT_OK;
+  }
+
+  static inline rlhbool_t _rlhTermIsTileVisible(rlhTerm_h const term, const int pixel_x, const int pixel_y,
+                                               const int pixel_w, const int pixel_h)
+  {
+    if (!(
+            pixel_x + pixel_w > 0 &&
+            pixel_x < (int)term->unscaled_pixel_width &&
+            pixel_y + pixel_h > 0 &&
+            pixel_y < (int)term->unscaled_pixel_height))
+    {
+      return RLH_FALSE;
+    }
+    // tile rects are stored with 16 bit pixel coordinates.
+    return pixel_x >= INT16_MIN && pixel_y >= INT16_MIN && pixel_x <= INT16_MAX && pixel_y <= INT16_MAX &&
+           pixel_w <= INT16_MAX && pixel_h <= INT16_MAX;
+  }
+
+  // Write a tile to the end of the tile buffer without any checks. The tile must be visible, and
+  // room for it must already be reserved.
+  static inline void _rlhTileBufferWriteTile(rlhTileBuffer_s *const tiles, const int pixel_x, const int pixel_y,
+                                       const int pixel_w, const int pixel_h, const uint32_t glyph,
+                                       const uint8_t *const fg, const uint8_t *const bg)
+  {
+    rlhTileInstance_s *const tile = tiles->vertex_data + tiles->vertex_data_tile_count;
+    tile->pixel_x = (int16_t)pixel_x;
+    tile->pixel_y = (int16_t)pixel_y;
+    tile->pixel_w = (int16_t)pixel_w;
+    tile->pixel_h = (int16_t)pixel_h;
+    tile->glyph = glyph;
+    memcpy(tile->fg, fg, sizeof(tile->fg));
+    memcpy(tile->bg, bg, sizeof(tile->bg));
+    tiles->vertex_data_tile_count++;
+  }
+
+  // Push a tile with colors that are already packed, or palette indices when glyph_flags has index bits set.
+  static inline void _rlhTermPushPackedTile(rlhTerm_h const term, const int pixel_x, const int pixel_y,
+                                            const int pixel_w, const int pixel_h, const uint16_t glyph,
+                                            const uint32_t glyph_flags, const uint8_t *const fg, const uint8_t *const bg)
+  {
+    if (glyph >= _rlhTermGetPushGlyphCount(term))
+    {
+      term->stats.tiles_rejected++;
+      return;
+    }
+    if (!_rlhTermIsTileVisible(term, pixel_x, pixel_y, pixel_w, pixel_h))
+    {
+      term->stats.tiles_culled++;
+      return;
+    }
+    term->stats.tiles_pushed++;
+    _rlhTileBufferMarkTilesDirty(term->tiles, term->tiles->vertex_data_tile_count, term->tiles->vertex_data_tile_count + 1);
+    _rlhTileBufferWriteTile(term->tiles, pixel_x, pixel_y, pixel_w, pixel_h, glyph | glyph_flags | term->push_glyph_bits, fg, bg);
+  }
+
+  static inline void _rlhTermPushTile(rlhTerm_h const term, const int pixel_x, const int pixel_y,
+                                      const int pixel_w, const int pixel_h, const uint16_t glyph,
+                                      const rlhColor_s fg, const rlhColor_s bg)
+  {
+    uint8_t packed[8];
+    _rlhPackColorPair(fg, bg, packed);
+    _rlhTermPushPackedTile(term, pixel_x, pixel_y, pixel_w, pixel_h, glyph, 0, packed, packed + 4);
+  }
+
+  // Split packed colors into the bytes of a tile, red first.
+  static inline void _rlhUnpackColorPair(const uint32_t fg, const uint32_t bg, uint8_t *const packed)
+  {
+    for (size_t channel_i = 0; channel_i < 4; channel_i++)
+    {
+      packed[channel_i] = (uint8_t)(fg >> (channel_i * 8));
+      packed[channel_i + 4] = (uint8_t)(bg >> (channel_i * 8));
+    }
+  }
+
+  // Write palette indices in the first byte of the colors of a tile.
+  static inline void _rlhIndexColorPair(const uint8_t fg_index, const uint8_t bg_index, uint8_t *const packed)
+  {
+    memset(packed, 0, 8);
+    packed[0] = fg_index;
+    packed[4] = bg_index;
+  }
+
+  // Get the colors of a tile, with its palette indices looked up in the palette of a terminal.
+  static inline void _rlhTermGetTileColors(rlhTerm_h const term, const rlhTileInstance_s *const tile,
+                                           uint8_t *const fg, uint8_t *const bg)
+  {
+    memcpy(fg, (tile->glyph & RLH_TILE_FG_INDEXED) ? term->palette + tile->fg[0] * 4 : tile->fg, 4);
+    memcpy(bg, (tile->glyph & RLH_TILE_BG_INDEXED) ? term->palette + tile->bg[0] * 4 : tile->bg, 4);
+  }
+
+  // Clip a row of glyph_count grid cells starting at grid_x and grid_y to the cells that are at least
+  // partially inside of the terminal. Returns the index of the first visible cell of the row, and sets
+  // visible_end to one past the index of the last visible cell.
+  static inline int _rlhTermClipGridSpan(rlhTerm_h const term, const int grid_x, const int grid_y,
+                                         const int glyph_count, int *const visible_end)
+  {
+    // cells that start past the 16 bit pixel limit are culled too.
+    const int visible_wide = MIN(((int)term->unscaled_pixel_width + (int)term->tile_width - 1) / (int)term->tile_width,
+                                 INT16_MAX / (int)term->tile_width + 1);
+    const int visible_tall = MIN(((int)term->unscaled_pixel_height + (int)term->tile_height - 1) / (int)term->tile_height,
+                                 INT16_MAX / (int)term->tile_height + 1);
+    *visible_end = 0;
+    if (grid_y < 0 || grid_y >= visible_tall || glyph_count <= 0)
+    {
+      return 0;
+    }
+    const int begin = (grid_x < 0) ? -grid_x : 0;
+    const int end = (grid_x + glyph_count > visible_wide) ? visible_wide - grid_x : glyph_count;
+    if (begin >= end)
+    {
+      return 0;
+    }
+    *visible_end = end;
+    return begin;
+  }
+
+  // Push the visible part of a row of grid tiles. When fgs and bgs are NULL the shared packed colors
+  // are used for every tile.
+  static inline rlhresult_t _rlhTermPushGridSpan(rlhTerm_h const term, const int grid_x, const int grid_y,
+                                                 const rlhglyph_t *const glyphs, const rlhColor_s *const fgs,
+                                                 const rlhColor_s *const bgs, const uint8_t *const shared_fg,
+                                                 const uint8_t *const shared_bg, const uint32_t glyph_flags,
+                                                 const int glyph_count)
+  {
+    int end;
+    const int begin = _rlhTermClipGridSpan(term, grid_x, grid_y, glyph_count, &end);
+    if (begin >= end)
+    {
+      term->stats.tiles_culled += glyph_count;
+      return RLH_RESULT_OK;
+    }
+    if (!_rlhTermTryReserveTiles(term, end - begin))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    term->stats.tiles_culled += glyph_count - (end - begin);
+    const size_t first_tile = term->tiles->vertex_data_tile_count;
+    const int tile_width = (int)term->tile_width;
+    const int tile_height = (int)term->tile_height;
+    const int pixel_y = grid_y * tile_height;
+    const size_t term_glyph_count = _rlhTermGetPushGlyphCount(term);
+    const uint32_t tile_flags = glyph_flags | term->push_glyph_bits;
+    uint8_t packed[8];
+    for (int glyph_i = begin; glyph_i < end; glyph_i++)
+    {
+      const rlhglyph_t glyph = glyphs[glyph_i];
+      if (glyph >= term_glyph_count)
+      {
+        term->stats.tiles_rejected++;
+        continue;
+      }
+      if (fgs != NULL)
+      {
+        _rlhPackColorPair(fgs[glyph_i], bgs[glyph_i], packed);
+      }
+      _rlhTileBufferWriteTile(term->tiles, (grid_x + glyph_i) * tile_width, pixel_y, tile_width, tile_height, glyph | tile_flags,
+                        (fgs != NULL) ? packed : shared_fg, (fgs != NULL) ? packed + 4 : shared_bg);
+    }
+    if (term->tiles->vertex_data_tile_count > first_tile)
+    {
+      term->stats.tiles_pushed += term->tiles->vertex_data_tile_count - first_tile;
+      _rlhTileBufferMarkTilesDirty(term->tiles, first_tile, term->tiles->vertex_data_tile_count);
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushFill(rlhTerm_h const term, const uint16_t glyph, const rlhColor_s fg,
+                              const rlhColor_s bg)
+  {
+    if (!_rlhTermTryReserveVertexData(term))
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    _rlhTermPushTile(term, 0, 0, term->unscaled_pixel_width, term->unscaled_pixel_height, glyph, fg, bg);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushGrid(rlhTerm_h const term, const int grid_x, const int grid_y,
+                              const uint16_t glyph, const rlhColor_s fg,
+                              const rlhColor_s bg)
+  {
+    const int pixel_x = grid_x * (int)term->tile_width;
+    const int pixel_y = grid_y * (int)term->tile_height;
+    if (!_rlhTermTryReserveVertexData(term))
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    _rlhTermPushTile(term, pixel_x, pixel_y, term->tile_width, term->tile_height, glyph, fg, bg);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushGridSized(rlhTerm_h const term, const int grid_x, const int grid_y,
+                                   const int tile_pixel_width, const int tile_pixel_height,
+                                   const uint16_t glyph, const rlhColor_s fg,
+                                   const rlhColor_s bg)
+  {
+    if (!_rlhTermTryReserveVertexData(term))
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    const int pixel_x = grid_x * (int)term->tile_width;
+    const int pixel_y = grid_y * (int)term->tile_height;
+    _rlhTermPushTile(term, pixel_x, pixel_y, tile_pixel_width, tile_pixel_height, glyph, fg, bg);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushFree(rlhTerm_h const term, const int screen_pixel_x,
+                              const int screen_pixel_y, const uint16_t glyph,
+                              const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (!_rlhTermTryReserveVertexData(term))
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    _rlhTermPushTile(term, screen_pixel_x, screen_pixel_y, term->tile_width, term->tile_height, glyph, fg, bg);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushFreeSized(rlhTerm_h const term, const int screen_pixel_x,
+                                   const int screen_pixel_y, const int tile_pixel_width,
+                                   const int tile_pixel_height, const uint16_t glyph,
+                                   const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (!_rlhTermTryReserveVertexData(term))
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    _rlhTermPushTile(term, screen_pixel_x, screen_pixel_y, tile_pixel_width, tile_pixel_height,
+                     glyph, fg, bg);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushGridSpan(rlhTerm_h const term, const int grid_x, const int grid_y,
+                                  const rlhglyph_t *const glyphs, const int glyph_count,
+                                  const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (term == NULL || glyphs == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (glyph_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    uint8_t packed[8];
+    _rlhPackColorPair(fg, bg, packed);
+    return _rlhTermPushGridSpan(term, grid_x, grid_y, glyphs, NULL, NULL, packed, packed + 4, 0, glyph_count);
+  }
+
+  rlhresult_t rlhTermPushGridSpanColored(rlhTerm_h const term, const int grid_x, const int grid_y,
+                                         const rlhglyph_t *const glyphs, const rlhColor_s *const fgs,
+                                         const rlhColor_s *const bgs, const int glyph_count)
+  {
+    if (term == NULL || glyphs == NULL || fgs == NULL || bgs == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (glyph_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    return _rlhTermPushGridSpan(term, grid_x, grid_y, glyphs, fgs, bgs, NULL, NULL, 0, glyph_count);
+  }
+
+  rlhresult_t rlhTermPushGridArray(rlhTerm_h const term, const rlhGridTile_s *const tiles, const int tile_count)
+  {
+    if (term == NULL || tiles == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (tile_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    if (!_rlhTermTryReserveTiles(term, tile_count))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    const size_t first_tile = term->tiles->vertex_data_tile_count;
+    const int tile_width = (int)term->tile_width;
+    const int tile_height = (int)term->tile_height;
+    const size_t term_glyph_count = _rlhTermGetPushGlyphCount(term);
+    uint8_t packed[8];
+    for (int tile_i = 0; tile_i < tile_count; tile_i++)
+    {
+      const rlhGridTile_s *const tile = &tiles[tile_i];
+      const int pixel_x = tile->grid_x * tile_width;
+      const int pixel_y = tile->grid_y * tile_height;
+      if (tile->glyph >= term_glyph_count)
+      {
+        term->stats.tiles_rejected++;
+        continue;
+      }
+      if (!_rlhTermIsTileVisible(term, pixel_x, pixel_y, tile_width, tile_height))
+      {
+        term->stats.tiles_culled++;
+        continue;
+      }
+      _rlhPackColorPair(tile->fg, tile->bg, packed);
+      _rlhTileBufferWriteTile(term->tiles, pixel_x, pixel_y, tile_width, tile_height, tile->glyph | term->push_glyph_bits, packed, packed + 4);
+    }
+    if (term->tiles->vertex_data_tile_count > first_tile)
+    {
+      term->stats.tiles_pushed += term->tiles->vertex_data_tile_count - first_tile;
+      _rlhTileBufferMarkTilesDirty(term->tiles, first_tile, term->tiles->vertex_data_tile_count);
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermBeginTileWrite(rlhTerm_h const term, const int tile_count, rlhTileWrite_t *const write)
+  {
+    if (term == NULL || write == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (tile_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    if (!_rlhTermTryReserveTiles(term, tile_count))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    write->tiles = term->tiles->vertex_data + term->tiles->vertex_data_tile_count;
+    write->glyph_count = (int)_rlhTermGetPushGlyphCount(term);
+    write->glyph_bits = term->push_glyph_bits;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermEndTileWrite(rlhTerm_h const term, const int tile_count, const int rejected_count)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhTileBuffer_s *const tiles = term->tiles;
+    if (tile_count < 0 || rejected_count < 0 || (size_t)tile_count > tiles->vertex_data_tile_capacity - tiles->vertex_data_tile_count)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    term->stats.tiles_rejected += (uint64_t)rejected_count;
+    if (tile_count == 0)
+    {
+      return RLH_RESULT_OK;
+    }
+    term->stats.tiles_pushed += (uint64_t)tile_count;
+    _rlhTileBufferMarkTilesDirty(tiles, tiles->vertex_data_tile_count, tiles->vertex_data_tile_count + (size_t)tile_count);
+    tiles->vertex_data_tile_count += (size_t)tile_count;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushString(rlhTerm_h const term, const int grid_x, const int grid_y,
+                                const char *const string, const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (term == NULL || string == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    const size_t length = strlen(string);
+    int end;
+    const int begin = _rlhTermClipGridSpan(term, grid_x, grid_y, (int)length, &end);
+    if (begin >= end)
+    {
+      term->stats.tiles_culled += length;
+      return RLH_RESULT_OK;
+    }
+    if (!_rlhTermTryReserveTiles(term, end - begin))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    term->stats.tiles_culled += length - (end - begin);
+    const size_t first_tile = term->tiles->vertex_data_tile_count;
+    const int tile_width = (int)term->tile_width;
+    const int tile_height = (int)term->tile_height;
+    const int pixel_y = grid_y * tile_height;
+    const size_t term_glyph_count = _rlhTermGetPushGlyphCount(term);
+    uint8_t packed[8];
+    _rlhPackColorPair(fg, bg, packed);
+    for (int char_i = begin; char_i < end; char_i++)
+    {
+      const rlhglyph_t glyph = (unsigned char)string[char_i];
+      if (glyph >= term_glyph_count)
+      {
+        term->stats.tiles_rejected++;
+        continue;
+      }
+      _rlhTileBufferWriteTile(term->tiles, (grid_x + char_i) * tile_width, pixel_y, tile_width, tile_height, glyph | term->push_glyph_bits, packed, packed + 4);
+    }
+    if (term->tiles->vertex_data_tile_count > first_tile)
+    {
+      term->stats.tiles_pushed += term->tiles->vertex_data_tile_count - first_tile;
+      _rlhTileBufferMarkTilesDirty(term->tiles, first_tile, term->tiles->vertex_data_tile_count);
+    }
+    return RLH_RESULT_OK;
+  }
+
+  uint32_t rlhPackColor(const rlhColor_s color)
+  {
+    uint8_t packed[4];
+    _rlhPackColor(color, packed);
+    return RLH_COLOR32(packed[0], packed[1], packed[2], packed[3]);
+  }
+
+  rlhresult_t rlhTermPushGridPacked(rlhTerm_h const term, const int grid_x, const int grid_y,
+                                    const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg)
+  {
+    if (!_rlhTermTryReserveVertexData(term))
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    uint8_t packed[8];
+    _rlhUnpackColorPair(fg, bg, packed);
+    _rlhTermPushPackedTile(term, grid_x * (int)term->tile_width, grid_y * (int)term->tile_height, term->tile_width,
+                           term->tile_height, glyph, 0, packed, packed + 4);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushFreePacked(rlhTerm_h const term, const int screen_pixel_x, const int screen_pixel_y,
+                                    const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg)
+  {
+    if (!_rlhTermTryReserveVertexData(term))
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    uint8_t packed[8];
+    _rlhUnpackColorPair(fg, bg, packed);
+    _rlhTermPushPackedTile(term, screen_pixel_x, screen_pixel_y, term->tile_width, term->tile_height, glyph, 0,
+                           packed, packed + 4);
+    return RLH_RESULT_OK;
+  }
+
+  // Set a range of palette colors of a terminal or the snapshot of a command list.
+  static inline rlhresult_t _rlhTermSetPaletteColors(rlhTerm_h const term, const int first_index,
+                                                     const uint32_t *const colors, const int color_count)
+  {
+    if (colors == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (first_index < 0 || color_count < 0 || first_index + color_count > RLH_PALETTE_COLOR_COUNT)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    for (int color_i = 0; color_i < color_count; color_i++)
+    {
+      uint8_t packed[8];
+      _rlhUnpackColorPair(colors[color_i], 0, packed);
+      memcpy(term->palette + (size_t)(first_index + color_i) * 4, packed, 4);
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetPalette(rlhTerm_h const term, const int first_index, const uint32_t *const colors,
+                                const int color_count)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhresult_t result = _rlhTermSetPaletteColors(term, first_index, colors, color_count);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    term->palette_changed = RLH_TRUE;
+    // the tiles that use the palette do not change, so the render cache can not see this by itself.
+    term->render_cache_stale = RLH_TRUE;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetLightMap(rlhTerm_h const term, const uint8_t *const light, const uint8_t *const visible,
+                                 const uint8_t *const explored)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    const size_t cell_count = term->tiles_wide * term->tiles_tall;
+    if (cell_count == 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    if (cell_count > term->light_map_capacity)
+    {
+      uint8_t *new_light_map = (uint8_t *)_rlhReallocate(&term->allocator, term->light_map, cell_count * 4);
+      if (new_light_map == NULL)
+      {
+        return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+      }
+      term->light_map = new_light_map;
+      term->light_map_capacity = cell_count;
+    }
+    for (size_t cell_i = 0; cell_i < cell_count; cell_i++)
+    {
+      uint8_t *const texel = term->light_map + cell_i * 4;
+      if (light != NULL)
+      {
+        memcpy(texel, light + cell_i * 3, 3);
+      }
+      else
+      {
+        memset(texel, 255, 3);
+      }
+      texel[3] = (visible == NULL || visible[cell_i] != 0) ? 255 : (explored != NULL && explored[cell_i] != 0) ? 128 : 0;
+    }
+    if (term->light_map_wide != term->tiles_wide || term->light_map_tall != term->tiles_tall)
+    {
+      term->light_map_wide = term->tiles_wide;
+      term->light_map_tall = term->tiles_tall;
+      term->light_map_resized = RLH_TRUE;
+    }
+    term->light_map_changed = RLH_TRUE;
+    term->render_cache_stale = RLH_TRUE;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermClearLightMap(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (_rlhTermHasLightMap(term))
+    {
+      _rlhTermDestroyLightMap(term);
+      term->render_cache_stale = RLH_TRUE;
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetLightMapSmooth(rlhTerm_h const term, const rlhbool_t smooth)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    term->light_map_smooth = smooth;
+    term->render_cache_stale = RLH_TRUE;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetExploredLight(rlhTerm_h const term, const rlhColor_s light)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    term->explored_light[0] = light.r;
+    term->explored_light[1] = light.g;
+    term->explored_light[2] = light.b;
+    term->render_cache_stale = RLH_TRUE;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushGridIndexed(rlhTerm_h const term, const int grid_x, const int grid_y,
+                                     const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index)
+  {
+    if (!_rlhTermTryReserveVertexData(term))
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    uint8_t packed[8];
+    _rlhIndexColorPair(fg_index, bg_index, packed);
+    _rlhTermPushPackedTile(term, grid_x * (int)term->tile_width, grid_y * (int)term->tile_height, term->tile_width,
+                           term->tile_height, glyph, RLH_TILE_FG_INDEXED | RLH_TILE_BG_INDEXED, packed, packed + 4);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushFreeIndexed(rlhTerm_h const term, const int screen_pixel_x, const int screen_pixel_y,
+                                     const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index)
+  {
+    if (!_rlhTermTryReserveVertexData(term))
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    uint8_t packed[8];
+    _rlhIndexColorPair(fg_index, bg_index, packed);
+    _rlhTermPushPackedTile(term, screen_pixel_x, screen_pixel_y, term->tile_width, term->tile_height, glyph,
+                           RLH_TILE_FG_INDEXED | RLH_TILE_BG_INDEXED, packed, packed + 4);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushGridSpanIndexed(rlhTerm_h const term, const int grid_x, const int grid_y,
+                                         const rlhglyph_t *const glyphs, const int glyph_count,
+                                         const uint8_t fg_index, const uint8_t bg_index)
+  {
+    if (term == NULL || glyphs == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (glyph_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    uint8_t packed[8];
+    _rlhIndexColorPair(fg_index, bg_index, packed);
+    return _rlhTermPushGridSpan(term, grid_x, grid_y, glyphs, NULL, NULL, packed, packed + 4,
+                                RLH_TILE_FG_INDEXED | RLH_TILE_BG_INDEXED, glyph_count);
+  }
+
+  rlhresult_t rlhTermSetTile(rlhTerm_h const term, const int tile_index, const rlhglyph_t glyph,
+                             const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    // the tile is read to keep its position, size, and atlas, and the persistent stream mode writes tiles to
+    // mapped memory that is too slow to read back.
+    if (term->tiles->stream_mode == RLH_STREAM_PERSISTENT)
+    {
+      return RLH_RESULT_ERROR_UNSUPPORTED;
+    }
+    if (tile_index < 0 || (size_t)tile_index >= term->tiles->vertex_data_tile_count)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    rlhTileInstance_s *const tile = term->tiles->vertex_data + tile_index;
+    // the tile keeps its atlas, so the glyph is checked against the glyph count of that atlas.
+    if (glyph >= _rlhTermGetAtlasGlyphCount(term, (tile->glyph & RLH_TILE_ATLAS_MASK) >> RLH_TILE_ATLAS_SHIFT))
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    uint8_t packed[8];
+    _rlhPackColorPair(fg, bg, packed);
+    tile->glyph = glyph | (tile->glyph & (RLH_TILE_EFFECT_MASK | RLH_TILE_ATLAS_MASK));
+    memcpy(tile->fg, packed, sizeof(tile->fg));
+    memcpy(tile->bg, packed + 4, sizeof(tile->bg));
+    _rlhTileBufferMarkTilesDirty(term->tiles, tile_index, tile_index + 1);
+    return RLH_RESULT_OK;
+  }
+
+  static inline rlhbool_t _rlhIsEffectIndex(const int effect)
+  {
+    return effect >= 0 && effect < RLH_MAX_TILE_EFFECTS;
+  }
+
+  rlhresult_t rlhTermSetEffect(rlhTerm_h const term, const int effect, const rlhTileEffect_t *const effect_info)
+  {
+    if (term == NULL || effect_info == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (
+        effect <= 0 || effect >= RLH_MAX_TILE_EFFECTS ||
+        effect_info->type < RLH_EFFECT_NONE || effect_info->type >= RLH_EFFECT_TYPE_COUNT ||
+        (effect_info->targets & ~RLH_EFFECT_TARGET_BOTH) != 0 ||
+        (effect_info->type != RLH_EFFECT_NONE && !(effect_info->period > 0.0f)))
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    float *const data = term->effect_data + (size_t)effect * RLH_FLOATS_PER_EFFECT;
+    if (effect_info->type == RLH_EFFECT_NONE)
+    {
+      memset(data, 0, RLH_FLOATS_PER_EFFECT * sizeof(float));
+    }
+    else
+    {
+      data[0] = (float)(effect_info->type * 4 + effect_info->targets);
+      data[1] = 1.0f / effect_info->period;
+      data[2] = -effect_info->start_time / effect_info->period;
+      data[3] = effect_info->phase_per_tile;
+      data[4] = effect_info->color.r;
+      data[5] = effect_info->color.g;
+      data[6] = effect_info->color.b;
+      data[7] = effect_info->color.a;
+    }
+    term->effects_changed = RLH_TRUE;
+    // like the palette, the tiles that use the effect do not change.
+    term->render_cache_stale = RLH_TRUE;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetEffectTime(rlhTerm_h const term, const float seconds)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    term->effect_time = seconds;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetPushEffect(rlhTerm_h const term, const int effect)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (!_rlhIsEffectIndex(effect))
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    term->push_glyph_bits = (term->push_glyph_bits & ~RLH_TILE_EFFECT_MASK) | ((uint32_t)effect << RLH_TILE_EFFECT_SHIFT);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetTileEffect(rlhTerm_h const term, const int tile_index, const int effect)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    // like rlhTermSetTile(), the glyph of the tile is read back.
+    if (term->tiles->stream_mode == RLH_STREAM_PERSISTENT)
+    {
+      return RLH_RESULT_ERROR_UNSUPPORTED;
+    }
+    if (tile_index < 0 || (size_t)tile_index >= term->tiles->vertex_data_tile_count || !_rlhIsEffectIndex(effect))
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    rlhTileInstance_s *const tile = term->tiles->vertex_data + tile_index;
+    tile->glyph = (tile->glyph & ~RLH_TILE_EFFECT_MASK) | ((uint32_t)effect << RLH_TILE_EFFECT_SHIFT);
+    _rlhTileBufferMarkTilesDirty(term->tiles, tile_index, tile_index + 1);
+    return RLH_RESULT_OK;
+  }
+
+  // Apply the effect of a tile to its colors on the CPU, the same way as the vertex shaders do.
+  static inline void _rlhTermApplyTileEffect(rlhTerm_h const term, const rlhTileInstance_s *const tile,
+                                             float *const fg, float *const bg)
+  {
+    const size_t effect = (tile->glyph & RLH_TILE_EFFECT_MASK) >> RLH_TILE_EFFECT_SHIFT;
+    if (effect == 0)
+      return;
+    const float *const data = term->effect_data + effect * RLH_FLOATS_PER_EFFECT;
+    const float cell_x = floorf((float)tile->pixel_x / (float)term->tile_width);
+    const float cell_y = floorf((float)tile->pixel_y / (float)term->tile_height);
+    const float phase = term->effect_time * data[1] + data[2] + (cell_x + cell_y) * data[3];
+    const int code = (int)data[0];
+    const int type = code >> 2;
+    float amount;
+    if (type == RLH_EFFECT_BLINK)
+      amount = (phase - floorf(phase) >= 0.5f) ? 1.0f : 0.0f;
+    else if (type == RLH_EFFECT_CYCLE)
+      amount = 0.5f - 0.5f * cosf(6.2831853f * phase);
+    else
+      amount = (phase < 0.0f) ? 0.0f : (phase > 1.0f) ? 1.0f : phase;
+    for (size_t channel_i = 0; channel_i < 4; channel_i++)
+    {
+      if (code & RLH_EFFECT_TARGET_FG)
+        fg[channel_i] += (data[4 + channel_i] - fg[channel_i]) * amount;
+      if (code & RLH_EFFECT_TARGET_BG)
+        bg[channel_i] += (data[4 + channel_i] - bg[channel_i]) * amount;
+    }
+  }
+
+  static inline void _rlhCmdListTakeSnapshot(rlhCmdList_h const cmd_list, rlhTerm_h const term)
+  {
+    rlhTerm_s *const snapshot = &cmd_list->term;
+    snapshot->unscaled_pixel_width = term->unscaled_pixel_width;
+    snapshot->unscaled_pixel_height = term->unscaled_pixel_height;
+    snapshot->scaled_pixel_width = term->scaled_pixel_width;
+    snapshot->scaled_pixel_height = term->scaled_pixel_height;
+    snapshot->tiles_wide = term->tiles_wide;
+    snapshot->tiles_tall = term->tiles_tall;
+    snapshot->pixel_scale = term->pixel_scale;
+    snapshot->tile_width = term->tile_width;
+    snapshot->tile_height = term->tile_height;
+    snapshot->glyph_count = _rlhTermGetGlyphCount(term);
+    for (size_t atlas_i = 1; atlas_i < RLH_MAX_TERM_ATLASES; atlas_i++)
+    {
+      snapshot->atlas_glyph_counts[atlas_i] = _rlhTermGetAtlasGlyphCount(term, atlas_i);
+    }
+    memcpy(snapshot->palette, term->palette, sizeof(snapshot->palette));
+    memcpy(snapshot->effect_data, term->effect_data, sizeof(snapshot->effect_data));
+    snapshot->effect_time = term->effect_time;
+  }
+
+  static inline rlhCmdList_h _rlhCmdListAllocate(void)
+  {
+    rlhCmdList_h cmd_list_h = (rlhCmdList_h)_rlhAllocate(&_rlh_allocator, sizeof(rlhCmdList_s));
+    if (cmd_list_h == NULL)
+    {
+      return NULL;
+    }
+    memset(cmd_list_h, 0, sizeof(rlhCmdList_s));
+    // command lists are recorded on other threads, so they use the global allocator instead of the
+    // allocator of the terminal.
+    cmd_list_h->term.allocator = _rlh_allocator;
+    cmd_list_h->tiles.allocator = &cmd_list_h->term.allocator;
+    cmd_list_h->term.tiles = &cmd_list_h->tiles;
+    return cmd_list_h;
+  }
+
+  rlhresult_t rlhCmdListCreate(rlhTerm_h const term, rlhCmdList_h *cmd_list)
+  {
+    if (term == NULL || cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhCmdList_h cmd_list_h = _rlhCmdListAllocate();
+    if (cmd_list_h == NULL)
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    _rlhCmdListTakeSnapshot(cmd_list_h, term);
+    *cmd_list = cmd_list_h;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhCmdListCreateHeadless(rlhTermSizeInfo_t *const size_info, const int glyph_count, rlhCmdList_h *cmd_list)
+  {
+    if (size_info == NULL || cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhresult_t result = _rlhSizeInfoCheck(size_info);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    if (glyph_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    rlhCmdList_h cmd_list_h = _rlhCmdListAllocate();
+    if (cmd_list_h == NULL)
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    _rlhTermSetPixelSize(&cmd_list_h->term, size_info);
+    cmd_list_h->term.glyph_count = (size_t)glyph_count;
+    *cmd_list = cmd_list_h;
+    return RLH_RESULT_OK;
+  }
+
+  void rlhCmdListDestroy(rlhCmdList_h const cmd_list)
+  {
+    _rlhCmdListFree(cmd_list);
+  }
+
+  rlhresult_t rlhCmdListReset(rlhCmdList_h const cmd_list, rlhTerm_h const term)
+  {
+    if (cmd_list == NULL || term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    _rlhCmdListTakeSnapshot(cmd_list, term);
+    memset(&cmd_list->term.stats, 0, sizeof(rlhTermStats_t));
+    return rlhTermClearTileData(&cmd_list->term);
+  }
+
+  rlhresult_t rlhCmdListClear(rlhCmdList_h const cmd_list)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    memset(&cmd_list->term.stats, 0, sizeof(rlhTermStats_t));
+    return rlhTermClearTileData(&cmd_list->term);
+  }
+
+  int rlhCmdListGetTileCount(rlhCmdList_h const cmd_list)
+  {
+    if (cmd_list == NULL)
+      return 0;
+    return (int)cmd_list->tiles.vertex_data_tile_count;
+  }
+
+  // Read a channel of an atlas pixel as a value from 0 to 1, like OpenGL reads normalized integers.
+  static inline float _rlhReadAtlasChannel(const uint8_t *const channel, const size_t channel_size)
+  {
+    if (channel_size == 1)
+      return channel[0] / 255.0f;
+    if (channel_size == 2)
+    {
+      uint16_t value;
+      memcpy(&value, channel, sizeof(value));
+      return value / 65535.0f;
+    }
+    uint32_t value;
+    memcpy(&value, channel, sizeof(value));
+    return (float)(value / 4294967295.0);
+  }
+
+  // Read an atlas pixel into the texture color that the fragment shader would sample, and turn it into the
+  // color the foreground is multiplied with and the factor that mixes the background with the foreground.
+  static inline void _rlhReadRasterTexel(const rlhAtlasCreateInfo_t *const atlas_info, const uint8_t *const texel,
+                                          float *const tex_color, float *const mix_factor)
+  {
+    const size_t channel_size = (size_t)atlas_info->channel_size;
+    switch (atlas_info->color)
+    {
+    case RLH_COLOR_G:
+      // the stencil blend ignores the texture color.
+      tex_color[0] = tex_color[1] = tex_color[2] = tex_color[3] = 1.0f;
+      *mix_factor = _rlhReadAtlasChannel(texel, channel_size);
+      return;
+    case RLH_COLOR_GA:
+      tex_color[0] = tex_color[1] = tex_color[2] = _rlhReadAtlasChannel(texel, channel_size);
+      tex_color[3] = 1.0f;
+      *mix_factor = _rlhReadAtlasChannel(texel + channel_size, channel_size);
+      return;
+    case RLH_COLOR_BGRA:
+      tex_color[0] = _rlhReadAtlasChannel(texel + 2 * channel_size, channel_size);
+      tex_color[1] = _rlhReadAtlasChannel(texel + channel_size, channel_size);
+      tex_color[2] = _rlhReadAtlasChannel(texel, channel_size);
+      break;
+    default:
+      tex_color[0] = _rlhReadAtlasChannel(texel, channel_size);
+      tex_color[1] = _rlhReadAtlasChannel(texel + channel_size, channel_size);
+      tex_color[2] = _rlhReadAtlasChannel(texel + 2 * channel_size, channel_size);
+      break;
+    }
+    tex_color[3] = 1.0f;
+    *mix_factor = _rlhReadAtlasChannel(texel + 3 * channel_size, channel_size);
+  }
+
+  // Blend the color of a tile fragment onto a target pixel the way the tile program and the alpha blend
+  // function do. fg and bg are from 0 to 1.
+  static inline void _rlhBlendRasterPixel(const float *const fg, const float *const bg, const float *const tex_color,
+                                          const float mix_factor, uint8_t *const pixel)
+  {
+#if defined(RLH_SIMD_SSE2)
+    const __m128 bg_channels = _mm_loadu_ps(bg);
+    const __m128 fg_channels = _mm_mul_ps(_mm_loadu_ps(fg), _mm_loadu_ps(tex_color));
+    const __m128 source = _mm_add_ps(bg_channels, _mm_mul_ps(_mm_sub_ps(fg_channels, bg_channels), _mm_set1_ps(mix_factor)));
+    const __m128 source_alpha = _mm_shuffle_ps(source, source, _MM_SHUFFLE(3, 3, 3, 3));
+    int32_t pixel_bits;
+    memcpy(&pixel_bits, pixel, sizeof(pixel_bits));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pixel_ints = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel_bits), zero), zero);
+    const __m128 destination = _mm_mul_ps(_mm_cvtepi32_ps(pixel_ints), _mm_set1_ps(1.0f / 255.0f));
+    const __m128 blended = _mm_add_ps(_mm_mul_ps(source, source_alpha),
+                                      _mm_mul_ps(destination, _mm_sub_ps(_mm_set1_ps(1.0f), source_alpha)));
+    const __m128i blended_ints = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(blended, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+    const __m128i shorts = _mm_packs_epi32(blended_ints, blended_ints);
+    pixel_bits = _mm_cvtsi128_si32(_mm_packus_epi16(shorts, shorts));
+    memcpy(pixel, &pixel_bits, sizeof(pixel_bits));
+#elif defined(RLH_SIMD_NEON) && defined(RLH_RASTER_NEON)
+    // Not verified on ARM yet, so it is opt in.
+    const float32x4_t bg_channels = vld1q_f32(bg);
+    const float32x4_t fg_channels = vmulq_f32(vld1q_f32(fg), vld1q_f32(tex_color));
+    const float32x4_t source = vaddq_f32(bg_channels, vmulq_f32(vsubq_f32(fg_channels, bg_channels), vdupq_n_f32(mix_factor)));
+    const float32x4_t source_alpha = vdupq_n_f32(vgetq_lane_f32(source, 3));
+    uint32_t pixel_bits;
+    memcpy(&pixel_bits, pixel, sizeof(pixel_bits));
+    const uint32x4_t pixel_ints = vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixel_bits)))));
+    const float32x4_t destination = vmulq_f32(vcvtq_f32_u32(pixel_ints), vdupq_n_f32(1.0f / 255.0f));
+    const float32x4_t blended = vaddq_f32(vmulq_f32(source, source_alpha),
+                                          vmulq_f32(destination, vsubq_f32(vdupq_n_f32(1.0f), source_alpha)));
+    const uint16x4_t shorts = vmovn_u32(vcvtq_u32_f32(vaddq_f32(vmulq_f32(blended, vdupq_n_f32(255.0f)), vdupq_n_f32(0.5f))));
+    vst1_lane_u32(&pixel_bits, vreinterpret_u32_u8(vmovn_u16(vcombine_u16(shorts, shorts))), 0);
+    memcpy(pixel, &pixel_bits, sizeof(pixel_bits));
+#else
+    float source[4];
+    for (size_t channel_i = 0; channel_i < 4; channel_i++)
+    {
+      source[channel_i] = bg[channel_i] + (fg[channel_i] * tex_color[channel_i] - bg[channel_i]) * mix_factor;
+    }
+    for (size_t channel_i = 0; channel_i < 4; channel_i++)
+    {
+      const float blended = source[channel_i] * source[3] + pixel[channel_i] / 255.0f * (1.0f - source[3]);
+      pixel[channel_i] = _rlhColorChannelToByte(blended);
+    }
+#endif
+  }
+
+  // Find the texel of an atlas axis that the center of a target pixel samples with nearest filtering.
+  static inline size_t _rlhGetRasterTexel(const float first, const float last, const float position, const size_t size)
+  {
+    const float texel = floorf((first + (last - first) * position) * (float)size);
+    if (texel <= 0.0f)
+      return 0;
+    if (texel >= (float)size)
+      return size - 1;
+    return (size_t)texel;
+  }
+
+  static inline void _rlhRasterizeTile(rlhTerm_h const term, const rlhTileInstance_s *const tile,
+                                       const rlhAtlasCreateInfo_t *const atlas_info, const rlhRasterTarget_t *const target,
+                                       const size_t row_stride, const int end_row)
+  {
+    const float *const stpqp = atlas_info->glyph_stpqp + (tile->glyph & RLH_TILE_GLYPH_MASK) * RLH_FONTMAP_COORDINATES_PER_GLYPH;
+    const int pixel_scale = term->pixel_scale;
+    const int tile_x = tile->pixel_x * pixel_scale;
+    const int tile_y = tile->pixel_y * pixel_scale;
+    const int tile_width = tile->pixel_w * pixel_scale;
+    const int tile_height = tile->pixel_h * pixel_scale;
+    const int first_x = MAX(tile_x, 0);
+    const int last_x = (tile_x + tile_width < target->width) ? tile_x + tile_width : target->width;
+    const int first_y = MAX(tile_y, target->first_row);
+    const int last_y = (tile_y + tile_height < end_row) ? tile_y + tile_height : end_row;
+    if (first_x >= last_x || first_y >= last_y)
+      return;
+    const size_t channel_count = _rlhColorTypeToChannelCount(atlas_info->color);
+    const size_t texel_size = channel_count * atlas_info->channel_size;
+    const size_t atlas_row_size = ((size_t)atlas_info->width * texel_size + 3) & ~(size_t)3;
+    const size_t page = (stpqp[4] <= 0.0f) ? 0 : (size_t)stpqp[4];
+    const uint8_t *const page_pixels = atlas_info->pixel_data +
+                                       ((page < (size_t)atlas_info->pages) ? page : (size_t)atlas_info->pages - 1) *
+                                           _rlhGetAtlasPageSize(atlas_info->width, atlas_info->height, atlas_info->color, atlas_info->channel_size);
+    uint8_t tile_fg[4];
+    uint8_t tile_bg[4];
+    _rlhTermGetTileColors(term, tile, tile_fg, tile_bg);
+    float fg[4] = {tile_fg[0] / 255.0f, tile_fg[1] / 255.0f, tile_fg[2] / 255.0f, tile_fg[3] / 255.0f};
+    float bg[4] = {tile_bg[0] / 255.0f, tile_bg[1] / 255.0f, tile_bg[2] / 255.0f, tile_bg[3] / 255.0f};
+    _rlhTermApplyTileEffect(term, tile, fg, bg);
+    for (int y = first_y; y < last_y; y++)
+    {
+      const size_t texel_y = _rlhGetRasterTexel(stpqp[2], stpqp[3], (y - tile_y + 0.5f) / tile_height, (size_t)atlas_info->height);
+      const uint8_t *const atlas_row = page_pixels + texel_y * atlas_row_size;
+      uint8_t *pixel = target->pixels + (size_t)y * row_stride + (size_t)first_x * 4;
+      for (int x = first_x; x < last_x; x++, pixel += 4)
+      {
+        const size_t texel_x = _rlhGetRasterTexel(stpqp[0], stpqp[1], (x - tile_x + 0.5f) / tile_width, (size_t)atlas_info->width);
+        float tex_color[4];
+        float mix_factor;
+        _rlhReadRasterTexel(atlas_info, atlas_row + texel_x * texel_size, tex_color, &mix_factor);
+        _rlhBlendRasterPixel(fg, bg, tex_color, mix_factor, pixel);
+      }
+    }
+  }
+
+  rlhresult_t rlhCmdListRasterize(rlhCmdList_h const cmd_list, const rlhAtlasCreateInfo_t *const atlas_info,
+                                  const rlhRasterTarget_t *const target)
+  {
+    if (cmd_list == NULL || atlas_info == NULL || target == NULL ||
+        atlas_info->pixel_data == NULL || atlas_info->glyph_stpqp == NULL || target->pixels == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhresult_t result = _rlhAtlasInfoCheck((rlhAtlasCreateInfo_t *)atlas_info);
+    if (result != RLH_RESULT_OK)
+    {
+      return result;
+    }
+    if (
+        (atlas_info->channel_size != 1 && atlas_info->channel_size != 2 && atlas_info->channel_size != 4) ||
+        target->width <= 0 || target->height <= 0 ||
+        (target->row_stride != 0 && target->row_stride < target->width * 4) ||
+        target->first_row < 0 || target->row_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    const size_t row_stride = (target->row_stride != 0) ? (size_t)target->row_stride : (size_t)target->width * 4;
+    const int end_row = (target->row_count == 0 || target->first_row + target->row_count > target->height)
+                            ? target->height
+                            : target->first_row + target->row_count;
+    const rlhTileBuffer_s *const tiles = &cmd_list->tiles;
+    for (size_t tile_i = 0; tile_i < tiles->vertex_data_tile_count; tile_i++)
+    {
+      const rlhTileInstance_s *const tile = &tiles->vertex_data[tile_i];
+      // the glyphs were only checked against the glyph count of the snapshot, and the atlas info only has
+      // the pixels of atlas 0.
+      if ((tile->glyph & RLH_TILE_ATLAS_MASK) != 0 || (tile->glyph & RLH_TILE_GLYPH_MASK) >= (uint32_t)atlas_info->glyph_count)
+        continue;
+      _rlhRasterizeTile(&cmd_list->term, tile, atlas_info, target, row_stride, end_row);
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhCmdListPushFill(rlhCmdList_h const cmd_list, const rlhglyph_t glyph, const rlhColor_s fg,
+                                 const rlhColor_s bg)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushFill(&cmd_list->term, glyph, fg, bg);
+  }
+
+  rlhresult_t rlhCmdListPushGrid(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y,
+                                 const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushGrid(&cmd_list->term, grid_x, grid_y, glyph, fg, bg);
+  }
+
+  rlhresult_t rlhCmdListPushGridSized(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y,
+                                      const int tile_pixel_width, const int tile_pixel_height,
+                                      const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushGridSized(&cmd_list->term, grid_x, grid_y, tile_pixel_width, tile_pixel_height, glyph, fg, bg);
+  }
+
+  rlhresult_t rlhCmdListPushFree(rlhCmdList_h const cmd_list, const int screen_pixel_x, const int screen_pixel_y,
+                                 const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushFree(&cmd_list->term, screen_pixel_x, screen_pixel_y, glyph, fg, bg);
+  }
+
+  rlhresult_t rlhCmdListPushFreeSized(rlhCmdList_h const cmd_list, const int screen_pixel_x, const int screen_pixel_y,
+                                      const int tile_pixel_width, const int tile_pixel_height,
+                                      const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushFreeSized(&cmd_list->term, screen_pixel_x, screen_pixel_y, tile_pixel_width, tile_pixel_height,
+                                glyph, fg, bg);
+  }
+
+  rlhresult_t rlhCmdListPushGridSpan(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y,
+                                     const rlhglyph_t *const glyphs, const int glyph_count,
+                                     const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushGridSpan(&cmd_list->term, grid_x, grid_y, glyphs, glyph_count, fg, bg);
+  }
+
+  rlhresult_t rlhCmdListPushGridSpanColored(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y,
+                                            const rlhglyph_t *const glyphs, const rlhColor_s *const fgs,
+                                            const rlhColor_s *const bgs, const int glyph_count)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushGridSpanColored(&cmd_list->term, grid_x, grid_y, glyphs, fgs, bgs, glyph_count);
+  }
+
+  rlhresult_t rlhCmdListPushGridArray(rlhCmdList_h const cmd_list, const rlhGridTile_s *const tiles,
+                                      const int tile_count)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushGridArray(&cmd_list->term, tiles, tile_count);
+  }
+
+  rlhresult_t rlhCmdListPushString(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y,
+                                   const char *const string, const rlhColor_s fg, const rlhColor_s bg)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushString(&cmd_list->term, grid_x, grid_y, string, fg, bg);
+  }
+
+  rlhresult_t rlhCmdListPushGridPacked(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y,
+                                       const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushGridPacked(&cmd_list->term, grid_x, grid_y, glyph, fg, bg);
+  }
+
+  rlhresult_t rlhCmdListPushFreePacked(rlhCmdList_h const cmd_list, const int screen_pixel_x, const int screen_pixel_y,
+                                       const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushFreePacked(&cmd_list->term, screen_pixel_x, screen_pixel_y, glyph, fg, bg);
+  }
+
+  rlhresult_t rlhCmdListSetPushEffect(rlhCmdList_h const cmd_list, const int effect)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermSetPushEffect(&cmd_list->term, effect);
+  }
+
+  rlhresult_t rlhCmdListSelectAtlas(rlhCmdList_h const cmd_list, const int atlas_index)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermSelectAtlas(&cmd_list->term, atlas_index);
+  }
+
+  rlhresult_t rlhCmdListSetPalette(rlhCmdList_h const cmd_list, const int first_index, const uint32_t *const colors,
+                                   const int color_count)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return _rlhTermSetPaletteColors(&cmd_list->term, first_index, colors, color_count);
+  }
+
+  rlhresult_t rlhCmdListPushGridIndexed(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y,
+                                        const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushGridIndexed(&cmd_list->term, grid_x, grid_y, glyph, fg_index, bg_index);
+  }
+
+  rlhresult_t rlhCmdListPushFreeIndexed(rlhCmdList_h const cmd_list, const int screen_pixel_x, const int screen_pixel_y,
+                                        const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushFreeIndexed(&cmd_list->term, screen_pixel_x, screen_pixel_y, glyph, fg_index, bg_index);
+  }
+
+  rlhresult_t rlhCmdListPushGridSpanIndexed(rlhCmdList_h const cmd_list, const int grid_x, const int grid_y,
+                                            const rlhglyph_t *const glyphs, const int glyph_count,
+                                            const uint8_t fg_index, const uint8_t bg_index)
+  {
+    if (cmd_list == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return rlhTermPushGridSpanIndexed(&cmd_list->term, grid_x, grid_y, glyphs, glyph_count, fg_index, bg_index);
+  }
+
+  rlhresult_t rlhTermSubmit(rlhTerm_h const term, const rlhCmdList_h *const cmd_lists, const int cmd_list_count)
+  {
+    if (term == NULL || cmd_lists == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (cmd_list_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    size_t total_tile_count = 0;
+    for (int list_i = 0; list_i < cmd_list_count; list_i++)
+    {
+      const rlhCmdList_h cmd_list = cmd_lists[list_i];
+      if (cmd_list == NULL)
+      {
+        return RLH_RESULT_ERROR_NULL_ARGUMENT;
+      }
+      // the glyph indices were only checked against the glyph counts of the snapshot.
+      if (cmd_list->term.glyph_count > _rlhTermGetGlyphCount(term))
+      {
+        return RLH_RESULT_ERROR_INVALID_VALUE;
+      }
+      for (size_t atlas_i = 1; atlas_i < RLH_MAX_TERM_ATLASES; atlas_i++)
+      {
+        if (cmd_list->term.atlas_glyph_counts[atlas_i] > _rlhTermGetAtlasGlyphCount(term, atlas_i))
+        {
+          return RLH_RESULT_ERROR_INVALID_VALUE;
+        }
+      }
+      total_tile_count += cmd_list->tiles.vertex_data_tile_count;
+    }
+    if (!_rlhTermTryReserveTiles(term, total_tile_count))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    const size_t first_tile = term->tiles->vertex_data_tile_count;
+    for (int list_i = 0; list_i < cmd_list_count; list_i++)
+    {
+      // tiles were culled and rejected when they were recorded.
+      const rlhTermStats_t *const recorded_stats = &cmd_lists[list_i]->term.stats;
+      term->stats.tiles_culled += recorded_stats->tiles_culled;
+      term->stats.tiles_rejected += recorded_stats->tiles_rejected;
+    }
+    if (total_tile_count == 0)
+    {
+      return RLH_RESULT_OK;
+    }
+    term->stats.tiles_pushed += total_tile_count;
+    for (int list_i = 0; list_i < cmd_list_count; list_i++)
+    {
+      const rlhTileBuffer_s *const recorded = &cmd_lists[list_i]->tiles;
+      if (recorded->vertex_data_tile_count == 0)
+        continue;
+      memcpy(
+          term->tiles->vertex_data + term->tiles->vertex_data_tile_count,
+          recorded->vertex_data,
+          _rlhGetVertexDataSize(recorded->vertex_data_tile_count));
+      term->tiles->vertex_data_tile_count += recorded->vertex_data_tile_count;
+    }
+    _rlhTileBufferMarkTilesDirty(term->tiles, first_tile, term->tiles->vertex_data_tile_count);
+    return RLH_RESULT_OK;
+  }
+
+#if defined(RLH_ATOMICS_MSVC) || defined(RLH_ATOMICS_GNUC)
+  // Swap a value with another thread. The writes before the swap are visible to the thread that swaps
+  // the value out, and the writes of that thread before its own swap are visible after this one.
+  static inline long _rlhAtomicExchange(volatile long *const value, const long new_value)
+  {
+#if defined(RLH_ATOMICS_MSVC)
+    return _InterlockedExchange(value, new_value);
+#else
+    return __atomic_exchange_n(value, new_value, __ATOMIC_ACQ_REL);
+#endif
+  }
+
+  static inline long _rlhAtomicLoad(volatile long *const value)
+  {
+#if defined(RLH_ATOMICS_MSVC)
+    return _InterlockedCompareExchange(value, 0, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+  }
+#endif
+
+  // Take the latest published frame of a terminal if there is a newer one than the last draw took, and
+  // append the front frame to the frame layer.
+  // Append the latest published frame of a terminal to its frame layer. Returns the result of the submit.
+  static inline rlhresult_t _rlhTermTakePublishedFrame(rlhTerm_h const term)
+  {
+#if defined(RLH_ATOMICS_MSVC) || defined(RLH_ATOMICS_GNUC)
+    if (term->frames[0] == NULL)
+      return RLH_RESULT_OK;
+    rlhTermLayer_s *const layer = &term->layers[term->frame_layer];
+    const rlhbool_t fresh = (_rlhAtomicLoad(&term->published_frame) & RLH_FRAME_FRESH_BIT) != 0;
+    if (fresh)
+    {
+      term->front_frame = (size_t)(_rlhAtomicExchange(&term->published_frame, (long)term->front_frame) & ~RLH_FRAME_FRESH_BIT);
+    }
+    // a retained layer keeps the last frame until a newer one replaces it.
+    if (layer->mode == RLH_LAYER_RETAINED)
+    {
+      if (!fresh)
+        return RLH_RESULT_OK;
+      _rlhTileBufferClear(&layer->tiles);
+    }
+    rlhTileBuffer_s *const selected_tiles = term->tiles;
+    term->tiles = &layer->tiles;
+    const rlhresult_t result = rlhTermSubmit(term, &term->frames[term->front_frame], 1);
+    term->tiles = selected_tiles;
+    return result;
+#else
+    (void)term;
+    return RLH_RESULT_OK;
+#endif
+  }
+
+  rlhresult_t rlhTermSetFramePublishing(rlhTerm_h const term, const rlhbool_t enabled)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+#if defined(RLH_ATOMICS_MSVC) || defined(RLH_ATOMICS_GNUC)
+    _rlhTermDestroyFrames(term);
+    if (!enabled)
+    {
+      return RLH_RESULT_OK;
+    }
+    for (size_t frame_i = 0; frame_i < RLH_PUBLISHED_FRAME_COUNT; frame_i++)
+    {
+      rlhresult_t result = rlhCmdListCreate(term, &term->frames[frame_i]);
+      if (result != RLH_RESULT_OK)
+      {
+        _rlhTermDestroyFrames(term);
+        return result;
+      }
+    }
+    term->back_frame = 0;
+    term->published_frame = 1;
+    term->front_frame = 2;
+    term->frame_layer = term->selected_layer;
+    return RLH_RESULT_OK;
+#else
+    return enabled ? RLH_RESULT_ERROR_UNSUPPORTED : RLH_RESULT_OK;
+#endif
+  }
+
+  rlhbool_t rlhTermGetFramePublishing(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return RLH_FALSE;
+    }
+    return term->frames[0] != NULL;
+  }
+
+  rlhCmdList_h rlhTermGetBackFrame(rlhTerm_h const term)
+  {
+    if (term == NULL || term->frames[0] == NULL)
+    {
+      return NULL;
+    }
+    return term->frames[term->back_frame];
+  }
+
+  rlhresult_t rlhTermPublish(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (term->frames[0] == NULL)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+#if defined(RLH_ATOMICS_MSVC) || defined(RLH_ATOMICS_GNUC)
+    const long published = (long)term->back_frame | RLH_FRAME_FRESH_BIT;
+    term->back_frame = (size_t)(_rlhAtomicExchange(&term->published_frame, published) & ~RLH_FRAME_FRESH_BIT);
+    return rlhCmdListClear(term->frames[term->back_frame]);
+#else
+    return RLH_RESULT_ERROR_UNSUPPORTED;
+#endif
+  }
+
+  rlhresult_t rlhTileStreamCreate(rlhTileStream_h *stream)
+  {
+    if (stream == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhTileStream_h stream_h = (rlhTileStream_h)_rlhAllocate(&_rlh_allocator, sizeof(rlhTileStream_s));
+    if (stream_h == NULL)
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    memset(stream_h, 0, sizeof(rlhTileStream_s));
+    stream_h->allocator = _rlh_allocator;
+    *stream = stream_h;
+    return RLH_RESULT_OK;
+  }
+
+  void rlhTileStreamDestroy(rlhTileStream_h const stream)
+  {
+    if (stream == NULL)
+      return;
+    const rlhAllocator_t allocator = stream->allocator;
+    _rlhDeallocate(&allocator, stream->tiles);
+    _rlhDeallocate(&allocator, stream->palette);
+    _rlhDeallocate(&allocator, stream->palette_table);
+    _rlhDeallocate(&allocator, stream->data);
+    _rlhDeallocate(&allocator, stream);
+  }
+
+  // Grow an array of a tile stream to hold at least a count of elements, doubling its capacity.
+  static inline rlhbool_t _rlhTileStreamTryReserve(rlhTileStream_h const stream, void **const array, size_t *const capacity,
+                                                   const size_t count, const size_t element_size)
+  {
+    if (count <= *capacity)
+      return RLH_TRUE;
+    size_t new_capacity = MAX(*capacity * 2, RLH_MIN_TILE_CAPACITY);
+    while (new_capacity < count)
+    {
+      new_capacity *= 2;
+    }
+    void *const new_array = _rlhReallocate(&stream->allocator, *array, new_capacity * element_size);
+    if (new_array == NULL)
+      return RLH_FALSE;
+    *array = new_array;
+    *capacity = new_capacity;
+    return RLH_TRUE;
+  }
+
+  static inline size_t _rlhHashColor(const uint32_t color, const size_t table_capacity)
+  {
+    return (size_t)((color * 0x9E3779B1u) >> 7) & (table_capacity - 1);
+  }
+
+  // Find the palette index of a color, or RLH_TILE_STREAM_NO_COLOR if it is not in the palette.
+  static inline uint32_t _rlhTileStreamFindColor(rlhTileStream_h const stream, const uint32_t color)
+  {
+    if (stream->palette_table_capacity == 0)
+      return RLH_TILE_STREAM_NO_COLOR;
+    for (size_t slot = _rlhHashColor(color, stream->palette_table_capacity);; slot = (slot + 1) & (stream->palette_table_capacity - 1))
+    {
+      const uint32_t index = stream->palette_table[slot];
+      if (index == RLH_TILE_STREAM_NO_COLOR || stream->palette[index] == color)
+        return index;
+    }
+  }
+
+  // Add a color to the end of the palette, and to the table that the encoder finds colors with.
+  static inline rlhbool_t _rlhTileStreamAddColor(rlhTileStream_h const stream, const uint32_t color, const rlhbool_t encoding)
+  {
+    if (!_rlhTileStreamTryReserve(stream, (void **)&stream->palette, &stream->palette_capacity, stream->palette_count + 1, sizeof(uint32_t)))
+      return RLH_FALSE;
+    stream->palette[stream->palette_count++] = color;
+    if (!encoding)
+      return RLH_TRUE;
+    // keep the table at most half full, and put every color in again when it grows.
+    if (stream->palette_count * 2 > stream->palette_table_capacity)
+    {
+      const size_t new_capacity = MAX(stream->palette_table_capacity * 2, 64);
+      uint32_t *const new_table = (uint32_t *)_rlhAllocate(&stream->allocator, new_capacity * sizeof(uint32_t));
+      if (new_table == NULL)
+        return RLH_FALSE;
+      _rlhDeallocate(&stream->allocator, stream->palette_table);
+      stream->palette_table = new_table;
+      stream->palette_table_capacity = new_capacity;
+      memset(new_table, 0xFF, new_capacity * sizeof(uint32_t));
+      for (uint32_t index = 0; index + 1 < stream->palette_count; index++)
+      {
+        size_t slot = _rlhHashColor(stream->palette[index], new_capacity);
+        while (new_table[slot] != RLH_TILE_STREAM_NO_COLOR)
+        {
+          slot = (slot + 1) & (new_capacity - 1);
+        }
+        new_table[slot] = index;
+      }
+    }
+    size_t slot = _rlhHashColor(color, stream->palette_table_capacity);
+    while (stream->palette_table[slot] != RLH_TILE_STREAM_NO_COLOR)
+    {
+      slot = (slot + 1) & (stream->palette_table_capacity - 1);
+    }
+    stream->palette_table[slot] = (uint32_t)(stream->palette_count - 1);
+    return RLH_TRUE;
+  }
+
+  static inline void _rlhTileStreamResetPalette(rlhTileStream_h const stream)
+  {
+    stream->palette_count = 0;
+    if (stream->palette_table != NULL)
+    {
+      memset(stream->palette_table, 0xFF, stream->palette_table_capacity * sizeof(uint32_t));
+    }
+  }
+
+  // Write an unsigned integer with 7 bits in each byte, lowest bits first. Room for it must already be reserved.
+  static inline void _rlhTileStreamWriteVarint(rlhTileStream_h const stream, uint32_t value)
+  {
+    while (value >= 0x80)
+    {
+      stream->data[stream->data_size++] = (uint8_t)(value | 0x80);
+      value >>= 7;
+    }
+    stream->data[stream->data_size++] = (uint8_t)value;
+  }
+
+  static inline uint32_t _rlhZigzag(const int32_t value)
+  {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+  }
+
+  static inline int32_t _rlhUnzigzag(const uint32_t value)
+  {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+  }
+
+  // Write a reference to a palette color, and the color itself after the index if it is new to the palette.
+  static inline rlhbool_t _rlhTileStreamWriteColor(rlhTileStream_h const stream, const uint8_t *const channels)
+  {
+    uint32_t color;
+    memcpy(&color, channels, sizeof(color));
+    const uint32_t index = _rlhTileStreamFindColor(stream, color);
+    if (index != RLH_TILE_STREAM_NO_COLOR)
+    {
+      _rlhTileStreamWriteVarint(stream, index);
+      return RLH_TRUE;
+    }
+    _rlhTileStreamWriteVarint(stream, (uint32_t)stream->palette_count);
+    memcpy(stream->data + stream->data_size, channels, 4);
+    stream->data_size += 4;
+    return _rlhTileStreamAddColor(stream, color, RLH_TRUE);
+  }
+
+  // Write a tile with its position relative to the tile written before it, and skip the size and colors
+  // that are the same as that tile.
+  static inline rlhbool_t _rlhTileStreamWriteTile(rlhTileStream_h const stream, const rlhTileInstance_s *const tile,
+                                                  rlhTileInstance_s *const previous)
+  {
+    uint8_t flags = 0;
+    if (tile->pixel_w == previous->pixel_w && tile->pixel_h == previous->pixel_h)
+      flags |= RLH_TILE_STREAM_SAME_SIZE;
+    if (memcmp(tile->fg, previous->fg, sizeof(tile->fg)) == 0)
+      flags |= RLH_TILE_STREAM_SAME_FG;
+    if (memcmp(tile->bg, previous->bg, sizeof(tile->bg)) == 0)
+      flags |= RLH_TILE_STREAM_SAME_BG;
+    stream->data[stream->data_size++] = flags;
+    _rlhTileStreamWriteVarint(stream, _rlhZigzag(tile->pixel_x - previous->pixel_x));
+    _rlhTileStreamWriteVarint(stream, _rlhZigzag(tile->pixel_y - previous->pixel_y));
+    if (!(flags & RLH_TILE_STREAM_SAME_SIZE))
+    {
+      _rlhTileStreamWriteVarint(stream, _rlhZigzag(tile->pixel_w));
+      _rlhTileStreamWriteVarint(stream, _rlhZigzag(tile->pixel_h));
+    }
+    _rlhTileStreamWriteVarint(stream, tile->glyph);
+    if (!(flags & RLH_TILE_STREAM_SAME_FG) && !_rlhTileStreamWriteColor(stream, tile->fg))
+      return RLH_FALSE;
+    if (!(flags & RLH_TILE_STREAM_SAME_BG) && !_rlhTileStreamWriteColor(stream, tile->bg))
+      return RLH_FALSE;
+    *previous = *tile;
+    return RLH_TRUE;
+  }
+
+  // Encode the tiles of a tile buffer as a snapshot, or as runs of the tiles that changed since the last
+  // encode. Each run starts with the count of unchanged tiles before it and the count of tiles in it.
+  static inline rlhresult_t _rlhTileStreamEncode(rlhTileStream_h const stream, const rlhTileBuffer_s *const tiles,
+                                                 const rlhbool_t snapshot, const uint8_t **const data, size_t *const size)
+  {
+    const size_t tile_count = tiles->vertex_data_tile_count;
+    // colors are only removed from the palette by a snapshot, so one is sent when the palette gets too big.
+    const rlhbool_t keyframe = snapshot || !stream->synchronized || stream->palette_count >= RLH_TILE_STREAM_MAX_PALETTE_COLORS;
+    // every tile and up to two new colors fit in the worst case size, so writes past this are not checked.
+    const size_t max_size = RLH_TILE_STREAM_HEADER_SIZE + 2 * RLH_MAX_VARINT_SIZE + tile_count * (RLH_MAX_ENCODED_TILE_SIZE + 2 * RLH_MAX_VARINT_SIZE);
+    if (!_rlhTileStreamTryReserve(stream, (void **)&stream->data, &stream->data_capacity, max_size, 1))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    if (keyframe)
+    {
+      _rlhTileStreamResetPalette(stream);
+      stream->tile_count = 0;
+    }
+    stream->data_size = 0;
+    memcpy(stream->data, RLH_TILE_STREAM_MAGIC, sizeof(RLH_TILE_STREAM_MAGIC));
+    stream->data_size += sizeof(RLH_TILE_STREAM_MAGIC);
+    stream->data[stream->data_size++] = RLH_TILE_STREAM_VERSION;
+    stream->data[stream->data_size++] = keyframe ? RLH_TILE_STREAM_KEYFRAME : 0;
+    _rlhTileStreamWriteVarint(stream, (uint32_t)tile_count);
+    rlhTileInstance_s previous;
+    memset(&previous, 0, sizeof(previous));
+    size_t tile_i = 0;
+    while (tile_i < tile_count)
+    {
+      const size_t run_begin = tile_i;
+      while (tile_i < tile_count && tile_i < stream->tile_count &&
+             memcmp(&tiles->vertex_data[tile_i], &stream->tiles[tile_i], sizeof(rlhTileInstance_s)) == 0)
+      {
+        tile_i++;
+      }
+      const size_t changed_begin = tile_i;
+      while (tile_i < tile_count &&
+             (tile_i >= stream->tile_count || memcmp(&tiles->vertex_data[tile_i], &stream->tiles[tile_i], sizeof(rlhTileInstance_s)) != 0))
+      {
+        tile_i++;
+      }
+      _rlhTileStreamWriteVarint(stream, (uint32_t)(changed_begin - run_begin));
+      _rlhTileStreamWriteVarint(stream, (uint32_t)(tile_i - changed_begin));
+      for (size_t changed_i = changed_begin; changed_i < tile_i; changed_i++)
+      {
+        if (!_rlhTileStreamWriteTile(stream, &tiles->vertex_data[changed_i], &previous))
+        {
+          stream->synchronized = RLH_FALSE;
+          return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+        }
+      }
+    }
+    if (!_rlhTileStreamTryReserve(stream, (void **)&stream->tiles, &stream->tile_capacity, tile_count, sizeof(rlhTileInstance_s)))
+    {
+      stream->synchronized = RLH_FALSE;
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    if (tile_count > 0)
+    {
+      memcpy(stream->tiles, tiles->vertex_data, _rlhGetVertexDataSize(tile_count));
+    }
+    stream->tile_count = tile_count;
+    stream->synchronized = RLH_TRUE;
+    *data = stream->data;
+    *size = stream->data_size;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermEncodeTiles(rlhTerm_h const term, rlhTileStream_h const stream, const rlhbool_t snapshot,
+                                 const uint8_t **const data, size_t *const size)
+  {
+    if (term == NULL || stream == NULL || data == NULL || size == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    // the tiles of the persistent stream mode are written to mapped memory that is too slow to read back.
+    if (term->tiles->stream_mode == RLH_STREAM_PERSISTENT)
+    {
+      return RLH_RESULT_ERROR_UNSUPPORTED;
+    }
+    return _rlhTileStreamEncode(stream, term->tiles, snapshot, data, size);
+  }
+
+  rlhresult_t rlhCmdListEncodeTiles(rlhCmdList_h const cmd_list, rlhTileStream_h const stream, const rlhbool_t snapshot,
+                                    const uint8_t **const data, size_t *const size)
+  {
+    if (cmd_list == NULL || stream == NULL || data == NULL || size == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return _rlhTileStreamEncode(stream, &cmd_list->tiles, snapshot, data, size);
+  }
+
+  // Reads encoded bytes, and stops reading once any read goes past the end of them.
+  typedef struct rlhTileStreamReader_s
+  {
+    const uint8_t *data;
+    size_t size;
+    size_t position;
+    rlhbool_t failed;
+  } rlhTileStreamReader_s;
+
+  static inline uint8_t _rlhTileStreamReadByte(rlhTileStreamReader_s *const reader)
+  {
+    if (reader->position >= reader->size)
+    {
+      reader->failed = RLH_TRUE;
+      return 0;
+    }
+    return reader->data[reader->position++];
+  }
+
+  static inline uint32_t _rlhTileStreamReadVarint(rlhTileStreamReader_s *const reader)
+  {
+    uint32_t value = 0;
+    for (size_t shift = 0; shift < 32 && !reader->failed; shift += 7)
+    {
+      const uint8_t byte = _rlhTileStreamReadByte(reader);
+      value |= (uint32_t)(byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+    reader->failed = RLH_TRUE;
+    return 0;
+  }
+
+  static inline rlhbool_t _rlhTileStreamReadColor(rlhTileStream_h const stream, rlhTileStreamReader_s *const reader, uint8_t *const channels)
+  {
+    const uint32_t index = _rlhTileStreamReadVarint(reader);
+    if (index < stream->palette_count)
+    {
+      memcpy(channels, &stream->palette[index], 4);
+      return RLH_TRUE;
+    }
+    if (index != stream->palette_count)
+      return RLH_FALSE;
+    for (size_t channel_i = 0; channel_i < 4; channel_i++)
+    {
+      channels[channel_i] = _rlhTileStreamReadByte(reader);
+    }
+    uint32_t color;
+    memcpy(&color, channels, sizeof(color));
+    return !reader->failed && _rlhTileStreamAddColor(stream, color, RLH_FALSE);
+  }
+
+  static inline rlhbool_t _rlhTileStreamReadTile(rlhTileStream_h const stream, rlhTileStreamReader_s *const reader,
+                                                 rlhTileInstance_s *const tile, rlhTileInstance_s *const previous)
+  {
+    const uint8_t flags = _rlhTileStreamReadByte(reader);
+    *tile = *previous;
+    tile->pixel_x = (int16_t)(previous->pixel_x + _rlhUnzigzag(_rlhTileStreamReadVarint(reader)));
+    tile->pixel_y = (int16_t)(previous->pixel_y + _rlhUnzigzag(_rlhTileStreamReadVarint(reader)));
+    if (!(flags & RLH_TILE_STREAM_SAME_SIZE))
+    {
+      tile->pixel_w = (int16_t)_rlhUnzigzag(_rlhTileStreamReadVarint(reader));
+      tile->pixel_h = (int16_t)_rlhUnzigzag(_rlhTileStreamReadVarint(reader));
+    }
+    tile->glyph = _rlhTileStreamReadVarint(reader);
+    if (!(flags & RLH_TILE_STREAM_SAME_FG) && !_rlhTileStreamReadColor(stream, reader, tile->fg))
+      return RLH_FALSE;
+    if (!(flags & RLH_TILE_STREAM_SAME_BG) && !_rlhTileStreamReadColor(stream, reader, tile->bg))
+      return RLH_FALSE;
+    *previous = *tile;
+    return !reader->failed;
+  }
+
+  rlhresult_t rlhTileStreamApply(rlhTileStream_h const stream, const uint8_t *const data, const size_t size)
+  {
+    if (stream == NULL || data == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    rlhTileStreamReader_s reader = {data, size, 0, RLH_FALSE};
+    if (size < RLH_TILE_STREAM_HEADER_SIZE || memcmp(data, RLH_TILE_STREAM_MAGIC, sizeof(RLH_TILE_STREAM_MAGIC)) != 0 ||
+        data[sizeof(RLH_TILE_STREAM_MAGIC)] != RLH_TILE_STREAM_VERSION)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    reader.position = RLH_TILE_STREAM_HEADER_SIZE;
+    const rlhbool_t keyframe = (data[sizeof(RLH_TILE_STREAM_MAGIC) + 1] & RLH_TILE_STREAM_KEYFRAME) != 0;
+    if (!keyframe && !stream->synchronized)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    const size_t tile_count = _rlhTileStreamReadVarint(&reader);
+    const size_t old_tile_count = keyframe ? 0 : stream->tile_count;
+    // every tile that changed takes at least one byte, which rejects counts that would allocate too much memory.
+    if (reader.failed || tile_count > old_tile_count + size)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    if (!_rlhTileStreamTryReserve(stream, (void **)&stream->tiles, &stream->tile_capacity, tile_count, sizeof(rlhTileInstance_s)))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    // the tiles are changed in place, so a delta that fails part of the way needs a snapshot after it.
+    stream->synchronized = RLH_FALSE;
+    if (keyframe)
+    {
+      _rlhTileStreamResetPalette(stream);
+    }
+    rlhTileInstance_s previous;
+    memset(&previous, 0, sizeof(previous));
+    size_t tile_i = 0;
+    while (tile_i < tile_count)
+    {
+      const size_t unchanged_count = _rlhTileStreamReadVarint(&reader);
+      const size_t changed_count = _rlhTileStreamReadVarint(&reader);
+      if (reader.failed || unchanged_count > tile_count - tile_i || tile_i + unchanged_count > old_tile_count ||
+          changed_count > tile_count - tile_i - unchanged_count || unchanged_count + changed_count == 0)
+      {
+        return RLH_RESULT_ERROR_INVALID_VALUE;
+      }
+      tile_i += unchanged_count;
+      for (size_t changed_i = 0; changed_i < changed_count; changed_i++, tile_i++)
+      {
+        if (!_rlhTileStreamReadTile(stream, &reader, &stream->tiles[tile_i], &previous))
+        {
+          return RLH_RESULT_ERROR_INVALID_VALUE;
+        }
+      }
+    }
+    stream->tile_count = tile_count;
+    stream->synchronized = RLH_TRUE;
+    return RLH_RESULT_OK;
+  }
+
+  // Push the tiles of a tile stream, with the same checks as pushing them one at a time.
+  static inline rlhresult_t _rlhTermPushTileStream(rlhTerm_h const term, rlhTileStream_h const stream)
+  {
+    if (!_rlhTermTryReserveTiles(term, stream->tile_count))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+    }
+    const size_t first_tile = term->tiles->vertex_data_tile_count;
+    for (size_t tile_i = 0; tile_i < stream->tile_count; tile_i++)
+    {
+      const rlhTileInstance_s *const tile = &stream->tiles[tile_i];
+      if ((tile->glyph & RLH_TILE_GLYPH_MASK) >= _rlhTermGetAtlasGlyphCount(term, (tile->glyph & RLH_TILE_ATLAS_MASK) >> RLH_TILE_ATLAS_SHIFT))
+      {
+        term->stats.tiles_rejected++;
+        continue;
+      }
+      if (!_rlhTermIsTileVisible(term, tile->pixel_x, tile->pixel_y, tile->pixel_w, tile->pixel_h))
+      {
+        term->stats.tiles_culled++;
+        continue;
+      }
+      term->stats.tiles_pushed++;
+      term->tiles->vertex_data[term->tiles->vertex_data_tile_count++] = *tile;
+    }
+    _rlhTileBufferMarkTilesDirty(term->tiles, first_tile, term->tiles->vertex_data_tile_count);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermPushTileStream(rlhTerm_h const term, rlhTileStream_h const stream)
   {
-    GLD_START();
-    GLD_CALL(glViewport(x, y, width, height));
+    if (term == NULL || stream == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    return _rlhTermPushTileStream(term, stream);
   }
 
-  rlhresult_t rlhTermCreate(rlhTermCreateInfo_t *term_info, rlhTerm_h *term)
+  rlhresult_t rlhCmdListPushTileStream(rlhCmdList_h const cmd_list, rlhTileStream_h const stream)
   {
-    if (term == NULL)
+    if (cmd_list == NULL || stream == NULL)
     {
       return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
-    rlhresult_t result = _rlhTermInfoCheck(term_info);
-    if (result != RLH_RESULT_OK)
+    return _rlhTermPushTileStream(&cmd_list->term, stream);
+  }
+
+  rlhresult_t rlhTilemapCreate(const int cells_wide, const int cells_tall, rlhTilemap_h *tilemap)
+  {
+    if (tilemap == NULL)
     {
-      return result;
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
-    rlhTerm_h term_h = (rlhTerm_h)malloc(sizeof(rlhTerm_s));
-    if (term_h == NULL)
+    if (cells_wide <= 0 || cells_tall <= 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    rlhTilemap_h tilemap_h = (rlhTilemap_h)_rlhAllocate(&_rlh_allocator, sizeof(rlhTilemap_s));
+    if (tilemap_h == NULL)
     {
       return RLH_RESULT_ERROR_OUT_OF_MEMORY;
     }
-
-    memset(term_h, 0, sizeof(rlhTerm_s));
-    _rlhTermSetPixelSize(
-        term_h,
-        term_info->size_info);
-    term_h->vertex_data_tile_capacity = term_h->tiles_wide * term_h->tiles_tall;
-    const size_t vertex_data_size = _rlhGetVertexDataSize(term_h->vertex_data_tile_capacity);
-    term_h->vertex_data = malloc(vertex_data_size);
-    if (term_h->vertex_data == NULL)
+    memset(tilemap_h, 0, sizeof(rlhTilemap_s));
+    tilemap_h->allocator = _rlh_allocator;
+    tilemap_h->cells_wide = (size_t)cells_wide;
+    tilemap_h->cells_tall = (size_t)cells_tall;
+    tilemap_h->chunks_wide = ((size_t)cells_wide + RLH_TILEMAP_CHUNK_CELLS - 1) / RLH_TILEMAP_CHUNK_CELLS;
+    tilemap_h->chunks_tall = ((size_t)cells_tall + RLH_TILEMAP_CHUNK_CELLS - 1) / RLH_TILEMAP_CHUNK_CELLS;
+    const size_t chunks_size = tilemap_h->chunks_wide * tilemap_h->chunks_tall * sizeof(rlhTilemapChunk_s);
+    tilemap_h->chunks = (rlhTilemapChunk_s *)_rlhAllocate(&tilemap_h->allocator, chunks_size);
+    if (tilemap_h->chunks == NULL)
     {
-      free(term_h);
+      _rlhDeallocate(&tilemap_h->allocator, tilemap_h);
       return RLH_RESULT_ERROR_OUT_OF_MEMORY;
     }
-    result = _rlhTermSetAtlas(term_h, term_info->atlas_info);
-    if (result != RLH_RESULT_OK)
+    memset(tilemap_h->chunks, 0, chunks_size);
+    for (size_t chunk_i = 0; chunk_i < tilemap_h->chunks_wide * tilemap_h->chunks_tall; chunk_i++)
     {
-      free(term_h);
-      return result;
+      tilemap_h->chunks[chunk_i].tiles.allocator = &tilemap_h->allocator;
     }
-    *term = term_h;
+    tilemap_h->reference_count = 1;
+    *tilemap = tilemap_h;
     return RLH_RESULT_OK;
   }
 
-  void rlhTermDestroy(rlhTerm_h const term)
+  void rlhTilemapDestroy(rlhTilemap_h const tilemap)
   {
-    if (term == NULL)
+    _rlhTilemapRelease(tilemap);
+  }
+
+  void rlhTilemapGetSize(rlhTilemap_h const tilemap, int *const cells_wide, int *const cells_tall)
+  {
+    if (tilemap == NULL)
       return;
-    free(term->vertex_data);
-    term->vertex_data = NULL;
-    free(term->glyph_stpqp);
-    term->glyph_stpqp = NULL;
-    free(term->element_data);
-    term->element_data = NULL;
-    GLD_START();
-    if (term->gl_vertex_array != GL_NONE)
+    if (cells_wide != NULL)
+      *cells_wide = (int)tilemap->cells_wide;
+    if (cells_tall != NULL)
+      *cells_tall = (int)tilemap->cells_tall;
+  }
+
+  // Write a cell of a tilemap, and allocate its chunk the first time one of its cells is written.
+  static inline rlhresult_t _rlhTilemapWriteCell(rlhTilemap_h const tilemap, const int cell_x, const int cell_y,
+                                                 const uint32_t glyph, const uint8_t *const packed)
+  {
+    if (tilemap == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (cell_x < 0 || cell_y < 0 || (size_t)cell_x >= tilemap->cells_wide || (size_t)cell_y >= tilemap->cells_tall)
     {
-      GLD_CALL(glDeleteVertexArrays(1, &term->gl_vertex_array));
-      term->gl_vertex_array = GL_NONE;
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    rlhTilemapChunk_s *const chunk = tilemap->chunks + ((size_t)cell_y / RLH_TILEMAP_CHUNK_CELLS) * tilemap->chunks_wide +
+                                     (size_t)cell_x / RLH_TILEMAP_CHUNK_CELLS;
+    if (chunk->cells == NULL)
+    {
+      const size_t cells_size = RLH_TILEMAP_CHUNK_CELLS * RLH_TILEMAP_CHUNK_CELLS * sizeof(rlhTilemapCell_s);
+      chunk->cells = (rlhTilemapCell_s *)_rlhAllocate(&tilemap->allocator, cells_size);
+      if (chunk->cells == NULL)
+      {
+        return RLH_RESULT_ERROR_OUT_OF_MEMORY;
+      }
+      memset(chunk->cells, 0, cells_size);
     }
-    if (term->gl_vertex_buffer != GL_NONE)
+    rlhTilemapCell_s *const cell = chunk->cells + ((size_t)cell_y % RLH_TILEMAP_CHUNK_CELLS) * RLH_TILEMAP_CHUNK_CELLS +
+                                   (size_t)cell_x % RLH_TILEMAP_CHUNK_CELLS;
+    // writing a cell again with the same tile happens a lot when a whole map is written every turn.
+    if (cell->glyph == glyph && memcmp(cell->fg, packed, sizeof(cell->fg)) == 0 && memcmp(cell->bg, packed + 4, sizeof(cell->bg)) == 0)
     {
-      GLD_CALL(glDeleteBuffers(1, &term->gl_vertex_buffer));
-      term->gl_vertex_buffer = GL_NONE;
+      return RLH_RESULT_OK;
     }
-    if (term->gl_element_buffer != GL_NONE)
+    cell->glyph = glyph;
+    memcpy(cell->fg, packed, sizeof(cell->fg));
+    memcpy(cell->bg, packed + 4, sizeof(cell->bg));
+    chunk->changed = RLH_TRUE;
+    tilemap->version++;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTilemapSetCell(rlhTilemap_h const tilemap, const int cell_x, const int cell_y, const rlhglyph_t glyph,
+                                const rlhColor_s fg, const rlhColor_s bg)
+  {
+    uint8_t packed[8];
+    _rlhPackColorPair(fg, bg, packed);
+    return _rlhTilemapWriteCell(tilemap, cell_x, cell_y, glyph, packed);
+  }
+
+  rlhresult_t rlhTilemapSetCellPacked(rlhTilemap_h const tilemap, const int cell_x, const int cell_y,
+                                      const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg)
+  {
+    uint8_t packed[8];
+    _rlhUnpackColorPair(fg, bg, packed);
+    return _rlhTilemapWriteCell(tilemap, cell_x, cell_y, glyph, packed);
+  }
+
+  rlhresult_t rlhTilemapSetCellIndexed(rlhTilemap_h const tilemap, const int cell_x, const int cell_y,
+                                       const rlhglyph_t glyph, const uint8_t fg_index, const uint8_t bg_index)
+  {
+    uint8_t packed[8];
+    _rlhIndexColorPair(fg_index, bg_index, packed);
+    return _rlhTilemapWriteCell(tilemap, cell_x, cell_y, glyph | RLH_TILE_FG_INDEXED | RLH_TILE_BG_INDEXED, packed);
+  }
+
+  rlhresult_t rlhTilemapClearCell(rlhTilemap_h const tilemap, const int cell_x, const int cell_y)
+  {
+    const uint8_t packed[8] = {0};
+    return _rlhTilemapWriteCell(tilemap, cell_x, cell_y, 0, packed);
+  }
+
+  rlhresult_t rlhTermSetTilemap(rlhTerm_h const term, rlhTilemap_h const tilemap)
+  {
+    if (term == NULL)
     {
-      GLD_CALL(glDeleteBuffers(1, &term->gl_element_buffer));
-      term->gl_element_buffer = GL_NONE;
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
-    if (term->gl_program != GL_NONE)
+    if (tilemap != NULL)
     {
-      GLD_CALL(glDeleteProgram(term->gl_program));
+      tilemap->reference_count++;
     }
-    if (term->gl_atlas_texture_2d_array != GL_NONE)
+    _rlhTilemapRelease(term->tilemap);
+    term->tilemap = tilemap;
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetCamera(rlhTerm_h const term, const int camera_pixel_x, const int camera_pixel_y)
+  {
+    if (term == NULL)
     {
-      GLD_CALL(glDeleteTextures(1, &term->gl_atlas_texture_2d_array));
-      term->gl_atlas_texture_2d_array = GL_NONE;
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
-    free(term);
+    term->camera_x = camera_pixel_x;
+    term->camera_y = camera_pixel_y;
+    return RLH_RESULT_OK;
   }
 
-  rlhresult_t rlhTermSetAtlas(rlhTerm_h const term, rlhAtlasCreateInfo_t *atlas_info)
+  rlhresult_t rlhTermSetGridMode(rlhTerm_h const term, const rlhbool_t enabled)
   {
     if (term == NULL)
     {
       return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
-    rlhresult_t result = _rlhAtlasInfoCheck(atlas_info);
+    if (!enabled)
+    {
+      _rlhTermDestroyGrid(term);
+      term->grid_mode = RLH_FALSE;
+      term->render_cache_stale = RLH_TRUE;
+      return RLH_RESULT_OK;
+    }
+    rlhresult_t result = _rlhTermResizeGrid(term);
     if (result != RLH_RESULT_OK)
     {
       return result;
     }
-    return _rlhTermSetAtlas(term, atlas_info);
+    term->grid_mode = RLH_TRUE;
+    return RLH_RESULT_OK;
   }
 
-  int rlhTermGetGlyphCount(rlhTerm_h const term)
+  rlhbool_t rlhTermGetGridMode(rlhTerm_h const term)
   {
     if (term == NULL)
     {
-      return 0;
+      return RLH_FALSE;
     }
-    return (int)term->glyph_count;
+    return term->grid_mode;
   }
 
-  float rlhTermGetPixelScale(rlhTerm_h const term)
+  rlhresult_t rlhTermSetCell(rlhTerm_h const term, const int grid_x, const int grid_y,
+                             const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg)
   {
     if (term == NULL)
     {
-      return 0.0f;
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
-    return term->pixel_scale;
+    if (
+        !term->grid_mode ||
+        grid_x < 0 ||
+        grid_y < 0 ||
+        (size_t)grid_x >= term->grid_tiles_wide ||
+        (size_t)grid_y >= term->grid_tiles_tall ||
+        glyph >= _rlhTermGetGlyphCount(term))
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    uint32_t *const cell = term->grid_cells + ((size_t)grid_y * term->grid_tiles_wide + (size_t)grid_x) * RLH_GRID_UINTS_PER_CELL;
+    cell[0] = glyph;
+    cell[1] = _rlhPackColorUint(fg);
+    cell[2] = _rlhPackColorUint(bg);
+    _rlhTermMarkGridChanged(term, grid_x, grid_y, grid_x + 1, grid_y + 1);
+    return RLH_RESULT_OK;
   }
 
-  void rlhTermGetTerminalSize(rlhTerm_h const term, int *const tiles_wide, int *const tiles_tall)
+  rlhresult_t rlhTermClearCells(rlhTerm_h const term)
   {
     if (term == NULL)
     {
-      return;
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
-    if (tiles_wide != NULL)
+    if (!term->grid_mode)
     {
-      *tiles_wide = (int)term->tiles_wide;
+      return RLH_RESULT_ERROR_INVALID_VALUE;
     }
-    if (tiles_tall != NULL)
+    memset(term->grid_cells, 0, term->grid_tiles_wide * term->grid_tiles_tall * RLH_GRID_UINTS_PER_CELL * sizeof(uint32_t));
+    _rlhTermMarkGridChanged(term, 0, 0, term->grid_tiles_wide, term->grid_tiles_tall);
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetOverdrawCulling(rlhTerm_h const term, const rlhbool_t enabled)
+  {
+    if (term == NULL)
     {
-      *tiles_tall = (int)term->tiles_tall;
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    term->overdraw_culling = enabled;
+    if (!enabled)
+    {
+      _rlhDeallocate(&term->allocator, term->cover_cells);
+      term->cover_cells = NULL;
+      term->cover_cell_capacity = 0;
     }
+    return RLH_RESULT_OK;
   }
 
-  void rlhTermGetScaledPixelSize(rlhTerm_h const term, int *const pixel_width, int *const pixel_height)
+  rlhbool_t rlhTermGetOverdrawCulling(rlhTerm_h const term)
   {
     if (term == NULL)
     {
-      return;
+      return RLH_FALSE;
     }
-    if (pixel_width != NULL)
+    return term->overdraw_culling;
+  }
+
+  rlhresult_t rlhTermSetRenderCache(rlhTerm_h const term, const rlhbool_t enabled)
+  {
+    if (term == NULL)
     {
-      *pixel_width = (int)term->scaled_pixel_width;
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
-    if (pixel_height != NULL)
+    if (!enabled)
     {
-      *pixel_height = (int)term->scaled_pixel_height;
+      _rlhTermDestroyRenderCache(term);
     }
+    term->render_cache = enabled;
+    term->render_cache_stale = RLH_TRUE;
+    return RLH_RESULT_OK;
   }
 
-  void rlhTermGetUnscaledPixelSize(rlhTerm_h const term, int *const pixel_width, int *const pixel_height)
+  rlhbool_t rlhTermGetRenderCache(rlhTerm_h const term)
   {
     if (term == NULL)
     {
+      return RLH_FALSE;
+    }
+    return term->render_cache;
+  }
+
+  static inline rlhbool_t _rlhTermHasPalette(rlhTerm_h const term)
+  {
+    return term->palette_changed || term->gl_palette_texture_2d != GL_NONE;
+  }
+
+  // Upload the palette of a terminal if it changed since the last draw, and bind it. Terminals that never
+  // set a palette bind no texture, so their indexed colors are transparent.
+  static inline void _rlhTermBindPalette(rlhTerm_h const term)
+  {
+    GLD_START();
+    if (term->palette_changed)
+    {
+      if (term->gl_palette_texture_2d == GL_NONE)
+      {
+        GLD_CALL(glGenTextures(1, &term->gl_palette_texture_2d));
+        _rlhBindTexture(RLH_PALETTE_TEXTURE_SLOT, term->gl_palette_texture_2d);
+        GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+        GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+        GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0));
+        GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+      }
+      _rlhBindTexture(RLH_PALETTE_TEXTURE_SLOT, term->gl_palette_texture_2d);
+      GLD_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, RLH_PALETTE_COLOR_COUNT, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, term->palette));
+      term->stats.bytes_uploaded += sizeof(term->palette);
+      term->palette_changed = RLH_FALSE;
+    }
+    _rlhBindTexture(RLH_PALETTE_TEXTURE_SLOT, term->gl_palette_texture_2d);
+  }
+
+  static inline rlhbool_t _rlhTermHasEffects(rlhTerm_h const term)
+  {
+    return term->effects_changed || term->gl_effect_table_buffer != GL_NONE;
+  }
+
+  // Upload the effect table of a terminal if it changed since the last draw, bind it, and set the effect
+  // uniforms of a tile program.
+  static inline void _rlhTermBindEffects(rlhTerm_h const term, const rlhProgram_s *const program)
+  {
+    GLD_START();
+    if (term->effects_changed)
+    {
+      if (term->gl_effect_table_buffer == GL_NONE)
+      {
+        GLD_CALL(glGenBuffers(1, &term->gl_effect_table_buffer));
+        GLD_CALL(glGenTextures(1, &term->gl_effect_table_texture_buffer));
+        GLD_CALL(glBindBuffer(GL_TEXTURE_BUFFER, term->gl_effect_table_buffer));
+        GLD_CALL(glBufferData(GL_TEXTURE_BUFFER, sizeof(term->effect_data), NULL, GL_DYNAMIC_DRAW));
+        _rlhBindTexture(RLH_EFFECT_TABLE_TEXTURE_SLOT, term->gl_effect_table_texture_buffer);
+        GLD_CALL(glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, term->gl_effect_table_buffer));
+      }
+      GLD_CALL(glBindBuffer(GL_TEXTURE_BUFFER, term->gl_effect_table_buffer));
+      GLD_CALL(glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(term->effect_data), term->effect_data));
+      term->stats.bytes_uploaded += sizeof(term->effect_data);
+      term->effects_changed = RLH_FALSE;
+    }
+    _rlhBindTexture(RLH_EFFECT_TABLE_TEXTURE_SLOT, term->gl_effect_table_texture_buffer);
+    GLD_CALL(glUniform1f(program->gl_time_uniform_location, term->effect_time));
+    GLD_CALL(glUniform2f(program->gl_tile_size_uniform_location, (float)term->tile_width, (float)term->tile_height));
+  }
+
+  // Bind the tile program and the textures of an atlas index of a terminal, and set its uniforms and blend mode.
+  static inline void _rlhTermBindTileProgram(rlhTerm_h const term, const size_t atlas_index,
+                                             const float *const matrix_4x4, const rlhblendmode_t blend_mode)
+  {
+    GLD_START();
+    rlhProgram_s *const program = (atlas_index == 0) ? term->program : term->atlas_programs[atlas_index];
+    rlhAtlas_h const atlas = (atlas_index == 0) ? term->atlas : term->atlases[atlas_index];
+    // Bind objects
+    _rlhUseProgram(program->gl_program);
+    // bind the atlas texture, the glyph table, and the palette
+    _rlhBindTexture(RLH_ATLAS_TEXTURE_SLOT, atlas->gl_texture_2d_array);
+    _rlhBindTexture(RLH_GLYPH_TABLE_TEXTURE_SLOT, atlas->gl_glyph_table_texture_buffer);
+    _rlhTermBindPalette(term);
+    _rlhTermBindEffects(term, program);
+    _rlhTermBindLightMap(term, program);
+    // set the matrix, terminal size, and atlas index uniforms
+    GLD_CALL(glUniformMatrix4fv(program->gl_matrix_uniform_location, 1, GL_TRUE, matrix_4x4));
+    GLD_CALL(glUniform2f(program->gl_term_size_uniform_location, (float)term->unscaled_pixel_width, (float)term->unscaled_pixel_height));
+    GLD_CALL(glUniform1i(program->gl_atlas_index_uniform_location, (GLint)atlas_index));
+    // set blend mode
+    _rlhSetBlend(blend_mode);
+  }
+
+  // Check if every grid cell that a tile touches is covered in the current generation. Tiles that reach
+  // outside of the grid cells are never covered.
+  static inline rlhbool_t _rlhTermIsTileCovered(rlhTerm_h const term, const rlhTileInstance_s *const tile,
+                                               const size_t cells_wide, const size_t cells_tall)
+  {
+    if (tile->pixel_x < 0 || tile->pixel_y < 0 || tile->pixel_w <= 0 || tile->pixel_h <= 0)
+      return RLH_FALSE;
+    const size_t first_x = (size_t)tile->pixel_x / term->tile_width;
+    const size_t first_y = (size_t)tile->pixel_y / term->tile_height;
+    const size_t last_x = ((size_t)tile->pixel_x + (size_t)tile->pixel_w - 1) / term->tile_width;
+    const size_t last_y = ((size_t)tile->pixel_y + (size_t)tile->pixel_h - 1) / term->tile_height;
+    if (last_x >= cells_wide || last_y >= cells_tall)
+      return RLH_FALSE;
+    for (size_t y = first_y; y <= last_y; y++)
+    {
+      const uint32_t *const row = term->cover_cells + y * cells_wide;
+      for (size_t x = first_x; x <= last_x; x++)
+      {
+        if (row[x] != term->cover_generation)
+          return RLH_FALSE;
+      }
+    }
+    return RLH_TRUE;
+  }
+
+  // Remove the tiles of the immediate layers of a terminal that are hidden under opaque grid tiles drawn
+  // after them. The tiles are walked from the last one drawn to the first, so each opaque grid tile
+  // covers its cell for every tile that is drawn before it, in its own layer and in the layers beneath.
+  static inline void _rlhTermCullOverdraw(rlhTerm_h const term)
+  {
+    if (!term->overdraw_culling)
+      return;
+    const size_t cells_wide = (term->unscaled_pixel_width + term->tile_width - 1) / term->tile_width;
+    const size_t cells_tall = (term->unscaled_pixel_height + term->tile_height - 1) / term->tile_height;
+    const size_t cell_count = cells_wide * cells_tall;
+    if (cell_count == 0)
       return;
+    if (cell_count > term->cover_cell_capacity)
+    {
+      uint32_t *const cover_cells = (uint32_t *)_rlhReallocate(&term->allocator, term->cover_cells, cell_count * sizeof(uint32_t));
+      if (cover_cells == NULL)
+        return; // drawing every tile is still correct
+      memset(cover_cells, 0, cell_count * sizeof(uint32_t));
+      term->cover_cells = cover_cells;
+      term->cover_cell_capacity = cell_count;
+      term->cover_generation = 0;
     }
-    if (pixel_width != NULL)
+    // cells of older generations are not covered, so the cells only have to be cleared when the generation wraps.
+    term->cover_generation++;
+    if (term->cover_generation == 0)
     {
-      *pixel_width = (int)term->unscaled_pixel_width;
+      memset(term->cover_cells, 0, term->cover_cell_capacity * sizeof(uint32_t));
+      term->cover_generation = 1;
     }
-    if (pixel_height != NULL)
+    const int tile_width = (int)term->tile_width;
+    const int tile_height = (int)term->tile_height;
+    for (size_t order_i = term->layer_count; order_i-- > 0;)
     {
-      *pixel_height = (int)term->unscaled_pixel_height;
+      rlhTermLayer_s *const layer = &term->layers[term->layer_draw_order[order_i]];
+      rlhTileBuffer_s *const tiles = &layer->tiles;
+      // retained layers keep the indices of their tiles, and persistent tile buffers are write only memory.
+      if (layer->mode != RLH_LAYER_IMMEDIATE || tiles->stream_mode == RLH_STREAM_PERSISTENT || tiles->vertex_data_tile_count == 0)
+        continue;
+      // kept tiles are moved to the end of the tile buffer in order, then back to the start.
+      const size_t tile_count = tiles->vertex_data_tile_count;
+      size_t kept_begin = tile_count;
+      for (size_t tile_i = tile_count; tile_i-- > 0;)
+      {
+        const rlhTileInstance_s *const tile = tiles->vertex_data + tile_i;
+        if (_rlhTermIsTileCovered(term, tile, cells_wide, cells_tall))
+        {
+          term->stats.tiles_overdrawn++;
+          continue;
+        }
+        uint8_t fg[4];
+        uint8_t bg[4];
+        _rlhTermGetTileColors(term, tile, fg, bg);
+        // the colors of a tile with an effect change without the tile.
+        if (
+            fg[3] == UINT8_MAX && bg[3] == UINT8_MAX && (tile->glyph & RLH_TILE_EFFECT_MASK) == 0 &&
+            tile->pixel_w == tile_width && tile->pixel_h == tile_height &&
+            tile->pixel_x >= 0 && tile->pixel_y >= 0 &&
+            tile->pixel_x % tile_width == 0 && tile->pixel_y % tile_height == 0)
+        {
+          const size_t cell_x = (size_t)(tile->pixel_x / tile_width);
+          const size_t cell_y = (size_t)(tile->pixel_y / tile_height);
+          if (cell_x < cells_wide && cell_y < cells_tall)
+          {
+            term->cover_cells[cell_y * cells_wide + cell_x] = term->cover_generation;
+          }
+        }
+        kept_begin--;
+        if (kept_begin != tile_i)
+        {
+          tiles->vertex_data[kept_begin] = *tile;
+        }
+      }
+      if (kept_begin == 0)
+        continue;
+      const size_t kept_count = tile_count - kept_begin;
+      memmove(tiles->vertex_data, tiles->vertex_data + kept_begin, _rlhGetVertexDataSize(kept_count));
+      tiles->vertex_data_tile_count = kept_count;
+      _rlhTileBufferClearDirtyTiles(tiles);
+      if (kept_count > 0)
+      {
+        _rlhTileBufferMarkTilesDirty(tiles, 0, kept_count);
+      }
     }
   }
 
-  void rlhTermGetTileSize(rlhTerm_h const term, int *const tile_width, int *const tile_height)
+  // Bind the vertex array of a tile buffer and stream the tile buffer to its vertex buffer. Returns the index of
+  // the first tile in the vertex buffer.
+  static inline size_t _rlhTileBufferBeginDraw(rlhTileBuffer_s *const tiles)
   {
-    if (term == NULL)
+    GLD_START();
+    // Create objects if they don't exist yet.
+    _rlhTileBufferCreateVertexArray(tiles);
+    _rlhBindVertexArray(tiles->gl_vertex_array);
+    GLD_CALL(glBindBuffer(GL_ARRAY_BUFFER, tiles->gl_vertex_buffer));
+    return _rlhTileBufferStreamVertexData(tiles);
+  }
+
+  // Stream a tile buffer to its vertex buffer and draw it with the bound tile program.
+  static inline void _rlhTileBufferDraw(rlhTileBuffer_s *const tiles)
+  {
+    GLD_START();
+    _rlhTileBufferSetVertexAttributes(tiles, _rlhTileBufferBeginDraw(tiles));
+    // DRAW!!! Each tile is one instance of a 4 vertex triangle strip. The corners of the strip come from
+    // gl_VertexID, so no index buffer is bound.
+    GLD_CALL(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, RLH_VERTICES_PER_TILE, tiles->vertex_data_tile_count));
+    _rlhTileBufferEndStreamSegment(tiles);
+  }
+
+  static inline void _rlhTermCallStatsHook(rlhTerm_h const term, const rlhstatsevent_t event)
+  {
+    if (_rlh_stats_hook != NULL)
+    {
+      _rlh_stats_hook(term, event, (term != NULL) ? &term->stats : NULL, _rlh_stats_hook_user_data);
+    }
+  }
+
+  // Read the results of the timer queries of a terminal that are done, oldest first, without waiting
+  // for the ones that are not.
+  static inline void _rlhTermReadGpuTimers(rlhTerm_h const term)
+  {
+    GLD_START();
+    while (term->timer_queries_pending > 0)
+    {
+      const size_t query_i = (term->timer_query_next + RLH_TIMER_QUERY_COUNT - term->timer_queries_pending) % RLH_TIMER_QUERY_COUNT;
+      GLint available = GL_FALSE;
+      GLD_CALL(glGetQueryObjectiv(term->gl_timer_queries[query_i], GL_QUERY_RESULT_AVAILABLE, &available));
+      if (!available)
+        return;
+      GLuint64 elapsed_ns = 0;
+      GLD_CALL(glGetQueryObjectui64v(term->gl_timer_queries[query_i], GL_QUERY_RESULT, &elapsed_ns));
+      term->timer_queries_pending--;
+      term->stats.gpu_time_ns = elapsed_ns;
+      term->stats.total_gpu_time_ns += elapsed_ns;
+      term->stats.timed_draws++;
+      _rlhTermCallStatsHook(term, RLH_STATS_GPU_TIME);
+    }
+  }
+
+  // Start timing a draw of a terminal. Returns false if timing is disabled, or if every timer query is
+  // still waiting for its result, in which case this draw is not timed.
+  static inline rlhbool_t _rlhTermBeginGpuTimer(rlhTerm_h const term)
+  {
+    if (!term->gpu_timing)
+      return RLH_FALSE;
+    _rlhTermReadGpuTimers(term);
+    if (term->timer_queries_pending == RLH_TIMER_QUERY_COUNT)
+      return RLH_FALSE;
+    GLD_START();
+    GLD_CALL(glBeginQuery(GL_TIME_ELAPSED, term->gl_timer_queries[term->timer_query_next]));
+    term->timer_query_next = (term->timer_query_next + 1) % RLH_TIMER_QUERY_COUNT;
+    term->timer_queries_pending++;
+    return RLH_TRUE;
+  }
+
+  static inline rlhbool_t _rlhTermHasTilemap(rlhTerm_h const term)
+  {
+    return term->tilemap != NULL;
+  }
+
+  // Rebuild the tiles of a tilemap chunk for the tile size and glyph count of a terminal. Empty cells
+  // and glyphs that the atlas does not have get no tile.
+  static inline rlhbool_t _rlhTilemapTryBuildChunk(rlhTilemapChunk_s *const chunk, rlhTerm_h const term)
+  {
+    rlhTileBuffer_s *const tiles = &chunk->tiles;
+    const size_t glyph_count = _rlhTermGetGlyphCount(term);
+    _rlhTileBufferClear(tiles);
+    if (!_rlhTileBufferTryReserveTiles(tiles, RLH_TILEMAP_CHUNK_CELLS * RLH_TILEMAP_CHUNK_CELLS))
+      return RLH_FALSE;
+    const int tile_width = (int)term->tile_width;
+    const int tile_height = (int)term->tile_height;
+    for (int cell_y = 0; cell_y < RLH_TILEMAP_CHUNK_CELLS; cell_y++)
+    {
+      const rlhTilemapCell_s *const row = chunk->cells + cell_y * RLH_TILEMAP_CHUNK_CELLS;
+      for (int cell_x = 0; cell_x < RLH_TILEMAP_CHUNK_CELLS; cell_x++)
+      {
+        const rlhTilemapCell_s *const cell = row + cell_x;
+        uint32_t colors[2];
+        memcpy(colors, cell->fg, sizeof(colors));
+        if ((cell->glyph == 0 && colors[0] == 0 && colors[1] == 0) || (cell->glyph & RLH_TILE_GLYPH_MASK) >= glyph_count)
+          continue;
+        _rlhTileBufferWriteTile(tiles, cell_x * tile_width, cell_y * tile_height, tile_width, tile_height, cell->glyph, cell->fg, cell->bg);
+      }
+    }
+    _rlhTileBufferMarkTilesDirty(tiles, 0, tiles->vertex_data_tile_count);
+    chunk->changed = RLH_FALSE;
+    chunk->built_tile_width = term->tile_width;
+    chunk->built_tile_height = term->tile_height;
+    chunk->built_glyph_count = glyph_count;
+    return RLH_TRUE;
+  }
+
+  // Delete the tiles and vertex buffer of a tilemap chunk. Its cells are kept, and it is built again the next
+  // time it is drawn.
+  static inline void _rlhTilemapEvictChunk(rlhTilemap_h const tilemap, rlhTilemapChunk_s *const chunk)
+  {
+    _rlhTileBufferDestroy(&chunk->tiles);
+    memset(&chunk->tiles, 0, sizeof(chunk->tiles));
+    chunk->tiles.allocator = &tilemap->allocator;
+    chunk->changed = RLH_TRUE;
+    tilemap->resident_chunk_count--;
+  }
+
+  // Evict the least recently drawn chunks of a tilemap until it is within RLH_TILEMAP_CHUNK_BUDGET. The
+  // chunks of the current draw are never evicted.
+  static inline void _rlhTilemapEvictChunks(rlhTilemap_h const tilemap)
+  {
+    while (tilemap->resident_chunk_count > RLH_TILEMAP_CHUNK_BUDGET)
+    {
+      rlhTilemapChunk_s *oldest = NULL;
+      for (size_t chunk_i = 0; chunk_i < tilemap->chunks_wide * tilemap->chunks_tall; chunk_i++)
+      {
+        rlhTilemapChunk_s *const chunk = tilemap->chunks + chunk_i;
+        if (chunk->tiles.gl_vertex_buffer != GL_NONE && chunk->drawn_tick != tilemap->draw_tick &&
+            (oldest == NULL || chunk->drawn_tick < oldest->drawn_tick))
+          oldest = chunk;
+      }
+      if (oldest == NULL)
+        return;
+      _rlhTilemapEvictChunk(tilemap, oldest);
+    }
+  }
+
+  // Draw the chunks of the tilemap of a terminal that are inside of the terminal at its camera position,
+  // with the tile program clipped to the terminal. Each chunk is moved into place by the offset uniform.
+  static inline void _rlhTermDrawTilemap(rlhTerm_h const term, const float *const matrix_4x4, const rlhblendmode_t blend_mode)
+  {
+    rlhTilemap_h const tilemap = term->tilemap;
+    if (tilemap == NULL)
+      return;
+    GLD_START();
+    const int chunk_width = RLH_TILEMAP_CHUNK_CELLS * (int)term->tile_width;
+    const int chunk_height = RLH_TILEMAP_CHUNK_CELLS * (int)term->tile_height;
+    const int first_chunk_x = MAX(term->camera_x, 0) / chunk_width;
+    const int first_chunk_y = MAX(term->camera_y, 0) / chunk_height;
+    const int end_pixel_x = term->camera_x + (int)term->unscaled_pixel_width;
+    const int end_pixel_y = term->camera_y + (int)term->unscaled_pixel_height;
+    if (end_pixel_x <= 0 || end_pixel_y <= 0)
+      return;
+    const size_t end_chunk_x = MIN((size_t)((end_pixel_x + chunk_width - 1) / chunk_width), tilemap->chunks_wide);
+    const size_t end_chunk_y = MIN((size_t)((end_pixel_y + chunk_height - 1) / chunk_height), tilemap->chunks_tall);
+    // the clip planes are already enabled when the terminal is drawn on its own in a batch.
+    const rlhbool_t clip_planes = _rlh_gl_state.clip_planes;
+    rlhbool_t program_bound = RLH_FALSE;
+    tilemap->draw_tick++;
+    for (size_t chunk_y = (size_t)first_chunk_y; chunk_y < end_chunk_y; chunk_y++)
+    {
+      for (size_t chunk_x = (size_t)first_chunk_x; chunk_x < end_chunk_x; chunk_x++)
+      {
+        rlhTilemapChunk_s *const chunk = tilemap->chunks + chunk_y * tilemap->chunks_wide + chunk_x;
+        if (chunk->cells == NULL)
+          continue;
+        if (
+            (chunk->changed || chunk->built_tile_width != term->tile_width || chunk->built_tile_height != term->tile_height ||
+             chunk->built_glyph_count != _rlhTermGetGlyphCount(term)) &&
+            !_rlhTilemapTryBuildChunk(chunk, term))
+          continue;
+        if (chunk->tiles.vertex_data_tile_count == 0)
+          continue;
+        if (!program_bound)
+        {
+          _rlhTermBindTileProgram(term, 0, matrix_4x4, blend_mode);
+          _rlhSetClipPlanes(RLH_TRUE);
+          program_bound = RLH_TRUE;
+        }
+        GLD_CALL(glUniform2f(term->program->gl_offset_uniform_location,
+                             (float)((int)chunk_x * chunk_width - term->camera_x),
+                             (float)((int)chunk_y * chunk_height - term->camera_y)));
+        const rlhbool_t resident = chunk->tiles.gl_vertex_buffer != GL_NONE;
+        _rlhTileBufferDraw(&chunk->tiles);
+        if (!resident && chunk->tiles.gl_vertex_buffer != GL_NONE)
+          tilemap->resident_chunk_count++;
+        chunk->drawn_tick = tilemap->draw_tick;
+        term->stats.bytes_uploaded += chunk->tiles.uploaded_byte_count;
+        term->stats.draw_calls++;
+        chunk->tiles.uploaded_byte_count = 0;
+        // the chunk is built again from its cells when it changes, so its tiles only stay in the vertex buffer.
+        _rlhDeallocate(chunk->tiles.allocator, chunk->tiles.vertex_data);
+        chunk->tiles.vertex_data = NULL;
+        chunk->tiles.vertex_data_tile_capacity = 0;
+      }
+    }
+    if (program_bound)
     {
+      _rlhSetClipPlanes(clip_planes);
+      GLD_CALL(glUniform2f(term->program->gl_offset_uniform_location, 0.0f, 0.0f));
+    }
+    _rlhTilemapEvictChunks(tilemap);
+  }
+
+  // Make sure the scratch memory for sorting the tiles of a layer by atlas has room for the grid cells of a
+  // terminal and a tile count.
+  static inline rlhbool_t _rlhTermTryReserveAtlasSort(rlhTerm_h const term, const size_t cell_count, const size_t tile_count)
+  {
+    const size_t size = (cell_count + 2 * tile_count + 1) * sizeof(uint32_t) + _rlhGetVertexDataSize(tile_count);
+    if (size <= term->atlas_sort_size)
+      return RLH_TRUE;
+    void *const atlas_sort_data = _rlhReallocate(&term->allocator, term->atlas_sort_data, size);
+    if (atlas_sort_data == NULL)
+      return RLH_FALSE;
+    term->atlas_sort_data = atlas_sort_data;
+    term->atlas_sort_size = size;
+    return RLH_TRUE;
+  }
+
+  // Sort the tiles of a tile buffer into groups of tiles that share an atlas. A tile only moves ahead of
+  // tiles of other atlases that touch none of its grid cells, so tiles that overlap are still drawn in the
+  // order that they were pushed. Each cell remembers the last group drawn over it, and a tile joins the
+  // last group of its atlas unless a later group touched one of its cells.
+  static inline void _rlhTermSortTilesByAtlas(rlhTerm_h const term, rlhTileBuffer_s *const tiles)
+  {
+    const size_t tile_count = tiles->vertex_data_tile_count;
+    const int cells_wide = (int)((term->unscaled_pixel_width + term->tile_width - 1) / term->tile_width);
+    const int cells_tall = (int)((term->unscaled_pixel_height + term->tile_height - 1) / term->tile_height);
+    if (tile_count < 2 || cells_wide <= 0 || cells_tall <= 0)
       return;
+    const size_t cell_count = (size_t)cells_wide * (size_t)cells_tall;
+    if (!_rlhTermTryReserveAtlasSort(term, cell_count, tile_count))
+      return; // drawing the tiles in runs of the same atlas is still correct
+    uint32_t *const cell_groups = (uint32_t *)term->atlas_sort_data;
+    uint32_t *const tile_groups = cell_groups + cell_count;
+    uint32_t *const group_ends = tile_groups + tile_count;
+    rlhTileInstance_s *const sorted_tiles = (rlhTileInstance_s *)(group_ends + tile_count + 1);
+    memset(cell_groups, 0, cell_count * sizeof(uint32_t));
+    // the groups are numbered from 1, so that 0 is no group
+    uint32_t last_groups[RLH_MAX_TERM_ATLASES] = {0};
+    uint32_t group_count = 0;
+    rlhbool_t sorted = RLH_TRUE;
+    const int tile_width = (int)term->tile_width;
+    const int tile_height = (int)term->tile_height;
+    for (size_t tile_i = 0; tile_i < tile_count; tile_i++)
+    {
+      const rlhTileInstance_s *const tile = tiles->vertex_data + tile_i;
+      // the parts of tiles outside of the grid cells are clamped to the cells on its edge, which only
+      // makes them touch more tiles.
+      const int pixel_w = MAX((int)tile->pixel_w, 1);
+      const int pixel_h = MAX((int)tile->pixel_h, 1);
+      const int first_x = MIN(MAX((int)tile->pixel_x, 0) / tile_width, cells_wide - 1);
+      const int first_y = MIN(MAX((int)tile->pixel_y, 0) / tile_height, cells_tall - 1);
+      const int last_x = MIN(MAX(tile->pixel_x + pixel_w - 1, 0) / tile_width, cells_wide - 1);
+      const int last_y = MIN(MAX(tile->pixel_y + pixel_h - 1, 0) / tile_height, cells_tall - 1);
+      uint32_t touched_group = 0;
+      for (int y = first_y; y <= last_y; y++)
+      {
+        const uint32_t *const row = cell_groups + (size_t)y * (size_t)cells_wide;
+        for (int x = first_x; x <= last_x; x++)
+        {
+          touched_group = MAX(touched_group, row[x]);
+        }
+      }
+      const size_t atlas_index = (tile->glyph & RLH_TILE_ATLAS_MASK) >> RLH_TILE_ATLAS_SHIFT;
+      uint32_t group = last_groups[atlas_index];
+      if (group == 0 || group < touched_group)
+      {
+        group = ++group_count;
+        group_ends[group] = 0;
+        last_groups[atlas_index] = group;
+      }
+      sorted = sorted && (tile_i == 0 || group >= tile_groups[tile_i - 1]);
+      tile_groups[tile_i] = group;
+      group_ends[group]++;
+      for (int y = first_y; y <= last_y; y++)
+      {
+        uint32_t *const row = cell_groups + (size_t)y * (size_t)cells_wide;
+        for (int x = first_x; x <= last_x; x++)
+        {
+          row[x] = group;
+        }
+      }
     }
-    if (tile_width != NULL)
+    if (sorted)
+      return;
+    // turn the tile counts of the groups into the index where each group starts, and move the tiles there.
+    group_ends[0] = 0;
+    for (uint32_t group_i = 1; group_i <= group_count; group_i++)
     {
-      *tile_width = (int)term->tile_width;
+      group_ends[group_i] += group_ends[group_i - 1];
     }
-    if (tile_height != NULL)
+    for (size_t tile_i = tile_count; tile_i-- > 0;)
     {
-      *tile_height = (int)term->tile_height;
+      sorted_tiles[--group_ends[tile_groups[tile_i]]] = tiles->vertex_data[tile_i];
     }
+    memcpy(tiles->vertex_data, sorted_tiles, _rlhGetVertexDataSize(tile_count));
+    _rlhTileBufferMarkTilesDirty(tiles, 0, tile_count);
   }
 
-  rlhresult_t rlhTermSetSize(rlhTerm_h const term, rlhTermSizeInfo_t *const size_info)
+  // Draw the tiles of a layer of a terminal that binds more than one atlas, with a draw call for each run
+  // of tiles that share an atlas. The tiles of immediate layers are grouped by atlas first to make the runs
+  // as long as they can be.
+  static inline void _rlhTermDrawLayerAtlases(rlhTerm_h const term, rlhTermLayer_s *const layer,
+                                              const float *const matrix_4x4, const rlhblendmode_t blend_mode)
   {
-    if (term == NULL || size_info == NULL)
+    rlhTileBuffer_s *const tiles = &layer->tiles;
+    if (layer->mode == RLH_LAYER_IMMEDIATE && tiles->stream_mode != RLH_STREAM_PERSISTENT)
     {
-      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+      _rlhTermSortTilesByAtlas(term, tiles);
     }
-    rlhresult_t result = _rlhSizeInfoCheck(size_info);
-    if (result != RLH_RESULT_OK)
+    GLD_START();
+    const size_t first_tile = _rlhTileBufferBeginDraw(tiles);
+    const size_t tile_count = tiles->vertex_data_tile_count;
+    _rlhTileBufferSetVertexAttributes(tiles, first_tile);
+    if (tiles->stream_mode == RLH_STREAM_PERSISTENT)
     {
-      return result;
+      // the mapped memory is write only, so every bound atlas draws the whole layer and the vertex shader
+      // drops the tiles of the other atlases.
+      for (size_t atlas_i = 0; atlas_i < RLH_MAX_TERM_ATLASES; atlas_i++)
+      {
+        if (atlas_i != 0 && (term->atlases[atlas_i] == NULL || !rlhAtlasIsReady(term->atlases[atlas_i])))
+          continue;
+        _rlhTermBindTileProgram(term, atlas_i, matrix_4x4, blend_mode);
+        GLD_CALL(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, RLH_VERTICES_PER_TILE, tile_count));
+        term->stats.draw_calls++;
+      }
+      _rlhTileBufferEndStreamSegment(tiles);
+      return;
     }
-    _rlhTermSetPixelSize(
-        term,
-        size_info);
+    size_t run_begin = 0;
+    while (run_begin < tile_count)
+    {
+      const uint32_t atlas_bits = tiles->vertex_data[run_begin].glyph & RLH_TILE_ATLAS_MASK;
+      size_t run_end = run_begin + 1;
+      while (run_end < tile_count && (tiles->vertex_data[run_end].glyph & RLH_TILE_ATLAS_MASK) == atlas_bits)
+      {
+        run_end++;
+      }
+      const size_t atlas_index = atlas_bits >> RLH_TILE_ATLAS_SHIFT;
+      // tiles of an atlas that was unbound, or that is still uploading, are skipped.
+      if (atlas_index == 0 || (term->atlases[atlas_index] != NULL && rlhAtlasIsReady(term->atlases[atlas_index])))
+      {
+        _rlhTermBindTileProgram(term, atlas_index, matrix_4x4, blend_mode);
+        _rlhTileBufferSetVertexAttributes(tiles, first_tile + run_begin);
+        GLD_CALL(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, RLH_VERTICES_PER_TILE, run_end - run_begin));
+        term->stats.draw_calls++;
+      }
+      run_begin = run_end;
+    }
+    _rlhTileBufferEndStreamSegment(tiles);
   }
 
-  rlhresult_t rlhTermClearTileData(rlhTerm_h term)
+  // Draw the cell grid, the tilemap, and then the layers of a terminal in their draw order.
+  static inline void _rlhTermDrawLayers(rlhTerm_h const term, const float *const matrix_4x4, const rlhblendmode_t blend_mode)
   {
-    if (term == NULL)
+    _rlhTermDrawGrid(term, matrix_4x4, blend_mode);
+    _rlhTermDrawTilemap(term, matrix_4x4, blend_mode);
+    rlhbool_t program_bound = RLH_FALSE;
+    for (size_t order_i = 0; order_i < term->layer_count; order_i++)
     {
-      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+      rlhTermLayer_s *const layer = &term->layers[term->layer_draw_order[order_i]];
+      if (layer->tiles.vertex_data_tile_count == 0)
+        continue;
+      if (term->extra_atlas_count > 0)
+      {
+        _rlhTermDrawLayerAtlases(term, layer, matrix_4x4, blend_mode);
+      }
+      else
+      {
+        if (!program_bound)
+        {
+          _rlhTermBindTileProgram(term, 0, matrix_4x4, blend_mode);
+          program_bound = RLH_TRUE;
+        }
+        _rlhTileBufferDraw(&layer->tiles);
+        term->stats.draw_calls++;
+      }
+      term->stats.bytes_uploaded += layer->tiles.uploaded_byte_count;
+      layer->tiles.uploaded_byte_count = 0;
+      if (layer->mode == RLH_LAYER_IMMEDIATE)
+      {
+        _rlhTileBufferClear(&layer->tiles);
+      }
     }
-    term->vertex_data_tile_count = 0;
-    return RLH_RESULT_OK;
   }
 
-  int rlhTermGetTileDataCount(rlhTerm_h const term)
+  // Hash the tiles of a tile buffer, to find out if an immediate layer got the same tiles as the last time
+  // that the render cache was drawn.
+  static inline uint64_t _rlhTileBufferHash(const rlhTileBuffer_s *const tiles)
   {
-    if (term == NULL)
+    uint64_t hash = 0;
+    for (size_t tile_i = 0; tile_i < tiles->vertex_data_tile_count; tile_i++)
     {
-      return 0;
+      uint32_t words[sizeof(rlhTileInstance_s) / sizeof(uint32_t)];
+      memcpy(words, &tiles->vertex_data[tile_i], sizeof(words));
+      for (size_t word_i = 0; word_i < sizeof(words) / sizeof(uint32_t); word_i++)
+      {
+        hash = (hash ^ words[word_i]) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 32;
+      }
     }
-    return (int)term->vertex_data_tile_count;
+    return hash;
   }
 
-  static inline rlhbool_t _rlhTermTryReserveVertexData(rlhTerm_h const term)
+  // Check if the tiles, cell grid, tilemap, camera, size, atlas, or effect time of a terminal changed since its render
+  // cache was drawn.
+  static inline rlhbool_t _rlhTermIsRenderCacheStale(rlhTerm_h const term)
   {
-    // If we hit the reserved tile count, double the amount of reserved space.
-    if (term->vertex_data_tile_count < term->vertex_data_tile_capacity)
+    if (term->render_cache_stale ||
+        term->gl_render_cache_width != term->scaled_pixel_width ||
+        term->gl_render_cache_height != term->scaled_pixel_height)
       return RLH_TRUE;
-    size_t new_capacity = (term->vertex_data_tile_capacity == 0) ? 8 : term->vertex_data_tile_capacity * 2;
-    float *new_vertex_data = (float *)realloc(
-        term->vertex_data,
-        _rlhGetVertexDataSize(new_capacity));
-    if (new_vertex_data == NULL)
+    // an atlas that is still uploading looks different once it is ready.
+    if (term->atlas != term->render_cache_atlas ||
+        term->atlas->version != term->render_cache_atlas_version ||
+        !rlhAtlasIsReady(term->atlas))
+      return RLH_TRUE;
+    for (size_t atlas_i = 1; atlas_i < RLH_MAX_TERM_ATLASES; atlas_i++)
     {
-      return RLH_FALSE; // out of memory
+      rlhAtlas_h const atlas = term->atlases[atlas_i];
+      if (atlas != term->render_cache_atlases[atlas_i] ||
+          (atlas != NULL && (atlas->version != term->render_cache_atlas_versions[atlas_i] || !rlhAtlasIsReady(atlas))))
+        return RLH_TRUE;
     }
-    term->vertex_data = new_vertex_data;
-    term->vertex_data_tile_capacity = new_capacity;
-    return RLH_TRUE;
-  }
-
-  static inline void _rlhTermPushTile(rlhTerm_h const term, const int pixel_x, const int pixel_y,
-                                      const int pixel_w, const int pixel_h, const uint16_t glyph,
-                                      const rlhColor_s fg, const rlhColor_s bg)
-  {
-    if (glyph > term->glyph_count)
-      return;
-    if (!(
-            pixel_x + pixel_w > 0 &&
-            pixel_x < term->unscaled_pixel_width &&
-            pixel_y + pixel_h > 0 &&
-            pixel_y < term->unscaled_pixel_height))
+    if (_rlhTermHasEffects(term) && term->effect_time != term->render_cache_effect_time)
+      return RLH_TRUE;
+    if (term->tilemap != term->render_cache_tilemap ||
+        (_rlhTermHasTilemap(term) &&
+         (term->tilemap->version != term->render_cache_tilemap_version ||
+          term->camera_x != term->render_cache_camera_x || term->camera_y != term->render_cache_camera_y)))
+      return RLH_TRUE;
+    if (_rlhTermHasGrid(term) && (term->grid_resized || term->grid_cells_changed))
+      return RLH_TRUE;
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
     {
-      return;
+      const rlhTermLayer_s *const layer = &term->layers[layer_i];
+      const rlhTileBuffer_s *const tiles = &layer->tiles;
+      if (tiles->vertex_data_tile_count != tiles->render_cache_tile_count)
+        return RLH_TRUE;
+      if (layer->mode == RLH_LAYER_RETAINED)
+      {
+        if (_rlhTileBufferHasDirtyTiles(tiles))
+          return RLH_TRUE;
+        continue;
+      }
+      if (tiles->vertex_data_tile_count == 0)
+        continue;
+      // the tiles of the persistent stream mode are written to mapped memory that is too slow to read back.
+      if (tiles->stream_mode == RLH_STREAM_PERSISTENT || _rlhTileBufferHash(tiles) != tiles->render_cache_tile_hash)
+        return RLH_TRUE;
     }
-    float position_s = (float)pixel_x / (float)term->unscaled_pixel_width;
-    float position_t = position_s + ((float)pixel_w / (float)term->unscaled_pixel_width);
-    float position_p = (float)pixel_y / (float)term->unscaled_pixel_height;
-    float position_q = position_p + ((float)pixel_h / (float)term->unscaled_pixel_height);
-    size_t glyph_stpqp_i = glyph * RLH_FONTMAP_COORDINATES_PER_GLYPH;
-    const float atlas_s = term->glyph_stpqp[glyph_stpqp_i++];
-    const float atlas_t = term->glyph_stpqp[glyph_stpqp_i++];
-    const float atlas_p = term->glyph_stpqp[glyph_stpqp_i++];
-    const float atlas_q = term->glyph_stpqp[glyph_stpqp_i++];
-    const float atlas_page = term->glyph_stpqp[glyph_stpqp_i];
-    size_t index = _rlhGetVertexAttributeCount(term->vertex_data_tile_count);
-    // v0
-    term->vertex_data[index++] = position_s;
-    term->vertex_data[index++] = position_p;
-    term->vertex_data[index++] = atlas_s;
-    term->vertex_data[index++] = atlas_p;
-    term->vertex_data[index++] = atlas_page;
-    term->vertex_data[index++] = fg.r;
-    term->vertex_data[index++] = fg.g;
-    term->vertex_data[index++] = fg.b;
-    term->vertex_data[index++] = fg.a;
-    term->vertex_data[index++] = bg.r;
-    term->vertex_data[index++] = bg.g;
-    term->vertex_data[index++] = bg.b;
-    term->vertex_data[index++] = bg.a;
-    // v1
-    term->vertex_data[index++] = position_t;
-    term->vertex_data[index++] = position_p;
-    term->vertex_data[index++] = atlas_t;
-    term->vertex_data[index++] = atlas_p;
-    term->vertex_data[index++] = atlas_page;
-    term->vertex_data[index++] = fg.r;
-    term->vertex_data[index++] = fg.g;
-    term->vertex_data[index++] = fg.b;
-    term->vertex_data[index++] = fg.a;
-    term->vertex_data[index++] = bg.r;
-    term->vertex_data[index++] = bg.g;
-    term->vertex_data[index++] = bg.b;
-    term->vertex_data[index++] = bg.a;
-    // v2
-    term->vertex_data[index++] = position_s;
-    term->vertex_data[index++] = position_q;
-    term->vertex_data[index++] = atlas_s;
-    term->vertex_data[index++] = atlas_q;
-    term->vertex_data[index++] = atlas_page;
-    term->vertex_data[index++] = fg.r;
-    term->vertex_data[index++] = fg.g;
-    term->vertex_data[index++] = fg.b;
-    term->vertex_data[index++] = fg.a;
-    term->vertex_data[index++] = bg.r;
-    term->vertex_data[index++] = bg.g;
-    term->vertex_data[index++] = bg.b;
-    term->vertex_data[index++] = bg.a;
-    // v3
-    term->vertex_data[index++] = position_t;
-    term->vertex_data[index++] = position_q;
-    term->vertex_data[index++] = atlas_t;
-    term->vertex_data[index++] = atlas_q;
-    term->vertex_data[index++] = atlas_page;
-    term->vertex_data[index++] = fg.r;
-    term->vertex_data[index++] = fg.g;
-    term->vertex_data[index++] = fg.b;
-    term->vertex_data[index++] = fg.a;
-    term->vertex_data[index++] = bg.r;
-    term->vertex_data[index++] = bg.g;
-    term->vertex_data[index++] = bg.b;
-    term->vertex_data[index] = bg.a;
-    term->vertex_data_tile_count++;
-    term->vertex_data_changed = RLH_TRUE;
-  }
-
-  rlhresult_t rlhTermPushFill(rlhTerm_h const term, const uint16_t glyph, const rlhColor_s fg,
-                              const rlhColor_s bg)
-  {
-    if (!_rlhTermTryReserveVertexData(term))
-      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
-    _rlhTermPushTile(term, 0, 0, term->unscaled_pixel_width, term->unscaled_pixel_height, glyph, fg, bg);
-    return RLH_RESULT_OK;
+    return RLH_FALSE;
   }
 
-  rlhresult_t rlhTermPushGrid(rlhTerm_h const term, const int grid_x, const int grid_y,
-                              const uint16_t glyph, const rlhColor_s fg,
-                              const rlhColor_s bg)
+  // Create the render cache texture of a terminal in the scaled pixel size of the terminal, and attach it to
+  // the bound framebuffer.
+  static inline rlhbool_t _rlhTermResizeRenderCache(rlhTerm_h const term)
   {
-    const int pixel_x = grid_x * term->tile_width * term->pixel_scale;
-    const int pixel_y = grid_y * term->tile_height * term->pixel_scale;
-    if (!_rlhTermTryReserveVertexData(term))
-      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
-    _rlhTermPushTile(term, pixel_x, pixel_y, term->tile_width * term->pixel_scale, term->tile_height * term->pixel_scale, glyph, fg, bg);
-    return RLH_RESULT_OK;
+    GLD_START();
+    _rlhBindTexture(RLH_RENDER_CACHE_TEXTURE_SLOT, term->gl_render_cache_texture_2d);
+    GLD_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, term->scaled_pixel_width, term->scaled_pixel_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL));
+    GLD_CALL(glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, term->gl_render_cache_texture_2d, 0));
+    GLenum status = GL_NONE;
+    GLD_CALL(status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER));
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+      return RLH_FALSE;
+    term->gl_render_cache_width = term->scaled_pixel_width;
+    term->gl_render_cache_height = term->scaled_pixel_height;
+    return RLH_TRUE;
   }
 
-  rlhresult_t rlhTermPushGridSized(rlhTerm_h const term, const int grid_x, const int grid_y,
-                                   const int tile_pixel_width, const int tile_pixel_height,
-                                   const uint16_t glyph, const rlhColor_s fg,
-                                   const rlhColor_s bg)
+  // Draw a terminal into its render cache if it changed since the render cache was drawn. Returns RLH_FALSE
+  // if the render cache can not be used, in which case the terminal is drawn without it.
+  static inline rlhbool_t _rlhTermUpdateRenderCache(rlhTerm_h const term)
   {
-    if (!_rlhTermTryReserveVertexData(term))
-      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
-    const unsigned int pixel_x = (unsigned int)grid_x * term->tile_width * term->pixel_scale;
-    const unsigned int pixel_y = (unsigned int)grid_y * term->tile_height * term->pixel_scale;
-    const unsigned int pixel_w_u = (unsigned int)tile_pixel_width * term->pixel_scale;
-    const unsigned int pixel_h_u = (unsigned int)tile_pixel_height * term->pixel_scale;
-    _rlhTermPushTile(term, pixel_x, pixel_y, pixel_w_u, pixel_h_u, glyph, fg, bg);
-    return RLH_RESULT_OK;
+    if (term->scaled_pixel_width == 0 || term->scaled_pixel_height == 0)
+      return RLH_FALSE;
+    if (!_rlhTermIsRenderCacheStale(term))
+    {
+      // the tiles of immediate layers are used up by every draw, even when they are not drawn again.
+      for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+      {
+        if (term->layers[layer_i].mode == RLH_LAYER_IMMEDIATE)
+        {
+          _rlhTileBufferClear(&term->layers[layer_i].tiles);
+        }
+      }
+      term->stats.cached_draws++;
+      return RLH_TRUE;
+    }
+    GLD_START();
+    if (term->gl_render_cache_texture_2d == GL_NONE)
+    {
+      GLD_CALL(glGenFramebuffers(1, &term->gl_render_cache_framebuffer));
+      GLD_CALL(glGenVertexArrays(1, &term->gl_render_cache_vertex_array));
+      GLD_CALL(glGenTextures(1, &term->gl_render_cache_texture_2d));
+      _rlhBindTexture(RLH_RENDER_CACHE_TEXTURE_SLOT, term->gl_render_cache_texture_2d);
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0));
+      GLD_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+      term->render_cache_program = _rlhAcquireProgram(&_rlh_render_cache_program, RLH_FRAGMENT_NONE, RLH_RENDER_CACHE_VERTEX_SOURCE, RLH_FRAGMENT_RENDER_CACHE_SOURCE);
+    }
+    // save the framebuffer, viewport and scissor test of the caller
+    GLint previous_framebuffer = 0;
+    GLint previous_viewport[4];
+    GLboolean previous_scissor_test = GL_FALSE;
+    GLD_CALL(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer));
+    GLD_CALL(glGetIntegerv(GL_VIEWPORT, previous_viewport));
+    GLD_CALL(glGetBooleanv(GL_SCISSOR_TEST, &previous_scissor_test));
+    GLD_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, term->gl_render_cache_framebuffer));
+    if ((term->gl_render_cache_width != term->scaled_pixel_width || term->gl_render_cache_height != term->scaled_pixel_height) &&
+        !_rlhTermResizeRenderCache(term))
+    {
+      // the context can not draw into the texture, so stop trying.
+      GLD_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)previous_framebuffer));
+      _rlhTermDestroyRenderCache(term);
+      term->render_cache = RLH_FALSE;
+      return RLH_FALSE;
+    }
+    _rlh_gl_state.scissor_test = previous_scissor_test ? RLH_TRUE : RLH_FALSE;
+    _rlhSetScissorTest(RLH_FALSE);
+    GLD_CALL(glViewport(0, 0, term->scaled_pixel_width, term->scaled_pixel_height));
+    const GLfloat transparent[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    GLD_CALL(glClearBufferfv(GL_COLOR, 0, transparent));
+    // remember what is drawn before the tiles of immediate layers are used up by the draw
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+    {
+      rlhTermLayer_s *const layer = &term->layers[layer_i];
+      layer->tiles.render_cache_tile_count = layer->tiles.vertex_data_tile_count;
+      if (layer->mode == RLH_LAYER_IMMEDIATE && layer->tiles.stream_mode != RLH_STREAM_PERSISTENT)
+      {
+        layer->tiles.render_cache_tile_hash = _rlhTileBufferHash(&layer->tiles);
+      }
+    }
+    term->render_cache_atlas = term->atlas;
+    term->render_cache_atlas_version = term->atlas->version;
+    for (size_t atlas_i = 1; atlas_i < RLH_MAX_TERM_ATLASES; atlas_i++)
+    {
+      term->render_cache_atlases[atlas_i] = term->atlases[atlas_i];
+      term->render_cache_atlas_versions[atlas_i] = (term->atlases[atlas_i] != NULL) ? term->atlases[atlas_i]->version : 0;
+    }
+    term->render_cache_effect_time = term->effect_time;
+    term->render_cache_tilemap = term->tilemap;
+    term->render_cache_tilemap_version = (term->tilemap != NULL) ? term->tilemap->version : 0;
+    term->render_cache_camera_x = term->camera_x;
+    term->render_cache_camera_y = term->camera_y;
+    term->render_cache_stale = RLH_FALSE;
+    _rlhTermDrawLayers(term, RLH_OPENGL_SCREEN_MATRIX, RLH_BLEND_RENDER_CACHE);
+    GLD_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)previous_framebuffer));
+    GLD_CALL(glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]));
+    _rlhSetScissorTest(previous_scissor_test ? RLH_TRUE : RLH_FALSE);
+    return RLH_TRUE;
   }
 
-  rlhresult_t rlhTermPushFree(rlhTerm_h const term, const int screen_pixel_x,
-                              const int screen_pixel_y, const uint16_t glyph,
-                              const rlhColor_s fg, const rlhColor_s bg)
+  // Draw the render cache of a terminal with a single quad.
+  static inline void _rlhTermDrawRenderCache(rlhTerm_h const term, const float *const matrix_4x4)
   {
-    if (!_rlhTermTryReserveVertexData(term))
-      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
-    _rlhTermPushTile(term, (unsigned int)screen_pixel_x * term->pixel_scale, (unsigned int)screen_pixel_y * term->pixel_scale,
-                     term->tile_width * term->pixel_scale, term->tile_height * term->pixel_scale, glyph, fg, bg);
-    return RLH_RESULT_OK;
+    GLD_START();
+    _rlhBindVertexArray(term->gl_render_cache_vertex_array);
+    _rlhUseProgram(term->render_cache_program->gl_program);
+    _rlhBindTexture(RLH_RENDER_CACHE_TEXTURE_SLOT, term->gl_render_cache_texture_2d);
+    GLD_CALL(glUniformMatrix4fv(term->render_cache_program->gl_matrix_uniform_location, 1, GL_TRUE, matrix_4x4));
+    _rlhSetBlend(RLH_BLEND_PREMULTIPLIED);
+    GLD_CALL(glDrawArrays(GL_TRIANGLE_STRIP, 0, RLH_VERTICES_PER_TILE));
+    term->stats.draw_calls++;
   }
 
-  rlhresult_t rlhTermPushFreeSized(rlhTerm_h const term, const int screen_pixel_x,
-                                   const int screen_pixel_y, const int tile_pixel_width,
-                                   const int tile_pixel_height, const uint16_t glyph,
-                                   const rlhColor_s fg, const rlhColor_s bg)
+  // Draw a terminal, and return the result of appending its published frame. The terminal is drawn even
+  // if that failed.
+  static inline rlhresult_t _rlhTermDrawMatrix(rlhTerm_h const term, const float *const matrix_4x4)
   {
-    if (!_rlhTermTryReserveVertexData(term))
-      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
-    _rlhTermPushTile(term, screen_pixel_x * term->pixel_scale, screen_pixel_y * term->pixel_scale, tile_pixel_width * term->pixel_scale, tile_pixel_height * term->pixel_scale,
-                     glyph, fg, bg);
-    return RLH_RESULT_OK;
+    const rlhresult_t result = _rlhTermTakePublishedFrame(term);
+    _rlhTermUpdatePendingAtlas(term);
+    _rlhTermApplyShrinkPolicy(term);
+    _rlhTermCullOverdraw(term);
+    _rlhTermCallStatsHook(term, RLH_STATS_DRAW_BEGIN);
+    const rlhbool_t timed = _rlhTermBeginGpuTimer(term);
+    if (term->render_cache && _rlhTermUpdateRenderCache(term))
+    {
+      _rlhTermDrawRenderCache(term, matrix_4x4);
+    }
+    else
+    {
+      _rlhTermDrawLayers(term, matrix_4x4, RLH_BLEND_ALPHA);
+    }
+    if (timed)
+    {
+      GLD_START();
+      GLD_CALL(glEndQuery(GL_TIME_ELAPSED));
+    }
+    _rlhTermCallStatsHook(term, RLH_STATS_DRAW_END);
+    return result;
   }
 
   rlhresult_t rlhTermDraw(rlhTerm_h term)
@@ -1240,9 +7898,7 @@ extern "C"
       return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
 
-    rlhTermDrawMatrix(term, RLH_OPENGL_SCREEN_MATRIX);
-
-    return RLH_RESULT_OK;
+    return rlhTermDrawMatrix(term, RLH_OPENGL_SCREEN_MATRIX);
   }
 
   // Translate an opengl screen matrix so that a rectangle using it is flat facing the screen and
@@ -1264,8 +7920,7 @@ extern "C"
   static void _rlhSetTermScissor(const int translate_x, const int translate_y, const int width,
                                  const int height, const int viewport_height)
   {
-    GLD_START();
-    const int actual_translate_y = viewport_height - (translate_x + height);
+    const int actual_translate_y = viewport_height - (translate_y + height);
     // crop the scissor area so the position is not less than 0 (this causes opengl error)
     const int cropped_x = MAX(translate_x, 0);
     const int cropped_y = MAX(actual_translate_y, 0);
@@ -1280,8 +7935,8 @@ extern "C"
       cropped_height += actual_translate_y;
     }
     // set scissor
-    GLD_CALL(glScissor(cropped_x, cropped_y, cropped_width, cropped_height));
-    GLD_CALL(glEnable(GL_SCISSOR_TEST));
+    _rlhSetScissorBox(cropped_x, cropped_y, cropped_width, cropped_height);
+    _rlhSetScissorTest(RLH_TRUE);
   }
 
   rlhresult_t rlhTermDrawAligned(rlhTerm_h const term, const int viewport_width, const int viewport_height, rlhtermhalign_t h_align, rlhtermvalign_t v_align)
@@ -1317,8 +7972,7 @@ extern "C"
     default:
       translate_y = height_difference / 2;
     }
-    rlhTermDrawTranslated(term, translate_x, translate_y, viewport_width, viewport_height);
-    return RLH_RESULT_OK;
+    return rlhTermDrawTranslated(term, translate_x, translate_y, viewport_width, viewport_height);
   }
 
   rlhresult_t rlhTermDrawTranslated(rlhTerm_h const term,
@@ -1335,11 +7989,13 @@ extern "C"
                         term->scaled_pixel_width, term->scaled_pixel_height);
     _rlhSetTermScissor(translate_x, translate_y, term->scaled_pixel_width, term->scaled_pixel_height, viewport_height);
     // draw
-    rlhTermDrawMatrix(term, matrix);
-    GLD_START();
-    // unset the scissor
-    GLD_CALL(glDisable(GL_SCISSOR_TEST));
-    return RLH_RESULT_OK;
+    const rlhresult_t result = _rlhTermDrawMatrix(term, matrix);
+    // unset the scissor, unless the next draw of the frame can reuse it
+    if (!_rlh_gl_state.in_frame)
+    {
+      _rlhSetScissorTest(RLH_FALSE);
+    }
+    return result;
   }
 
   rlhresult_t rlhTermDrawTransformed(rlhTerm_h const term,
@@ -1359,11 +8015,13 @@ extern "C"
     _rlhSetTermScissor(translate_x, translate_y, term->scaled_pixel_width * scale_x,
                        term->scaled_pixel_height * scale_y, viewport_height);
     // draw
-    rlhTermDrawMatrix(term, matrix);
-    GLD_START();
-    // unset the scissor
-    GLD_CALL(glDisable(GL_SCISSOR_TEST));
-    return RLH_RESULT_OK;
+    const rlhresult_t result = _rlhTermDrawMatrix(term, matrix);
+    // unset the scissor, unless the next draw of the frame can reuse it
+    if (!_rlh_gl_state.in_frame)
+    {
+      _rlhSetScissorTest(RLH_FALSE);
+    }
+    return result;
   }
 
   rlhresult_t rlhTermDrawMatrix(rlhTerm_h const term,
@@ -1373,79 +8031,312 @@ extern "C"
     {
       return RLH_RESULT_ERROR_NULL_ARGUMENT;
     }
-    if (term->vertex_data_tile_count == 0)
+    // the scissor of a translated draw may still be enabled in a frame
+    if (_rlh_gl_state.in_frame)
+    {
+      _rlhSetScissorTest(RLH_FALSE);
+    }
+    return _rlhTermDrawMatrix(term, matrix_4x4);
+  }
+
+  static inline rlhbool_t _rlhBatchTryReserve(rlhBatch_s *const batch, const size_t tile_count, const size_t term_count)
+  {
+    if (batch->tiles.allocator == NULL)
+    {
+      // the batch is global, so it captures the global allocator the first time it allocates.
+      batch->allocator = _rlh_allocator;
+      batch->tiles.allocator = &batch->allocator;
+    }
+    if (tile_count > batch->tile_terms_capacity)
+    {
+      uint16_t *const tile_terms = (uint16_t *)_rlhReallocate(&batch->allocator, batch->tile_terms, tile_count * sizeof(uint16_t));
+      if (tile_terms == NULL)
+      {
+        return RLH_FALSE; // out of memory
+      }
+      batch->tile_terms = tile_terms;
+      batch->tile_terms_capacity = tile_count;
+    }
+    if (term_count > batch->term_data_capacity)
+    {
+      float *const term_data = (float *)_rlhReallocate(&batch->allocator, batch->term_data, term_count * RLH_BATCH_FLOATS_PER_TERM * sizeof(float));
+      if (term_data == NULL)
+      {
+        return RLH_FALSE; // out of memory
+      }
+      batch->term_data = term_data;
+      batch->term_data_capacity = term_count;
+    }
+    return _rlhTileBufferTryReserveTiles(&batch->tiles, tile_count);
+  }
+
+  static inline void _rlhBatchCreateObjects(rlhBatch_s *const batch)
+  {
+    if (batch->gl_term_buffer != GL_NONE)
+      return;
+    GLD_START();
+    _rlhTileBufferCreateVertexArray(&batch->tiles);
+    _rlhBindVertexArray(batch->tiles.gl_vertex_array);
+    // the terminal index of each tile
+    GLD_CALL(glGenBuffers(1, &batch->gl_tile_term_buffer));
+    GLD_CALL(glBindBuffer(GL_ARRAY_BUFFER, batch->gl_tile_term_buffer));
+    GLD_CALL(glVertexAttribIPointer(4, 1, GL_UNSIGNED_SHORT, sizeof(uint16_t), (void *)0));
+    GLD_CALL(glVertexAttribDivisor(4, 1));
+    GLD_CALL(glEnableVertexAttribArray(4));
+    // the matrix and size of each terminal
+    GLD_CALL(glGenBuffers(1, &batch->gl_term_buffer));
+    GLD_CALL(glGenTextures(1, &batch->gl_term_texture_buffer));
+    GLD_CALL(glBindBuffer(GL_TEXTURE_BUFFER, batch->gl_term_buffer));
+    GLD_CALL(glBufferData(GL_TEXTURE_BUFFER, RLH_BATCH_FLOATS_PER_TERM * sizeof(float), NULL, GL_STREAM_DRAW));
+    _rlhBindTexture(RLH_BATCH_TERM_TEXTURE_SLOT, batch->gl_term_texture_buffer);
+    GLD_CALL(glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, batch->gl_term_buffer));
+  }
+
+  // Draw the tiles of a run of terminals that share an atlas with a single draw call.
+  static inline rlhresult_t _rlhDrawBatchRun(rlhTerm_h const *const terms, const float *const matrices_4x4, const size_t term_count)
+  {
+    rlhBatch_s *const batch = &_rlh_batch;
+    size_t tile_count = 0;
+    for (size_t term_i = 0; term_i < term_count; term_i++)
     {
+      for (size_t layer_i = 0; layer_i < terms[term_i]->layer_count; layer_i++)
+      {
+        tile_count += terms[term_i]->layers[layer_i].tiles.vertex_data_tile_count;
+      }
+    }
+    if (tile_count == 0)
       return RLH_RESULT_OK;
+    _rlhTileBufferClear(&batch->tiles);
+    if (!_rlhBatchTryReserve(batch, tile_count, term_count))
+    {
+      return RLH_RESULT_ERROR_OUT_OF_MEMORY;
     }
     GLD_START();
-    // Update vertex buffer and element buffer data. Create objects if they don't exist yet.
-    const size_t before_element_glyph_count = term->element_glyph_count;
-    rlhresult_t result = _rlhTermTryAppendElements(term);
-    if (result != RLH_RESULT_OK)
+    _rlhBatchCreateObjects(batch);
+    // gather the tiles of every layer in draw order, terminal after terminal.
+    size_t first_tile = 0;
+    for (size_t term_i = 0; term_i < term_count; term_i++)
     {
-      return result;
+      rlhTerm_h const term = terms[term_i];
+      float *const term_data = batch->term_data + term_i * RLH_BATCH_FLOATS_PER_TERM;
+      memcpy(term_data, matrices_4x4 + term_i * RLH_MATRIX_FLOAT_COUNT, RLH_MATRIX_FLOAT_COUNT * sizeof(float));
+      term_data[16] = (float)term->unscaled_pixel_width;
+      term_data[17] = (float)term->unscaled_pixel_height;
+      term_data[18] = 0.0f;
+      term_data[19] = 0.0f;
+      term->stats.bytes_uploaded += RLH_BATCH_FLOATS_PER_TERM * sizeof(float);
+      for (size_t order_i = 0; order_i < term->layer_count; order_i++)
+      {
+        const rlhTileBuffer_s *const tiles = &term->layers[term->layer_draw_order[order_i]].tiles;
+        term->stats.bytes_uploaded += _rlhGetVertexDataSize(tiles->vertex_data_tile_count) + tiles->vertex_data_tile_count * sizeof(uint16_t);
+        // persistent layers are copied on the GPU below, because their mapped memory is write only.
+        if (tiles->stream_mode != RLH_STREAM_PERSISTENT)
+        {
+          memcpy(batch->tiles.vertex_data + first_tile, tiles->vertex_data, _rlhGetVertexDataSize(tiles->vertex_data_tile_count));
+        }
+        for (size_t tile_i = 0; tile_i < tiles->vertex_data_tile_count; tile_i++)
+        {
+          batch->tile_terms[first_tile + tile_i] = (uint16_t)term_i;
+        }
+        first_tile += tiles->vertex_data_tile_count;
+      }
     }
-    rlhbool_t create_vertex_array = term->gl_vertex_array == GL_NONE;
-    if (create_vertex_array)
-    {
-      GLD_CALL(glGenVertexArrays(1, &term->gl_vertex_array));
-      GLD_CALL(glGenBuffers(1, &term->gl_vertex_buffer));
-      GLD_CALL(glGenBuffers(1, &term->gl_element_buffer));
-    }
-    if (term->vertex_data_changed)
-    {
-      GLD_CALL(glBindVertexArray(term->gl_vertex_array));
-      GLD_CALL(glBindBuffer(GL_ARRAY_BUFFER, term->gl_vertex_buffer));
-      GLD_CALL(glBufferData(
-          GL_ARRAY_BUFFER,
-          _rlhGetVertexDataSize(term->vertex_data_tile_count),
-          term->vertex_data,
-          GL_STREAM_DRAW));
-      term->vertex_data_changed = RLH_FALSE;
-    }
-    if (before_element_glyph_count != term->element_glyph_count)
-    {
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, term->gl_element_buffer);
-      glBufferData(
-          GL_ELEMENT_ARRAY_BUFFER,
-          _rlhGetElementDataSize(term->element_glyph_count),
-          term->element_data,
-          GL_DYNAMIC_DRAW);
-    }
-    if (create_vertex_array)
-    {
-      const size_t stride = RLH_VERTEX_DATA_ATTRIBUTES_PER_VERTEX * sizeof(float);
-      // position
-      glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *)0);
-      glEnableVertexAttribArray(0);
-      // uvp
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(2 * sizeof(float)));
-      glEnableVertexAttribArray(1);
-      // forground color
-      glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void *)(5 * sizeof(float)));
-      glEnableVertexAttribArray(2);
-      // background color
-      glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void *)(9 * sizeof(float)));
-      glEnableVertexAttribArray(3);
+    batch->tiles.vertex_data_tile_count = tile_count;
+    _rlhTileBufferMarkTilesDirty(&batch->tiles, 0, tile_count);
+    _rlhBindVertexArray(batch->tiles.gl_vertex_array);
+    GLD_CALL(glBindBuffer(GL_ARRAY_BUFFER, batch->tiles.gl_vertex_buffer));
+    _rlhTileBufferUploadVertexData(&batch->tiles);
+    batch->tiles.uploaded_byte_count = 0;
+    first_tile = 0;
+    for (size_t term_i = 0; term_i < term_count; term_i++)
+    {
+      rlhTerm_h const term = terms[term_i];
+      for (size_t order_i = 0; order_i < term->layer_count; order_i++)
+      {
+        const rlhTileBuffer_s *const tiles = &term->layers[term->layer_draw_order[order_i]].tiles;
+        if (tiles->stream_mode == RLH_STREAM_PERSISTENT && tiles->vertex_data_tile_count > 0)
+        {
+          GLD_CALL(glBindBuffer(GL_COPY_READ_BUFFER, tiles->gl_vertex_buffer));
+          GLD_CALL(glCopyBufferSubData(
+              GL_COPY_READ_BUFFER,
+              GL_ARRAY_BUFFER,
+              _rlhGetVertexDataSize(tiles->stream_segment * tiles->gl_vertex_buffer_tile_capacity),
+              _rlhGetVertexDataSize(first_tile),
+              _rlhGetVertexDataSize(tiles->vertex_data_tile_count)));
+        }
+        first_tile += tiles->vertex_data_tile_count;
+      }
     }
-    // Bind objects
-    GLD_CALL(glBindVertexArray(term->gl_vertex_array));
-    GLD_CALL(glUseProgram(term->gl_program));
-    // bind the atlas texture
-    GLD_CALL(glActiveTexture(GL_TEXTURE0 + RLH_ATLAS_TEXTURE_SLOT));
-    GLD_CALL(glBindTexture(GL_TEXTURE_2D_ARRAY, term->gl_atlas_texture_2d_array));
-    // set the matrix uniform
-    GLD_CALL(glUniformMatrix4fv(term->gl_matrix_uniform_location, 1, GL_TRUE, matrix_4x4));
-    // set blend mode
-    GLD_CALL(glEnable(GL_BLEND));
-    GLD_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-    // DRAW!!!
-    GLD_CALL(glDrawElements(GL_TRIANGLES, _rlhGetElementCount(term->vertex_data_tile_count), GL_UNSIGNED_INT, NULL));
-#ifndef RLH_RETAINED_MODE
-    rlhTermClearTileData(term);
-#endif
+    _rlhTileBufferSetVertexAttributes(&batch->tiles, 0);
+    GLD_CALL(glBindBuffer(GL_ARRAY_BUFFER, batch->gl_tile_term_buffer));
+    GLD_CALL(glBufferData(GL_ARRAY_BUFFER, tile_count * sizeof(uint16_t), batch->tile_terms, GL_STREAM_DRAW));
+    GLD_CALL(glBindBuffer(GL_TEXTURE_BUFFER, batch->gl_term_buffer));
+    GLD_CALL(glBufferData(GL_TEXTURE_BUFFER, term_count * RLH_BATCH_FLOATS_PER_TERM * sizeof(float), batch->term_data, GL_STREAM_DRAW));
+    // bind the program and the textures of the shared atlas
+    rlhAtlas_h const atlas = terms[0]->atlas;
+    if (batch->programs[atlas->fragment_type] == NULL)
+    {
+      batch->programs[atlas->fragment_type] = _rlhAcquireProgram(_rlh_batch_programs, atlas->fragment_type, RLH_BATCH_VERTEX_SOURCE, RLH_FRAGMENT_BATCH_SOURCE);
+    }
+    _rlhUseProgram(batch->programs[atlas->fragment_type]->gl_program);
+    _rlhBindTexture(RLH_ATLAS_TEXTURE_SLOT, atlas->gl_texture_2d_array);
+    _rlhBindTexture(RLH_GLYPH_TABLE_TEXTURE_SLOT, atlas->gl_glyph_table_texture_buffer);
+    _rlhBindTexture(RLH_BATCH_TERM_TEXTURE_SLOT, batch->gl_term_texture_buffer);
+    // a terminal with a palette or effects is always in a run of its own.
+    _rlhTermBindPalette(terms[0]);
+    _rlhTermBindEffects(terms[0], batch->programs[atlas->fragment_type]);
+    _rlhSetBlend(RLH_BLEND_ALPHA);
+    _rlhTermCallStatsHook(NULL, RLH_STATS_DRAW_BEGIN);
+    GLD_CALL(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, RLH_VERTICES_PER_TILE, tile_count));
+    _rlhTermCallStatsHook(NULL, RLH_STATS_DRAW_END);
+    // the draw call is counted once, for the first terminal of the run.
+    terms[0]->stats.draw_calls++;
+    for (size_t term_i = 0; term_i < term_count; term_i++)
+    {
+      rlhTerm_h const term = terms[term_i];
+      for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+      {
+        rlhTermLayer_s *const layer = &term->layers[layer_i];
+        if (layer->tiles.vertex_data_tile_count == 0)
+          continue;
+        if (layer->tiles.stream_mode == RLH_STREAM_PERSISTENT)
+        {
+          _rlhTileBufferEndStreamSegment(&layer->tiles);
+        }
+        if (layer->mode == RLH_LAYER_IMMEDIATE)
+        {
+          _rlhTileBufferClear(&layer->tiles);
+        }
+      }
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhDrawBatch(rlhTerm_h const *const terms, const float *const matrices_4x4, const int term_count)
+  {
+    if (terms == NULL || matrices_4x4 == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (term_count < 0)
+    {
+      return RLH_RESULT_ERROR_INVALID_VALUE;
+    }
+    for (int term_i = 0; term_i < term_count; term_i++)
+    {
+      if (terms[term_i] == NULL)
+      {
+        return RLH_RESULT_ERROR_NULL_ARGUMENT;
+      }
+    }
+    // the terminals are drawn even if a published frame could not be appended, and the first error is returned.
+    rlhresult_t frame_result = RLH_RESULT_OK;
+    for (int term_i = 0; term_i < term_count; term_i++)
+    {
+      const rlhresult_t result = _rlhTermTakePublishedFrame(terms[term_i]);
+      if (frame_result == RLH_RESULT_OK)
+      {
+        frame_result = result;
+      }
+      _rlhTermUpdatePendingAtlas(terms[term_i]);
+      _rlhTermApplyShrinkPolicy(terms[term_i]);
+      _rlhTermCullOverdraw(terms[term_i]);
+    }
+    if (_rlh_gl_state.in_frame)
+    {
+      _rlhSetScissorTest(RLH_FALSE);
+    }
+    size_t run_begin = 0;
+    while (run_begin < (size_t)term_count)
+    {
+      // a run is broken by a terminal with a different atlas, bound atlases, a palette, effects, or a light map, or by a
+      // cell grid or tilemap that must be drawn between the tiles of the terminals before it and its own tiles.
+      size_t run_end = run_begin + 1;
+      if (terms[run_begin]->extra_atlas_count > 0 || _rlhTermHasLightMap(terms[run_begin]))
+      {
+        // the batch program only samples one atlas and no light map, so the terminal is drawn on its own and
+        // clipped to its area.
+        _rlhSetClipPlanes(RLH_TRUE);
+        _rlhTermDrawLayers(terms[run_begin], matrices_4x4 + run_begin * RLH_MATRIX_FLOAT_COUNT, RLH_BLEND_ALPHA);
+        _rlhSetClipPlanes(RLH_FALSE);
+        run_begin = run_end;
+        continue;
+      }
+      while (
+          run_end < (size_t)term_count &&
+          run_end - run_begin < RLH_MAX_BATCH_RUN_TERMS &&
+          terms[run_end]->atlas == terms[run_begin]->atlas &&
+          terms[run_end]->extra_atlas_count == 0 &&
+          !_rlhTermHasLightMap(terms[run_end]) &&
+          !_rlhTermHasPalette(terms[run_begin]) && !_rlhTermHasEffects(terms[run_begin]) &&
+          !_rlhTermHasPalette(terms[run_end]) && !_rlhTermHasEffects(terms[run_end]) &&
+          !_rlhTermHasGrid(terms[run_end]) &&
+          !_rlhTermHasTilemap(terms[run_end]))
+      {
+        run_end++;
+      }
+      _rlhTermDrawGrid(terms[run_begin], matrices_4x4 + run_begin * RLH_MATRIX_FLOAT_COUNT, RLH_BLEND_ALPHA);
+      _rlhTermDrawTilemap(terms[run_begin], matrices_4x4 + run_begin * RLH_MATRIX_FLOAT_COUNT, RLH_BLEND_ALPHA);
+      rlhresult_t result = _rlhDrawBatchRun(terms + run_begin, matrices_4x4 + run_begin * RLH_MATRIX_FLOAT_COUNT, run_end - run_begin);
+      if (result != RLH_RESULT_OK)
+      {
+        return result;
+      }
+      run_begin = run_end;
+    }
+    return frame_result;
+  }
+
+  rlhresult_t rlhTermGetStats(rlhTerm_h const term, rlhTermStats_t *const stats)
+  {
+    if (term == NULL || stats == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    _rlhTermReadGpuTimers(term);
+    *stats = term->stats;
+    // tile buffers that never grew still count towards the peak with the capacity they started with.
+    for (size_t layer_i = 0; layer_i < term->layer_count; layer_i++)
+    {
+      stats->peak_tile_capacity = MAX(stats->peak_tile_capacity, term->layers[layer_i].tiles.vertex_data_tile_capacity);
+    }
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermResetStats(rlhTerm_h const term)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    memset(&term->stats, 0, sizeof(rlhTermStats_t));
+    return RLH_RESULT_OK;
+  }
+
+  rlhresult_t rlhTermSetGpuTiming(rlhTerm_h const term, const rlhbool_t enabled)
+  {
+    if (term == NULL)
+    {
+      return RLH_RESULT_ERROR_NULL_ARGUMENT;
+    }
+    if (!enabled)
+    {
+      _rlhTermDestroyGpuTimers(term);
+    }
+    else if (term->gl_timer_queries[0] == GL_NONE)
+    {
+      GLD_START();
+      GLD_CALL(glGenQueries(RLH_TIMER_QUERY_COUNT, term->gl_timer_queries));
+    }
+    term->gpu_timing = enabled;
     return RLH_RESULT_OK;
   }
+
+  void rlhSetStatsHook(rlhStatsHook_f hook, void *const user_data)
+  {
+    _rlh_stats_hook = hook;
+    _rlh_stats_hook_user_data = user_data;
+  }
 #endif
 #ifdef __cplusplus
 }
@@ -0,0 +1,525 @@
+// SPDX-FileCopyrightText: 2021-2023 Daniel Aimé Valcour <fosssweeper@gmail.com>
+//
+// SPDX-License-Identifier: MIT
+
+/*
+    Copyright (c) 2021-2023  Daniel Aimé Valcour
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in
+    the Software without restriction, including without limitation the rights to
+    use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+    the Software, and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+    FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+    COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+    IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+    CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+/*
+    roguelike.hpp
+    Optional C++20 layer over roguelike.h.
+
+    Include this header instead of roguelike.h in C++ source files. It only uses the declarations of
+    roguelike.h, so the implementation is still compiled once by defining RLH_IMPLEMENTATION in a
+    single C source file before including roguelike.h.
+
+    rlh::Atlas and rlh::Term own an atlas and a terminal, and destroy them when they go out of scope.
+    They can be moved but not copied. Functions that can fail return the rlhresult_t of the function
+    of roguelike.h that they call, and nothing throws. The batch push functions of rlh::Term take
+    std::span, so arrays, std::array, and std::vector can be pushed without passing their sizes.
+
+    rlh::FixedTerm is a terminal with its grid size, tile size, and atlas color type fixed at compile
+    time. Its grid pushes write tile instances straight into the tile buffer of the terminal, between
+    rlhTermBeginTileWrite() and rlhTermEndTileWrite(), instead of calling into roguelike.h for every
+    tile. The pixel positions and sizes of the tiles are constant expressions, the colors are packed
+    inline, and the only check left for each tile is the glyph count of the atlas, so a loop of pushes
+    compiles down to stores into the tile buffer. The NULL, argument, and capacity checks of roguelike.h
+    are paid once for each batch of BatchTiles tiles, which defaults to one tile for every grid cell.
+    Positions that are known at compile time can be pushed with set<x, y>(), which checks the bounds
+    with a static_assert, and other positions are checked with assert() in debug builds. The color type
+    is checked against the atlas that a terminal is created with, and the program for it is compiled
+    once and shared like for any other terminal.
+
+    A FixedTerm owns its terminal instead of deriving from rlh::Term, and every function that changes
+    or draws the terminal ends the batch that is being written first, so the written tiles can not be
+    skipped or drawn out of order. Call flush() before passing get() to the functions of roguelike.h.
+
+        rlh::Atlas atlas;
+        atlas.create(atlas_info);
+        rlh::FixedTerm<80, 25, 8, 8> term;
+        term.create(atlas);
+        for (int y = 0; y < term.tiles_tall; y++)
+          for (int x = 0; x < term.tiles_wide; x++)
+            term.push(x, y, glyph_at(x, y), RLH_WHITE, RLH_BLACK);
+        term.draw();
+*/
+
+#ifndef ROGUELIKE_HPP
+#define ROGUELIKE_HPP
+#include "roguelike.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+namespace rlh
+{
+  // Owns a reference to an atlas.
+  class Atlas
+  {
+  public:
+    Atlas() noexcept = default;
+    // Take ownership of the reference to an atlas that rlhAtlasCreate() returned.
+    explicit Atlas(rlhAtlas_h const atlas) noexcept : atlas_(atlas) {}
+    Atlas(const Atlas &) = delete;
+    Atlas &operator=(const Atlas &) = delete;
+    Atlas(Atlas &&other) noexcept : atlas_(std::exchange(other.atlas_, nullptr)) {}
+    Atlas &operator=(Atlas &&other) noexcept
+    {
+      if (this != &other)
+      {
+        reset();
+        atlas_ = std::exchange(other.atlas_, nullptr);
+      }
+      return *this;
+    }
+    ~Atlas() { reset(); }
+
+    rlhresult_t create(rlhAtlasCreateInfo_t &atlas_info) noexcept
+    {
+      reset();
+      return rlhAtlasCreate(&atlas_info, &atlas_);
+    }
+    rlhresult_t createAsync(rlhAtlasCreateInfo_t &atlas_info) noexcept
+    {
+      reset();
+      return rlhAtlasCreateAsync(&atlas_info, &atlas_);
+    }
+    rlhresult_t createFromFile(const char *const path) noexcept
+    {
+      reset();
+      return rlhAtlasCreateFromFile(path, &atlas_);
+    }
+    // Release the reference to the atlas. Terminals that use it keep it alive.
+    void reset() noexcept
+    {
+      if (atlas_ != nullptr)
+      {
+        rlhAtlasDestroy(std::exchange(atlas_, nullptr));
+      }
+    }
+
+    rlhAtlas_h get() const noexcept { return atlas_; }
+    explicit operator bool() const noexcept { return atlas_ != nullptr; }
+    bool isReady() const noexcept { return rlhAtlasIsReady(atlas_); }
+    int glyphCount() const noexcept { return rlhAtlasGetGlyphCount(atlas_); }
+
+  private:
+    rlhAtlas_h atlas_ = nullptr;
+  };
+
+  // Owns a terminal.
+  class Term
+  {
+  public:
+    Term() noexcept = default;
+    // Take ownership of a terminal that rlhTermCreate() returned.
+    explicit Term(rlhTerm_h const term) noexcept : term_(term) {}
+    Term(const Term &) = delete;
+    Term &operator=(const Term &) = delete;
+    Term(Term &&other) noexcept : term_(std::exchange(other.term_, nullptr)) {}
+    Term &operator=(Term &&other) noexcept
+    {
+      if (this != &other)
+      {
+        reset();
+        term_ = std::exchange(other.term_, nullptr);
+      }
+      return *this;
+    }
+    ~Term() { reset(); }
+
+    rlhresult_t create(rlhTermCreateInfo_t &term_info) noexcept
+    {
+      reset();
+      return rlhTermCreate(&term_info, &term_);
+    }
+    // Create a terminal that shares an atlas.
+    rlhresult_t create(rlhTermSizeInfo_t size_info, const Atlas &atlas) noexcept
+    {
+      rlhTermCreateInfo_t term_info = {};
+      term_info.size_info = &size_info;
+      term_info.atlas = atlas.get();
+      return create(term_info);
+    }
+    void reset() noexcept
+    {
+      if (term_ != nullptr)
+      {
+        rlhTermDestroy(std::exchange(term_, nullptr));
+      }
+    }
+
+    rlhTerm_h get() const noexcept { return term_; }
+    explicit operator bool() const noexcept { return term_ != nullptr; }
+
+    rlhresult_t setSharedAtlas(const Atlas &atlas) noexcept { return rlhTermSetSharedAtlas(term_, atlas.get()); }
+    rlhresult_t bindAtlas(const int atlas_index, const Atlas &atlas) noexcept { return rlhTermBindAtlas(term_, atlas_index, atlas.get()); }
+    rlhresult_t unbindAtlas(const int atlas_index) noexcept { return rlhTermBindAtlas(term_, atlas_index, nullptr); }
+    rlhresult_t selectAtlas(const int atlas_index) noexcept { return rlhTermSelectAtlas(term_, atlas_index); }
+    rlhresult_t selectLayer(const int layer) noexcept { return rlhTermSelectLayer(term_, layer); }
+    rlhresult_t reserveTiles(const int tile_count) noexcept { return rlhTermReserveTiles(term_, tile_count); }
+    rlhresult_t clear() noexcept { return rlhTermClearTileData(term_); }
+
+    rlhresult_t pushFill(const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return rlhTermPushFill(term_, glyph, fg, bg);
+    }
+    rlhresult_t pushGrid(const int grid_x, const int grid_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return rlhTermPushGrid(term_, grid_x, grid_y, glyph, fg, bg);
+    }
+    rlhresult_t pushGridPacked(const int grid_x, const int grid_y, const rlhglyph_t glyph, const uint32_t fg, const uint32_t bg) noexcept
+    {
+      return rlhTermPushGridPacked(term_, grid_x, grid_y, glyph, fg, bg);
+    }
+    rlhresult_t pushFree(const int pixel_x, const int pixel_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return rlhTermPushFree(term_, pixel_x, pixel_y, glyph, fg, bg);
+    }
+    rlhresult_t pushFreeSized(const int pixel_x, const int pixel_y, const int pixel_width, const int pixel_height,
+                              const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return rlhTermPushFreeSized(term_, pixel_x, pixel_y, pixel_width, pixel_height, glyph, fg, bg);
+    }
+    rlhresult_t pushString(const int grid_x, const int grid_y, const char *const string, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return rlhTermPushString(term_, grid_x, grid_y, string, fg, bg);
+    }
+    // Push a row of glyphs from a grid cell to the right.
+    rlhresult_t pushGridSpan(const int grid_x, const int grid_y, const std::span<const rlhglyph_t> glyphs,
+                             const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return rlhTermPushGridSpan(term_, grid_x, grid_y, glyphs.data(), static_cast<int>(glyphs.size()), fg, bg);
+    }
+    // Push a row of glyphs with a color pair for each glyph. The spans must have the same size.
+    rlhresult_t pushGridSpan(const int grid_x, const int grid_y, const std::span<const rlhglyph_t> glyphs,
+                             const std::span<const rlhColor_s> fgs, const std::span<const rlhColor_s> bgs) noexcept
+    {
+      assert(fgs.size() == glyphs.size() && bgs.size() == glyphs.size());
+      return rlhTermPushGridSpanColored(term_, grid_x, grid_y, glyphs.data(), fgs.data(), bgs.data(), static_cast<int>(glyphs.size()));
+    }
+    rlhresult_t pushGridSpanIndexed(const int grid_x, const int grid_y, const std::span<const rlhglyph_t> glyphs,
+                                    const uint8_t fg_index, const uint8_t bg_index) noexcept
+    {
+      return rlhTermPushGridSpanIndexed(term_, grid_x, grid_y, glyphs.data(), static_cast<int>(glyphs.size()), fg_index, bg_index);
+    }
+    rlhresult_t pushGridArray(const std::span<const rlhGridTile_s> tiles) noexcept
+    {
+      return rlhTermPushGridArray(term_, tiles.data(), static_cast<int>(tiles.size()));
+    }
+
+    rlhresult_t draw() noexcept { return rlhTermDraw(term_); }
+    rlhresult_t drawTranslated(const int translate_x, const int translate_y, const int viewport_width, const int viewport_height) noexcept
+    {
+      return rlhTermDrawTranslated(term_, translate_x, translate_y, viewport_width, viewport_height);
+    }
+    rlhresult_t drawMatrix(const std::span<const float, 16> matrix_4x4) noexcept { return rlhTermDrawMatrix(term_, matrix_4x4.data()); }
+
+    rlhTermStats_t stats() const noexcept
+    {
+      rlhTermStats_t stats = {};
+      rlhTermGetStats(term_, &stats);
+      return stats;
+    }
+
+  private:
+    rlhTerm_h term_ = nullptr;
+  };
+
+  namespace detail
+  {
+    // Convert a color channel to a byte the same way as roguelike.h.
+    constexpr uint8_t colorChannelToByte(const float channel) noexcept
+    {
+      if (channel <= 0.0f)
+        return 0;
+      if (channel >= 1.0f)
+        return 255;
+      return static_cast<uint8_t>(channel * 255.0f + 0.5f);
+    }
+
+    constexpr void packColor(const rlhColor_s color, uint8_t *const packed) noexcept
+    {
+      packed[0] = colorChannelToByte(color.r);
+      packed[1] = colorChannelToByte(color.g);
+      packed[2] = colorChannelToByte(color.b);
+      packed[3] = colorChannelToByte(color.a);
+    }
+  } // namespace detail
+
+  // A terminal with its grid size, tile size, and atlas color type fixed at compile time, that writes its grid
+  // pushes straight into its tile buffer in batches of up to BatchTiles tiles.
+  template <int TilesWide, int TilesTall, int TileWidth, int TileHeight, rlhcolortype_t Color = RLH_COLOR_RGBA,
+            int BatchTiles = TilesWide * TilesTall>
+  class FixedTerm
+  {
+    static_assert(TilesWide > 0 && TilesTall > 0, "a fixed terminal needs at least one grid cell");
+    static_assert(TileWidth > 0 && TileHeight > 0, "tile sizes must be positive");
+    static_assert(TilesWide * TileWidth <= INT16_MAX && TilesTall * TileHeight <= INT16_MAX,
+                  "tile positions are stored as 16 bit integers");
+    static_assert(BatchTiles > 0, "a batch must hold at least one tile");
+
+  public:
+    static constexpr int tiles_wide = TilesWide;
+    static constexpr int tiles_tall = TilesTall;
+    static constexpr int tile_width = TileWidth;
+    static constexpr int tile_height = TileHeight;
+    static constexpr int pixel_width = TilesWide * TileWidth;
+    static constexpr int pixel_height = TilesTall * TileHeight;
+    static constexpr rlhcolortype_t color = Color;
+    static constexpr int batch_tiles = BatchTiles;
+
+    static constexpr int pixelX(const int grid_x) noexcept { return grid_x * TileWidth; }
+    static constexpr int pixelY(const int grid_y) noexcept { return grid_y * TileHeight; }
+    static constexpr bool contains(const int grid_x, const int grid_y) noexcept
+    {
+      return grid_x >= 0 && grid_y >= 0 && grid_x < TilesWide && grid_y < TilesTall;
+    }
+    static constexpr rlhTermSizeInfo_t sizeInfo(const int pixel_scale = 1) noexcept
+    {
+      rlhTermSizeInfo_t size_info = {};
+      size_info.width = TilesWide;
+      size_info.height = TilesTall;
+      size_info.size_mode = RLH_SIZE_TILES;
+      size_info.pixel_scale = pixel_scale;
+      size_info.tile_width = TileWidth;
+      size_info.tile_height = TileHeight;
+      return size_info;
+    }
+
+    FixedTerm() noexcept = default;
+    FixedTerm(const FixedTerm &) = delete;
+    FixedTerm &operator=(const FixedTerm &) = delete;
+    // The batch that is being written belongs to the terminal, so it moves with it.
+    FixedTerm(FixedTerm &&other) noexcept
+        : term_(std::move(other.term_)),
+          write_(std::exchange(other.write_, rlhTileWrite_t{})),
+          write_count_(std::exchange(other.write_count_, 0)),
+          write_capacity_(std::exchange(other.write_capacity_, 0)),
+          rejected_count_(std::exchange(other.rejected_count_, 0))
+    {
+    }
+    FixedTerm &operator=(FixedTerm &&other) noexcept
+    {
+      if (this != &other)
+      {
+        reset();
+        term_ = std::move(other.term_);
+        write_ = std::exchange(other.write_, rlhTileWrite_t{});
+        write_count_ = std::exchange(other.write_count_, 0);
+        write_capacity_ = std::exchange(other.write_capacity_, 0);
+        rejected_count_ = std::exchange(other.rejected_count_, 0);
+      }
+      return *this;
+    }
+    // Tiles of the batch that is being written are dropped with the terminal, like the rest of its tile buffer.
+    ~FixedTerm() = default;
+
+    // Create the terminal with an atlas info of the color type of the terminal.
+    rlhresult_t create(rlhAtlasCreateInfo_t &atlas_info, const int pixel_scale = 1) noexcept
+    {
+      if (atlas_info.color != Color)
+        return RLH_RESULT_ERROR_INVALID_VALUE;
+      reset();
+      rlhTermSizeInfo_t size_info = sizeInfo(pixel_scale);
+      rlhTermCreateInfo_t term_info = {};
+      term_info.size_info = &size_info;
+      term_info.atlas_info = &atlas_info;
+      return term_.create(term_info);
+    }
+    // Create the terminal with a shared atlas of the color type of the terminal.
+    rlhresult_t create(const Atlas &atlas, const int pixel_scale = 1) noexcept
+    {
+      if (!atlas)
+        return RLH_RESULT_ERROR_NULL_ARGUMENT;
+      if (rlhAtlasGetColor(atlas.get()) != Color)
+        return RLH_RESULT_ERROR_INVALID_VALUE;
+      reset();
+      return term_.create(sizeInfo(pixel_scale), atlas);
+    }
+    void reset() noexcept
+    {
+      discardWrite();
+      term_.reset();
+    }
+
+    rlhTerm_h get() const noexcept { return term_.get(); }
+    explicit operator bool() const noexcept { return static_cast<bool>(term_); }
+
+    // Write a tile to a grid cell that is known at compile time.
+    template <int GridX, int GridY>
+    rlhresult_t set(const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      static_assert(contains(GridX, GridY), "the grid cell is outside of the terminal");
+      return write(GridX, GridY, glyph, fg, bg);
+    }
+    // Write a tile to a grid cell of the terminal.
+    rlhresult_t push(const int grid_x, const int grid_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      assert(contains(grid_x, grid_y));
+      return write(grid_x, grid_y, glyph, fg, bg);
+    }
+    // End the batch that is being written, which adds its tiles to the selected layer of the terminal.
+    rlhresult_t flush() noexcept
+    {
+      if (write_capacity_ == 0)
+        return RLH_RESULT_OK;
+      const rlhresult_t result = rlhTermEndTileWrite(term_.get(), write_count_, rejected_count_);
+      discardWrite();
+      return result;
+    }
+    // Get the amount of tiles in the batch that is being written.
+    int writtenCount() const noexcept { return write_count_; }
+
+    rlhresult_t setSharedAtlas(const Atlas &atlas) noexcept
+    {
+      return flushed([&] { return term_.setSharedAtlas(atlas); });
+    }
+    rlhresult_t bindAtlas(const int atlas_index, const Atlas &atlas) noexcept
+    {
+      return flushed([&] { return term_.bindAtlas(atlas_index, atlas); });
+    }
+    rlhresult_t unbindAtlas(const int atlas_index) noexcept
+    {
+      return flushed([&] { return term_.unbindAtlas(atlas_index); });
+    }
+    rlhresult_t selectAtlas(const int atlas_index) noexcept
+    {
+      return flushed([&] { return term_.selectAtlas(atlas_index); });
+    }
+    rlhresult_t selectLayer(const int layer) noexcept
+    {
+      return flushed([&] { return term_.selectLayer(layer); });
+    }
+    rlhresult_t reserveTiles(const int tile_count) noexcept
+    {
+      return flushed([&] { return term_.reserveTiles(tile_count); });
+    }
+    // Clear the tiles of the selected layer, with the tiles of the batch that is being written.
+    rlhresult_t clear() noexcept
+    {
+      return flushed([&] { return term_.clear(); });
+    }
+
+    rlhresult_t pushFill(const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return flushed([&] { return term_.pushFill(glyph, fg, bg); });
+    }
+    rlhresult_t pushFree(const int pixel_x, const int pixel_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return flushed([&] { return term_.pushFree(pixel_x, pixel_y, glyph, fg, bg); });
+    }
+    rlhresult_t pushFreeSized(const int pixel_x, const int pixel_y, const int pixel_width, const int pixel_height,
+                              const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return flushed([&] { return term_.pushFreeSized(pixel_x, pixel_y, pixel_width, pixel_height, glyph, fg, bg); });
+    }
+    rlhresult_t pushString(const int grid_x, const int grid_y, const char *const string, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return flushed([&] { return term_.pushString(grid_x, grid_y, string, fg, bg); });
+    }
+    rlhresult_t pushGridSpan(const int grid_x, const int grid_y, const std::span<const rlhglyph_t> glyphs,
+                             const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      return flushed([&] { return term_.pushGridSpan(grid_x, grid_y, glyphs, fg, bg); });
+    }
+    rlhresult_t pushGridArray(const std::span<const rlhGridTile_s> tiles) noexcept
+    {
+      return flushed([&] { return term_.pushGridArray(tiles); });
+    }
+
+    rlhresult_t draw() noexcept
+    {
+      return flushed([&] { return term_.draw(); });
+    }
+    rlhresult_t drawTranslated(const int translate_x, const int translate_y, const int viewport_width, const int viewport_height) noexcept
+    {
+      return flushed([&] { return term_.drawTranslated(translate_x, translate_y, viewport_width, viewport_height); });
+    }
+    rlhresult_t drawMatrix(const std::span<const float, 16> matrix_4x4) noexcept
+    {
+      return flushed([&] { return term_.drawMatrix(matrix_4x4); });
+    }
+
+    rlhTermStats_t stats() const noexcept { return term_.stats(); }
+
+  private:
+    // End the batch that is being written, then call a function of the terminal. The first error is returned.
+    template <typename Call>
+    rlhresult_t flushed(Call &&call) noexcept
+    {
+      const rlhresult_t result = flush();
+      const rlhresult_t call_result = call();
+      return (result != RLH_RESULT_OK) ? result : call_result;
+    }
+
+    void discardWrite() noexcept
+    {
+      write_ = rlhTileWrite_t{};
+      write_count_ = 0;
+      write_capacity_ = 0;
+      rejected_count_ = 0;
+    }
+
+    rlhresult_t beginWrite() noexcept
+    {
+      const rlhresult_t result = flush();
+      if (result != RLH_RESULT_OK)
+        return result;
+      const rlhresult_t begin_result = rlhTermBeginTileWrite(term_.get(), BatchTiles, &write_);
+      if (begin_result == RLH_RESULT_OK)
+      {
+        write_capacity_ = BatchTiles;
+      }
+      return begin_result;
+    }
+
+    rlhresult_t write(const int grid_x, const int grid_y, const rlhglyph_t glyph, const rlhColor_s fg, const rlhColor_s bg) noexcept
+    {
+      if (write_count_ == write_capacity_)
+      {
+        const rlhresult_t result = beginWrite();
+        if (result != RLH_RESULT_OK)
+          return result;
+      }
+      if (static_cast<int>(glyph) >= write_.glyph_count)
+      {
+        rejected_count_++;
+        return RLH_RESULT_OK;
+      }
+      rlhTileInstance_s &tile = write_.tiles[write_count_++];
+      tile.pixel_x = static_cast<int16_t>(pixelX(grid_x));
+      tile.pixel_y = static_cast<int16_t>(pixelY(grid_y));
+      tile.pixel_w = static_cast<int16_t>(TileWidth);
+      tile.pixel_h = static_cast<int16_t>(TileHeight);
+      tile.glyph = glyph | write_.glyph_bits;
+      detail::packColor(fg, tile.fg);
+      detail::packColor(bg, tile.bg);
+      return RLH_RESULT_OK;
+    }
+
+    Term term_;
+    rlhTileWrite_t write_ = {};
+    int write_count_ = 0;
+    int write_capacity_ = 0;
+    int rejected_count_ = 0;
+  };
+} // namespace rlh
+#endif